@@ -0,0 +1,276 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file condensation.hpp The condensation of a directed graph that may have cycles into a DAG of its strongly connected components (Depends::Condensation). */
+#ifndef depends_condensation_hpp
+#define depends_condensation_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dag.hpp"
+
+namespace Depends
+{
+	/** The condensation of a directed graph into a DAG of its strongly connected components.
+	 * Real-world dependency data isn't always acyclic: a DAG refuses the links that
+	 * would close a cycle, one at a time, so which of them end up refused depends on
+	 * the order they come in. Instead, a Condensation takes any directed graph, as a
+	 * list of edges, and collapses each cycle into a single component: every value in
+	 * a component depends, directly or not, on every other value in it. The links
+	 * between the components then form a DAG, with one node per component, which is
+	 * built in bulk (\see DAG::assign).
+	 *
+	 * The components are found using Tarjan's algorithm, iteratively so that long
+	 * chains of dependencies don't overflow the stack, in time proportional to the
+	 * number of values and edges. They are numbered in the order the algorithm finds
+	 * them in, so a component only links to components with lower numbers.
+	 *
+	 * \param ValueType the type of the values in the graph
+	 * \param Hash the hash function used to find values
+	 * \param KeyEqual the predicate used to compare values */
+	template < typename ValueType, typename Hash = std::hash< ValueType >, typename KeyEqual = std::equal_to< ValueType > >
+	class Condensation
+	{
+	public :
+		typedef ValueType value_type;
+		typedef std::size_t size_type;
+		//! The components are identified by their number, from 0 to size() - 1
+		typedef std::size_t component_type;
+		//! The DAG of the components
+		typedef DAG< component_type > dag_type;
+
+		/** Condense the graph made up of the given edges.
+		 * \param first the first of the edges, each of which is a pair with the source and the target of the edge as its first and second member
+		 * \param last one-past-the-end of the edges */
+		template < typename InputIterator >
+		Condensation(InputIterator first, InputIterator last)
+		{
+			// number the values and put the edges in compressed rows
+			std::vector< std::pair< size_type, size_type > > edges;
+			for (; first != last; ++first)
+			{
+				size_type source(number(first->first));
+				size_type target(number(first->second));
+				edges.push_back(std::make_pair(source, target));
+			}
+			std::vector< size_type > offsets(values_.size() + 1, 0);
+			for (auto edge : edges)
+			{
+				++offsets[edge.first + 1];
+			}
+			for (size_type which(1); which < offsets.size(); ++which)
+			{
+				offsets[which] += offsets[which - 1];
+			}
+			std::vector< size_type > targets(edges.size());
+			std::vector< size_type > cursors(offsets.begin(), offsets.end() - 1);
+			for (auto edge : edges)
+			{
+				targets[cursors[edge.first]++] = edge.second;
+			}
+
+			findComponents(offsets, targets);
+
+			// the links between the components; a link within a component means it has a cycle
+			std::vector< bool > looped(members_.size(), false);
+			std::vector< std::pair< component_type, component_type > > links;
+			for (auto edge : edges)
+			{
+				const component_type source(components_[edge.first]);
+				const component_type target(components_[edge.second]);
+				if (source != target)
+					links.push_back(std::make_pair(source, target));
+				else
+				{
+					looped[source] = true;
+				}
+			}
+			for (component_type component(0); component < members_.size(); ++component)
+			{
+				if (looped[component] || members_[component].size() > 1)
+					cycles_.push_back(component);
+				else
+				{ /* a single value that doesn't depend on itself */ }
+			}
+			std::vector< component_type > components(members_.size());
+			for (component_type component(0); component < components.size(); ++component)
+			{
+				components[component] = component;
+			}
+			dag_.assign(components.begin(), components.end(), links.begin(), links.end());
+		}
+
+		//! Get the DAG of the components
+		dag_type const & dag() const { return dag_; }
+		//! Get the number of components
+		size_type size() const { return members_.size(); }
+		//! Get the number of values in the graph
+		size_type values() const { return values_.size(); }
+
+		//! Get the values in the given component
+		std::vector< value_type > const & members(component_type component) const
+		{
+			return members_.at(component);
+		}
+		/** Get the component the given value is in.
+		 * \throws std::invalid_argument if the value isn't in the graph */
+		component_type component(value_type const &value) const
+		{
+			typename Numbers::const_iterator where(numbers_.find(value));
+			if (where == numbers_.end())
+				throw std::invalid_argument("value not found");
+			else
+			{ /* found it */ }
+			return components_[where->second];
+		}
+		/** Get the cycles found in the graph, as the components that have them.
+		 * A component has a cycle if it has more than one value in it, or if the
+		 * one value in it depends on itself. */
+		std::vector< component_type > const & cycles() const { return cycles_; }
+
+	private :
+		typedef std::unordered_map< value_type, size_type, Hash, KeyEqual > Numbers;
+
+		//! \internal Get the number of a value, numbering it if it's new
+		size_type number(value_type const &value)
+		{
+			std::pair< typename Numbers::iterator, bool > inserted(numbers_.insert(std::make_pair(value, values_.size())));
+			if (inserted.second)
+				values_.push_back(value);
+			else
+			{ /* already numbered */ }
+			return inserted.first->second;
+		}
+
+		/** \internal Find the strongly connected components, using Tarjan's algorithm.
+		 * Each value gets an index in the order the depth-first search reaches it, and
+		 * a "low link": the lowest index of the values on the search's stack that it
+		 * reaches. A value whose low link is its own index is the root of a component,
+		 * which consists of it and the values above it on the stack.
+		 * \param offsets where the targets of each value start in targets
+		 * \param targets the targets of all values, in compressed rows */
+		void findComponents(std::vector< size_type > const &offsets, std::vector< size_type > const &targets)
+		{
+			const size_type unvisited(static_cast< size_type >(-1));
+			std::vector< size_type > indices(values_.size(), unvisited);
+			std::vector< size_type > low_links(values_.size());
+			std::vector< bool > on_stack(values_.size(), false);
+			std::vector< size_type > stack;
+			// the search's own stack: each value with the next of its targets to look at
+			std::vector< std::pair< size_type, size_type > > calls;
+			size_type next_index(0);
+			components_.resize(values_.size());
+
+			for (size_type root(0); root < values_.size(); ++root)
+			{
+				if (indices[root] != unvisited)
+					continue;
+				else
+				{ /* start a search here */ }
+				calls.push_back(std::make_pair(root, offsets[root]));
+				indices[root] = low_links[root] = next_index++;
+				stack.push_back(root);
+				on_stack[root] = true;
+				while (!calls.empty())
+				{
+					const size_type value(calls.back().first);
+					size_type &cursor(calls.back().second);
+					if (cursor != offsets[value + 1])
+					{
+						const size_type target(targets[cursor++]);
+						if (indices[target] == unvisited)
+						{
+							indices[target] = low_links[target] = next_index++;
+							stack.push_back(target);
+							on_stack[target] = true;
+							calls.push_back(std::make_pair(target, offsets[target]));
+						}
+						else if (on_stack[target])
+						{
+							low_links[value] = std::min(low_links[value], indices[target]);
+						}
+						else
+						{ /* in a component found earlier */ }
+					}
+					else
+					{
+						calls.pop_back();
+						if (!calls.empty())
+						{
+							const size_type caller(calls.back().first);
+							low_links[caller] = std::min(low_links[caller], low_links[value]);
+						}
+						else
+						{ /* back at the root */ }
+						if (low_links[value] == indices[value])
+						{
+							const component_type component(members_.size());
+							members_.push_back(std::vector< value_type >());
+							size_type member;
+							do
+							{
+								member = stack.back();
+								stack.pop_back();
+								on_stack[member] = false;
+								components_[member] = component;
+								members_.back().push_back(values_[member]);
+							} while (member != value);
+						}
+						else
+						{ /* part of a larger component */ }
+					}
+				}
+			}
+		}
+
+		//! \internal The number of each value
+		Numbers numbers_;
+		//! \internal The values, by number
+		std::vector< value_type > values_;
+		//! \internal The component of each value, by number
+		std::vector< component_type > components_;
+		//! \internal The values in each component
+		std::vector< std::vector< value_type > > members_;
+		//! \internal The components with a cycle
+		std::vector< component_type > cycles_;
+		dag_type dag_;
+	};
+}
+
+#endif
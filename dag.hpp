@@ -41,6 +41,13 @@
 
 #include <vector>
 #include <algorithm>
+#include <cassert>
+#include <utility>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <type_traits>
+#include <unordered_map>
 #include <boost/iterator/indirect_iterator.hpp>
 
 #if DEPENDS_SUPPORT_SERIALIZATION
@@ -48,10 +55,19 @@ namespace boost { namespace serialization { class access; } }
 #include "details/serialization.hpp"
 #endif
 
+#include "details/closure.hpp"
+#include "details/index.hpp"
 #include "details/iterator.hpp"
+#include "details/levels.hpp"
+#include "details/memoryusage.hpp"
 #include "details/node.hpp"
+#include "details/notifier.hpp"
 #include "details/scopedflag.hpp"
+#include "details/topological.hpp"
 #include "exceptions.hpp"
+#include "observer.hpp"
+#include "ordering.hpp"
+#include "tracer.hpp"
 
 namespace Depends {
 	/** A DAG is a collection of directed edges between nodes (or 
@@ -110,25 +126,43 @@ namespace Depends {
 	 * The test-case should therefore, in test2, output "Circular reference
 	 * detected"
 	 *
+	 * Values are found through a hash table, using the given hash function and
+	 * equality predicate. If both of those are transparent (i.e. have a member
+	 * type called is_transparent) values can be looked up using any key the
+	 * two of them accept, without constructing a value from that key. This is
+	 * what the \c find function does, as do all the functions that take a value
+	 * to link, unlink or check.
+	 *
 	 * \param ValueType the type of whatever the DAG should be decorated
 	 *        with
+	 * \param Hash the hash function used to find values in the DAG
+	 * \param KeyEqual the predicate used to compare values in the DAG
+	 * \param OrderingPolicy the order in which the DAG keeps its values, and
+	 *        how it maintains that order: one of Ordering::Score (the default,
+	 *        described above), Ordering::Topological or Ordering::Insertion.
+	 *        The policy is resolved at compile time (\see ordering.hpp)
+	 * \param InlineTargets the number of links from each node that are kept in
+	 *        the node itself, rather than in memory allocated separately
 	 *
 	 * \todo provide a way to specify the allocator to use
-	 * \todo provide a way to provide a predicate to use to compare values
 	 * */
-	template <class ValueType>
+	template < class ValueType, class Hash = std::hash< ValueType >, class KeyEqual = std::equal_to< ValueType >, class OrderingPolicy = Ordering::Score, std::size_t InlineTargets = 4 >
 	class DAG
 	{
+
 	public :
 		// standard types for a container
 		typedef ValueType value_type;
 		typedef ValueType key_type;
+		typedef Hash hasher;
+		typedef KeyEqual key_equal;
 		typedef ValueType & reference;
 		typedef const ValueType & const_reference;
 		typedef ValueType * pointer;
 		typedef const ValueType * const_pointer;
-		typedef unsigned long score_type;
-		typedef Details::Node< ValueType, score_type > node_type;
+		typedef OrderingPolicy ordering_policy;
+		typedef typename OrderingPolicy::score_type score_type;
+		typedef Details::Node< ValueType, score_type, InlineTargets > node_type;
 		typedef std::vector< node_type* > nodes_type;
 		typedef Details::Iterator< ValueType, const ValueType &, const ValueType *, score_type, typename nodes_type::iterator > iterator;
 		typedef Details::Iterator< ValueType, const ValueType &, const ValueType *, score_type, typename nodes_type::iterator > const_iterator;
@@ -136,19 +170,88 @@ namespace Depends {
 		typedef std::reverse_iterator< const_iterator > const_reverse_iterator;
 		typedef typename std::vector< node_type >::difference_type difference_type;
 		typedef typename std::vector< node_type >::size_type size_type;
+		//! The nodes of the DAG, partitioned into levels (\see levels)
+		typedef Details::Levels< const_pointer > levels_type;
+		//! The transitive closure of the DAG (\see closure)
+		typedef Details::Closure< ValueType, Hash, KeyEqual > closure_type;
+		//! The observers that can be told about changes to the DAG (\see setObserver)
+		typedef Observer< ValueType > observer_type;
+		//! The changes reported to the observer
+		typedef ChangeSet< ValueType > change_set_type;
+		//! The memory used by the DAG (\see memoryUsage)
+		typedef Details::MemoryUsage memory_usage_type;
+		//! A single-pass range over the DAG's values in topological order (\see topological)
+		typedef Details::TopologicalRange< node_type, ValueType > topological_range;
 
 		/** This exception is thrown in case a new link creates a
 		 * circular reference */
 		typedef CircularReference circular_reference_exception;
 
+	private :
+		//! \internal SFINAE helpers to tell keys from iterators in overloads that take either
+		template < typename Key >
+		using EnableIfKey = typename std::enable_if< !std::is_convertible< Key, iterator >::value, bool >::type;
+		template < typename SourceKey, typename TargetKey >
+		using EnableIfKeys = typename std::enable_if< !std::is_convertible< SourceKey, iterator >::value && !std::is_convertible< TargetKey, iterator >::value, bool >::type;
+
+	public :
 		//! DefaultConstructible
 		DAG()
+			: tracer_(0)
+			, reject_implied_links_(false)
+			, levels_dirty_(false)
 		{ /* no-op */ }
-		//! CopyConstructible
+		/** CopyConstructible.
+		 * This makes a deep copy of the DAG, which takes time proportional to its
+		 * number of nodes and links. If you need many copies of a graph, have a look
+		 * at the PersistentDAG class, which can be copied in constant time. */
 		DAG(const DAG & d)
-			: nodes_(d.nodes)
-		{ /* no-op */ }
+			: tracer_(d.tracer_)
+			, reject_implied_links_(d.reject_implied_links_)
+			, levels_dirty_(d.levels_dirty_)
+		{
+			std::unordered_map< const node_type*, node_type* > copies(d.nodes_.size());
+			nodes_.reserve(d.nodes_.size());
+			try
+			{
+				index_.reserve(d.nodes_.size());
+				for (auto node : d.nodes_)
+				{
+					nodes_.push_back(new node_type(*node));
+					copies[node] = nodes_.back();
+					index_.insert(nodes_.back());
+				}
+				// the copies still link to the originals until they are re-targeted
+				std::vector< node_type* > targets;
+				for (auto node : nodes_)
+				{
+					targets.clear();
+					for (auto target : node->targets_)
+					{
+						targets.push_back(copies[target]);
+					}
+					node->targets_.assign(targets.begin(), targets.end());
+				}
+			}
+			catch (...)
+			{
+				for (auto node : nodes_)
+				{
+					delete node;
+				}
+				throw;
+			}
+		}
 	
+		//! MoveConstructible: leaves the other DAG empty
+		DAG(DAG && d)
+			: tracer_(d.tracer_)
+			, reject_implied_links_(d.reject_implied_links_)
+			, levels_dirty_(false)
+		{
+			swap(d);
+		}
+
 		//! Construct a directed acyclic graph from a range
 		/** This constructor does not create any links and, for most
 		 * intents and purposes, creates a simple vector-like
@@ -158,6 +261,9 @@ namespace Depends {
 		 * \param last one-past-the-end */
 		template <typename InputIterator>
 		DAG(InputIterator first, InputIterator last)
+			: tracer_(0)
+			, reject_implied_links_(false)
+			, levels_dirty_(false)
 		{
 			insert(first, last);
 		}
@@ -165,7 +271,24 @@ namespace Depends {
 		//! Assignable
 		DAG & operator=(const DAG & d)
 		{
-			nodes_ = d.nodes_;
+			DAG temp(d);
+			swap(temp);
+			tracer_ = d.tracer_;
+			reject_implied_links_ = d.reject_implied_links_;
+			return *this;
+		}
+		//! MoveAssignable: leaves the other DAG empty
+		DAG & operator=(DAG && d)
+		{
+			if (this != &d)
+			{
+				DAG temp(std::move(d));
+				swap(temp);
+				tracer_ = d.tracer_;
+				reject_implied_links_ = d.reject_implied_links_;
+			}
+			else
+			{ /* self-assignment */ }
 			return *this;
 		}
 
@@ -202,8 +325,234 @@ namespace Depends {
 
 		//! check whether the container is empty
 		bool empty() const { return nodes_.empty(); }
+
+		/** Get the memory used by the DAG, broken down by what it is used for.
+		 * This takes time proportional to the number of nodes. \see Details::MemoryUsage */
+		memory_usage_type memoryUsage() const
+		{
+			memory_usage_type usage;
+			usage.values_ = nodes_.size() * sizeof(value_type);
+			usage.nodes_ = nodes_.size() * (sizeof(node_type) - sizeof(value_type) + sizeof(node_type*));
+			usage.slack_ = (nodes_.capacity() - nodes_.size()) * sizeof(node_type*);
+			for (auto node : nodes_)
+			{
+				usage.adjacency_ += node->targets_.allocated() - node->targets_.unused();
+				usage.slack_ += node->targets_.unused();
+				usage.indexes_ += node->targets_.indexAllocated();
+			}
+			usage.indexes_ += index_.allocated() - index_.unused();
+			usage.slack_ += index_.unused();
+
+			return usage;
+		}
+		/** Release the memory the DAG has allocated but doesn't use.
+		 * This moves the links of each node back into the node itself if they fit,
+		 * shrinks the ones that don't and the node's index of them, if any, and
+		 * shrinks the DAG's own index and list of nodes. It doesn't change the
+		 * order of the nodes or invalidate anything, except the DAG's iterators. */
+		void shrink_to_fit()
+		{
+			nodes_.shrink_to_fit();
+			for (auto node : nodes_)
+			{
+				node->targets_.shrink_to_fit();
+			}
+			index_.shrink_to_fit();
+		}
 		//! swap the contents of this container with another one of the same type
-		void swap(DAG & d) { nodes_.swap(d.nodes_); }
+		void swap(DAG & d)
+		{
+			nodes_.swap(d.nodes_);
+			std::swap(index_, d.index_);
+			std::swap(levels_dirty_, d.levels_dirty_);
+		}
+
+		/** Attach a tracer to this container, or detach the current one by passing NULL.
+		 * The tracer is not owned by the container and must outlive it (or be detached first). */
+		void setTracer(Tracer *tracer) { tracer_ = tracer; }
+		//! Get the tracer attached to this container, if any
+		Tracer * getTracer() const { return tracer_; }
+
+		/** Attach an observer to this container, or detach the current one by passing NULL.
+		 * The observer is told about the values inserted and erased, the links made and
+		 * removed, and whether the order of the values may have changed, once for each
+		 * operation (or Batch of operations). The observer is not owned by the container,
+		 * must outlive it (or be detached first) and stays with the container: it is not
+		 * copied, moved or swapped with the container's contents, and neither assignment
+		 * nor swapping is reported to it. \see Observer */
+		void setObserver(observer_type *observer) { notifier_.setObserver(observer); }
+		//! Get the observer attached to this container, if any
+		observer_type * getObserver() const { return notifier_.getObserver(); }
+
+		/** Groups the changes made to a DAG while it exists into a single notification of the DAG's observer.
+		 * Batches can be nested: the changes are reported when the outermost one ends. */
+		class Batch
+		{
+		public :
+			explicit Batch(DAG &dag)
+				: dag_(dag)
+			{
+				dag_.notifier_.begin();
+			}
+			~Batch()
+			{
+				dag_.notifier_.end();
+			}
+
+		private :
+			Batch(const Batch &);
+			Batch & operator=(const Batch &);
+
+			DAG &dag_;
+		};
+
+		/** Stages a group of changes to a DAG, to be made all at once, or not at all, by commit.
+		 * Nothing happens to the DAG until the transaction is committed. Then, the
+		 * values are inserted first, links are removed, links are made and values
+		 * are erased last, whatever the order in which they were staged. Each new
+		 * link is checked for a circular reference as it is made, but the ordering
+		 * policy only re-orders the DAG once, at the end, and the observer is told
+		 * about all of the changes at once. If anything is thrown, the changes made
+		 * so far are undone, from a log of them, and the DAG is left as it was
+		 * (though the order of values that aren't linked to each other may differ).
+		 *
+		 * For Ordering::Topological and Ordering::Insertion, committing takes time
+		 * proportional to the number of changes (and to the parts of the DAG that
+		 * new links have to be checked against), plus a sweep over the DAG if
+		 * anything is erased or rolled back. Ordering::Score re-scores and sorts
+		 * the whole DAG once.
+		 *
+		 * To commit several transactions, on different DAGs, all or nothing, prepare
+		 * each of them first: that makes the changes that can fail, and keeps the log
+		 * to undo them. Once all of them are prepared, finish each of them or, if one
+		 * of them couldn't be prepared, roll back the ones that were. Values are only
+		 * erased, and the observer only told about the changes, when a transaction is
+		 * finished. A prepared transaction must be finished or rolled back before
+		 * anything else is done to its DAG; if it is destroyed first, it is rolled back.
+		 * \code
+		 * Depends::DAG< int >::Transaction transaction(dag);
+		 * transaction.insert(3);
+		 * transaction.link(1, 3);
+		 * transaction.unlink(1, 2);
+		 * transaction.commit();
+		 * \endcode */
+		class Transaction
+		{
+		public :
+			explicit Transaction(DAG &dag)
+				: dag_(dag)
+				, prepared_(false)
+			{ /* no-op */ }
+
+			//! Roll back a transaction that was prepared but never finished, e.g. because something was thrown in between
+			~Transaction()
+			{
+				if (prepared_)
+					dag_.rollback(undo_);
+				else
+				{ /* nothing to undo */ }
+			}
+
+			//! Stage the insertion of a value, which can be linked in the same transaction
+			void insert(const value_type & val) { inserts_.push_back(val); }
+			//! Stage a link, which is skipped if it already exists (or is already implied, see setRejectImpliedLinks)
+			void link(const value_type & source, const value_type & target) { links_.emplace_back(source, target); }
+			//! Stage the removal of a link, which is skipped if there is no such link
+			void unlink(const value_type & source, const value_type & target) { unlinks_.emplace_back(source, target); }
+			//! Stage the erasure of a value, which is skipped if there is no such value
+			void erase(const value_type & val) { erases_.push_back(val); }
+
+			//! Check whether anything is staged
+			bool empty() const { return inserts_.empty() && links_.empty() && unlinks_.empty() && erases_.empty(); }
+			//! Drop the staged changes, without making them
+			void clear()
+			{
+				inserts_.clear();
+				links_.clear();
+				unlinks_.clear();
+				erases_.clear();
+			}
+
+			/** Make the staged changes, all at once or not at all. Either way, nothing is staged afterwards.
+			 * \throws circular_reference_exception if one of the links would create a circular reference
+			 * \throws std::invalid_argument if a link to make or remove is to or from a value that isn't in the DAG */
+			void commit()
+			{
+				prepare();
+				finish();
+			}
+
+			/** Make the staged changes that can fail, keeping what it takes to undo them (\see finish and rollback).
+			 * If anything is thrown, nothing is changed and nothing is staged afterwards.
+			 * \throws circular_reference_exception if one of the links would create a circular reference
+			 * \throws std::invalid_argument if a link to make or remove is to or from a value that isn't in the DAG */
+			void prepare()
+			{
+				assert(!prepared_);
+				try
+				{
+					dag_.prepare(*this);
+				}
+				catch (...)
+				{
+					clear();
+					throw;
+				}
+				prepared_ = true;
+			}
+			//! Finish a prepared transaction: erase the values and tell the observer. Nothing is staged afterwards.
+			void finish()
+			{
+				assert(prepared_);
+				Undo undo;
+				std::swap(undo, undo_);
+				prepared_ = false;
+				clear();
+				dag_.finish(undo);
+			}
+			//! Undo the changes made by preparing the transaction. Nothing is staged afterwards.
+			void rollback()
+			{
+				assert(prepared_);
+				Undo undo;
+				std::swap(undo, undo_);
+				prepared_ = false;
+				clear();
+				dag_.rollback(undo);
+			}
+
+		private :
+			Transaction(const Transaction &);
+			Transaction & operator=(const Transaction &);
+
+			//! \internal The log of the changes made by preparing the transaction
+			struct Undo
+			{
+				std::vector< node_type* > inserted_;
+				std::vector< std::pair< node_type*, node_type* > > removed_;
+				std::vector< std::pair< node_type*, node_type* > > made_;
+				std::vector< node_type* > erased_;
+			};
+
+			DAG &dag_;
+			std::vector< value_type > inserts_;
+			std::vector< std::pair< value_type, value_type > > links_;
+			std::vector< std::pair< value_type, value_type > > unlinks_;
+			std::vector< value_type > erases_;
+			Undo undo_;
+			bool prepared_;
+
+			friend class DAG;
+		};
+
+		/** Set whether links that are already implied by a path through the DAG should be refused.
+		 * When set, linking a source to a target it already reaches (directly or
+		 * not) leaves the DAG untouched and the link function returns false. Note
+		 * that this only concerns the link being made: a later link may still make
+		 * an existing one redundant, which is what reduce() is for. */
+		void setRejectImpliedLinks(bool reject) { reject_implied_links_ = reject; }
+		//! Check whether links that are already implied by a path through the DAG are refused
+		bool getRejectImpliedLinks() const { return reject_implied_links_; }
 
 		//! Equality Comparable
 		bool operator==(const DAG & d) const
@@ -250,10 +599,37 @@ namespace Depends {
 		 *         happen if the value is already in the container). */
 		std::pair<iterator, bool> insert(const value_type & val)
 		{
-			if (std::find_if(nodes_.begin(), nodes_.end(), [&val](auto node){ return *node == val; }) == nodes_.end())
+			Tracer::Span span(tracer_, "DAG", "insert");
+			Batch batch(*this);
+			span.visits(nodes_.size());
+			if (!index_.find(val))
+			{
+				node_type *node(new node_type(val));
+				OrderingPolicy::insert(nodes_, node);
+				index_.insert(node);
+				notifier_.inserted(node->value_);
+				return std::make_pair(iterator(nodes_.begin() + node->position_), true);
+			}
+			else
+			{
+				return std::make_pair(end(), false);
+			}
+		}
+
+		/** Insert a value in the container, moving it into place rather than copying it.
+		 * \see insert(const value_type &) */
+		std::pair<iterator, bool> insert(value_type && val)
+		{
+			Tracer::Span span(tracer_, "DAG", "insert");
+			Batch batch(*this);
+			span.visits(nodes_.size());
+			if (!index_.find(val))
 			{
-				nodes_.insert(nodes_.begin(), new node_type(val));
-				return std::make_pair(begin(), true);
+				node_type *node(new node_type(std::move(val)));
+				OrderingPolicy::insert(nodes_, node);
+				index_.insert(node);
+				notifier_.inserted(node->value_);
+				return std::make_pair(iterator(nodes_.begin() + node->position_), true);
 			}
 			else
 			{
@@ -261,6 +637,16 @@ namespace Depends {
 			}
 		}
 
+		/** Insert a value constructed from the given arguments in the container.
+		 * The value is constructed once and then moved into place; it is dropped
+		 * if an equal value is already in the container.
+		 * \see insert(const value_type &) */
+		template < typename... Args >
+		std::pair<iterator, bool> emplace(Args&&... args)
+		{
+			return insert(value_type(std::forward< Args >(args)...));
+		}
+
 		/** Insert a range of values into the container, skipping anything that would be a duplicate.
 		 * \param first the first iterator in the range
 		 * \param last the last iterator in the range, which is expected to point one-past-the-end */
@@ -273,23 +659,50 @@ namespace Depends {
 			}
 		}
 	
+		/** Find a value in the container, in constant time.
+		 * If the container's hash function and equality predicate are transparent,
+		 * the key can be of any type they accept; otherwise it is converted to the
+		 * container's value type first.
+		 * \return an iterator to the value, or end() if it isn't in the container */
+		template < typename Key >
+		iterator find(const Key & key) const
+		{
+			const node_type *node(index_.find(key));
+			return node ? iterator(nodes_.begin() + node->position_) : end();
+		}
+
 		/** Link two values (nodes) at the give locations
 		 * \pre neither source nor target must be the end iterator
 		 * \pre both source and target must be valid iterators of this container
 		 * \param source the source node to link
 		 * \param target the node to link to
+		 * \return false if the two were already linked directly, or if the link was refused because it was already
+		 *         implied (see setRejectImpliedLinks), true otherwise
 		 * \throws circular_reference_exception if the link would create a circular reference */
-		void link(iterator source, iterator target)
+		bool link(iterator source, iterator target)
 		{
-			{
-				Details::ScopedFlag<node_type> scoped_flag(source.node(), node_type::VISITED);
-				target.node()->visit();
-			}
-			source.node()->targets_.push_back(target.node());
+			Tracer::Span span(tracer_, "DAG", "link", source.node(), target.node());
+			Batch batch(*this);
+			node_type *source_node(source.node());
+			node_type *target_node(target.node());
+			if (source_node->targets_.contains(target_node))
+				return false;
+			else
+			{ /* not a duplicate */ }
+			// the check may re-order the nodes, so source and target may not be valid after this
+			span.visits(OrderingPolicy::check(nodes_, source_node, target_node));
+			if (reject_implied_links_ && linked(iterator(nodes_.begin() + source_node->position_), iterator(nodes_.begin() + target_node->position_)))
+				return false;
+			else
+			{ /* create the link */ }
+			source_node->targets_.insert(target_node);
 
-			target.node()->visit([](node_type *node, score_type score){ node->score_ += score; }, source.node()->score_);
+			span.visits(raiseLevels(source_node, target_node));
+			span.visits(OrderingPolicy::linked(nodes_, source_node, target_node));
+			notifier_.linked(source_node->value_, target_node->value_);
+			reordered();
 
-			std::sort(nodes_.begin(), nodes_.end(), [](auto lhs, auto rhs){ return lhs->score_ < rhs->score_; });
+			return true;
 		}
 
 		/** Link a node at a given location with a given value
@@ -297,14 +710,16 @@ namespace Depends {
 		 * \pre target must not be the end iterator and must be a valid iterator of this container
 		 * \param source the iterator at which the source value (node) can be found
 		 * \param target the value to link to 
+		 * \return false if the link was refused because it was already implied, true otherwise
 		 * \throws circular_reference_exception if the link would create a circular reference */
-		void link(iterator source, value_type target)
+		template < typename Key >
+		EnableIfKey< Key > link(iterator source, const Key & target)
 		{
-			iterator target_iter = std::find(begin(), end(), target);
+			iterator target_iter = find(target);
 
 			if (target_iter == end())
 				throw std::invalid_argument("value not found");
-			link(source, target_iter);
+			return link(source, target_iter);
 		}
 
 		/** Link a node at with a given value to a node at a given location
@@ -312,51 +727,193 @@ namespace Depends {
 		 * \pre source must not be the end iterator and must be a valid iterator of this container
 		 * \param source the value to link from
 		 * \param target the iterator at the location to link to
+		 * \return false if the link was refused because it was already implied, true otherwise
 		 * \throws circular_reference_exception if the link would create a circular reference */
-		void link(value_type source, iterator target)
+		template < typename Key >
+		EnableIfKey< Key > link(const Key & source, iterator target)
 		{
-			iterator source_iter = std::find(begin(), end(), source);
+			iterator source_iter = find(source);
 
 			if (source_iter == end())
 				throw std::invalid_argument("value not found");
-			link(source_iter, target);
+			return link(source_iter, target);
 		}
 
 		/** link two values together
 		 * \pre both values must already be in the container
 		 * \param source the value of the node to link from
 		 * \param target the value of the node to link to
+		 * \return false if the link was refused because it was already implied, true otherwise
 		 * \throws circular_reference_exception of the link would create a circular reference */
-		void link(value_type source, value_type target)
+		template < typename SourceKey, typename TargetKey >
+		EnableIfKeys< SourceKey, TargetKey > link(const SourceKey & source, const TargetKey & target)
 		{
-			iterator source_iter = std::find(begin(), end(), source);
-			iterator target_iter = std::find(begin(), end(), target);
+			iterator source_iter = find(source);
+			iterator target_iter = find(target);
 
 			if (source_iter == end() || target_iter == end())
 				throw std::invalid_argument("value not found");
-			link(source_iter, target_iter);
+			return link(source_iter, target_iter);
+		}
+
+		/** Link a node to each of the values in a range, re-ordering the DAG only once.
+		 * Either all of the links are made, or none of them are: if one of them would
+		 * create a circular reference, the ones made before it are removed again.
+		 * Links that already exist, or that are refused because they are already implied
+		 * (see setRejectImpliedLinks), are skipped.
+		 * \pre the values must already be in the container
+		 * \param source the node to link from
+		 * \param first the first of the values to link to
+		 * \param last one-past-the-end of the values to link to
+		 * \return the number of links made
+		 * \throws circular_reference_exception if one of the links would create a circular reference
+		 * \throws std::invalid_argument if one of the values is not in the container, before linking anything */
+		template < typename InputIterator >
+		size_type linkTargets(iterator source, InputIterator first, InputIterator last)
+		{
+			Tracer::Span span(tracer_, "DAG", "linkTargets", source.node());
+			std::vector< std::pair< node_type*, node_type* > > links;
+			for (; first != last; ++first)
+			{
+				links.push_back(std::make_pair(source.node(), findNode(*first)));
+			}
+			return makeLinks(links, span);
+		}
+
+		/** Link each of the values in a range to a node, re-ordering the DAG only once.
+		 * \see linkTargets for how this works
+		 * \param first the first of the values to link from
+		 * \param last one-past-the-end of the values to link from
+		 * \param target the node to link to */
+		template < typename InputIterator >
+		size_type linkSources(InputIterator first, InputIterator last, iterator target)
+		{
+			Tracer::Span span(tracer_, "DAG", "linkSources", 0, target.node());
+			std::vector< std::pair< node_type*, node_type* > > links;
+			for (; first != last; ++first)
+			{
+				links.push_back(std::make_pair(findNode(*first), target.node()));
+			}
+			return makeLinks(links, span);
+		}
+
+		/** Replace the contents of the DAG with the given values and links, built in bulk.
+		 * Rather than checking each link for a circular reference as it is made, all of
+		 * the links are made first and the whole DAG is then checked in a single pass,
+		 * after which the ordering policy orders it once, so this takes time proportional
+		 * to the number of values and links (plus a sort, for Ordering::Score). Duplicate
+		 * values and links are skipped; links that are already implied are \b not
+		 * refused, even if setRejectImpliedLinks was set (\see reduce for that).
+		 * If anything is thrown, the DAG is left untouched.
+		 * \param first_value the first of the values to put in the DAG
+		 * \param last_value one-past-the-end of the values
+		 * \param first_link the first of the links, each of which is a pair with the source and the target value as its first and second member
+		 * \param last_link one-past-the-end of the links
+		 * \throws circular_reference_exception if the links contain a circular reference
+		 * \throws std::invalid_argument if one of the links is to or from a value that isn't among the values */
+		template < typename ValueIterator, typename LinkIterator >
+		void assign(ValueIterator first_value, ValueIterator last_value, LinkIterator first_link, LinkIterator last_link)
+		{
+			Tracer::Span span(tracer_, "DAG", "assign");
+			Batch batch(*this);
+			DAG temp;
+			for (; first_value != last_value; ++first_value)
+			{
+				if (!temp.index_.find(*first_value))
+				{
+					temp.nodes_.push_back(new node_type(*first_value));
+					temp.nodes_.back()->position_ = temp.nodes_.size() - 1;
+					temp.index_.insert(temp.nodes_.back());
+				}
+				else
+				{ /* duplicate value */ }
+			}
+			for (; first_link != last_link; ++first_link)
+			{
+				node_type *source_node(temp.findNode(first_link->first));
+				node_type *target_node(temp.findNode(first_link->second));
+				source_node->targets_.insert(target_node);
+			}
+			// Kahn's algorithm never gets to the nodes on (or after) a cycle
+			nodes_type order;
+			order.reserve(temp.nodes_.size());
+			Details::kahn(temp.nodes_, [&order](node_type *node){ order.push_back(node); });
+			span.visits(temp.nodes_.size());
+			if (order.size() != temp.nodes_.size())
+				throw circular_reference_exception("Circular reference detected");
+			else
+			{ /* acyclic */ }
+			if (OrderingPolicy::topological)
+			{
+				temp.nodes_.swap(order);
+				temp.renumber();
+			}
+			else
+			{ /* the nodes stay in the order they were given in */ }
+			temp.levels_dirty_ = true;
+			OrderingPolicy::relinked(temp.nodes_);
+			if (getObserver())
+			{
+				// only what actually changes is reported: links that are in both cancel out,
+				// and the links to and from the values that go are forgotten
+				for (auto node : nodes_)
+				{
+					if (!temp.index_.find(node->value_))
+						notifier_.erased(node->value_, node->value_);
+					else
+					{ /* stays */ }
+					for (auto target : node->targets_)
+					{
+						notifier_.unlinked(node->value_, target->value_);
+					}
+				}
+				for (auto node : temp.nodes_)
+				{
+					if (!index_.find(node->value_))
+						notifier_.inserted(node->value_);
+					else
+					{ /* was already there */ }
+					for (auto target : node->targets_)
+					{
+						notifier_.linked(node->value_, target->value_);
+					}
+				}
+				reordered();
+			}
+			else
+			{ /* no-one to tell */ }
+			swap(temp);
 		}
 
 		//! check whether the source and target nodes are linked
 		bool linked(iterator source, iterator target) const
 		{
+			Tracer::Span span(tracer_, "DAG", "linked", source.node(), target.node());
+			if (source.node()->targets_.contains(target.node()))
+				return true;
+			else
+			{ /* look for a path */ }
+			std::size_t visits(0);
 			try
 			{
 				Details::ScopedFlag<node_type> scoped_flag(target.node(), node_type::VISITED);
-				source.node()->visit();
+				source.node()->visit([](node_type *, std::size_t *visits){ ++*visits; }, &visits);
 			}
 			catch (circular_reference_exception &)
 			{
+				span.visits(visits);
 				return true;
 			}
+			span.visits(visits);
 
 			return false;
 		}
 
 		//! check whether the source and target nodes are linked
-		bool linked(iterator source, value_type target) const
+		template < typename Key >
+		EnableIfKey< Key > linked(iterator source, const Key & target) const
 		{
-			iterator target_iter = std::find(begin(), end(), target);
+			iterator target_iter = find(target);
 
 			if (target_iter == end())
 				return false;
@@ -364,9 +921,10 @@ namespace Depends {
 		}
 
 		//! check whether the source and target nodes are linked
-		bool linked(value_type source, iterator target) const
+		template < typename Key >
+		EnableIfKey< Key > linked(const Key & source, iterator target) const
 		{
-			iterator source_iter = std::find(begin(), end(), source);
+			iterator source_iter = find(source);
 
 			if (source_iter == end())
 				return false;
@@ -374,41 +932,157 @@ namespace Depends {
 		}
 
 		//! check whether the source and target nodes are linked
-		bool linked(value_type source, value_type target) const
+		template < typename SourceKey, typename TargetKey >
+		EnableIfKeys< SourceKey, TargetKey > linked(const SourceKey & source, const TargetKey & target) const
 		{
-			iterator source_iter = std::find(begin(), end(), source);
-			iterator target_iter = std::find(begin(), end(), target);
+			iterator source_iter = find(source);
+			iterator target_iter = find(target);
 
 			if (source_iter == end() || target_iter == end())
 				return false;
 			return linked(source_iter, target_iter);
 		}
 
+		/** Check, for each of a range of (source, target) pairs of values, whether the source is linked to the target.
+		 * This answers many queries at once by sharing the work between them: the
+		 * pairs are grouped by source, and each group of up to 64 sources is handled
+		 * in a single pass over the DAG in topological order, in which each node
+		 * gets a 64-bit set of the sources that reach it. When the DAG is kept in
+		 * topological order, the pass starts at the first of the group's sources.
+		 * A value is considered linked to itself, as it is by linked, and a value
+		 * that isn't in the container isn't linked to anything.
+		 * \param first the first of the pairs, each of which has the source and the target as its first and second member
+		 * \param last one-past-the-end of the pairs
+		 * \return a vector with the answer for each pair, in order */
+		template < typename InputIterator >
+		std::vector< bool > linkedAll(InputIterator first, InputIterator last) const
+		{
+			Tracer::Span span(tracer_, "DAG", "linkedAll");
+			std::vector< std::pair< const node_type*, const node_type* > > queries;
+			for (; first != last; ++first)
+			{
+				queries.push_back(std::make_pair(index_.find(first->first), index_.find(first->second)));
+			}
+			std::vector< bool > retval(queries.size(), false);
+
+			// the distinct sources, in the DAG's order
+			std::vector< const node_type* > sources;
+			for (auto query : queries)
+			{
+				if (query.first && query.second)
+					sources.push_back(query.first);
+				else
+				{ /* the answer is no */ }
+			}
+			std::sort(sources.begin(), sources.end(), [](auto lhs, auto rhs){ return lhs->position_ < rhs->position_; });
+			sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+			if (sources.empty())
+				return retval;
+			else
+			{ /* there's something to look for */ }
+
+			typedef unsigned long long Mask;
+			const size_type width(sizeof(Mask) * 8);
+			std::vector< const node_type* > order;
+			if (!OrderingPolicy::topological)
+			{
+				order.reserve(nodes_.size());
+				inTopologicalOrder([&order](node_type *node){ order.push_back(node); });
+			}
+			else
+			{ /* the DAG's own order will do */ }
+			// the index of each source, from which its group and its bit within the group follow
+			std::vector< size_type > indices(nodes_.size(), 0);
+			for (size_type which(0); which < sources.size(); ++which)
+			{
+				indices[sources[which]->position_] = which;
+			}
+			std::vector< std::vector< size_type > > grouped((sources.size() + width - 1) / width);
+			for (size_type which(0); which < queries.size(); ++which)
+			{
+				if (queries[which].first && queries[which].second)
+					grouped[indices[queries[which].first->position_] / width].push_back(which);
+				else
+				{ /* not linked */ }
+			}
+			std::vector< Mask > masks(nodes_.size());
+			for (size_type group(0); group < grouped.size(); ++group)
+			{
+				const size_type begin(group * width);
+				const size_type end(std::min(begin + width, sources.size()));
+				std::fill(masks.begin(), masks.end(), 0);
+				for (size_type which(begin); which < end; ++which)
+				{
+					masks[sources[which]->position_] |= Mask(1) << (which - begin);
+				}
+				auto propagate = [&masks](const node_type *node){
+						const Mask mask(masks[node->position_]);
+						if (mask)
+						{
+							for (auto target : node->targets_)
+							{
+								masks[target->position_] |= mask;
+							}
+						}
+						else
+						{ /* reached from none of the sources */ }
+					};
+				if (OrderingPolicy::topological)
+				{
+					for (size_type position(sources[begin]->position_); position < nodes_.size(); ++position)
+					{
+						propagate(nodes_[position]);
+					}
+				}
+				else
+				{
+					std::for_each(order.begin(), order.end(), propagate);
+				}
+				span.visits(nodes_.size());
+				for (auto which : grouped[group])
+				{
+					const size_type bit(indices[queries[which].first->position_] % width);
+					retval[which] = (masks[queries[which].second->position_] >> bit) & 1;
+				}
+			}
+
+			return retval;
+		}
+
 		//! unlink source from target if they are linked
 		bool unlink(iterator source, iterator target)
 		{
+			Tracer::Span span(tracer_, "DAG", "unlink", source.node(), target.node());
+			Batch batch(*this);
 			bool rv(true);
-			typename node_type::targets_type::iterator where(std::find(source.node()->targets_.begin(), source.node()->targets_.end(), target.node()));
-			if (where != source.node()->targets_.end())
+			if (source.node()->targets_.erase(target.node()))
 			{
-				source.node()->targets_.erase(where);
+				// the target's level may have come from this link, in which case it (and
+				// those of the nodes it links to) may drop - but we can't tell without
+				// looking at everything else that links to it, so that's left for later.
+				if (target.node()->level_ == source.node()->level_ + 1)
+					levels_dirty_ = true;
+				else
+				{ /* some other path to the target is at least as long */ }
+
+				// the policy may re-order the nodes, after which the iterators no longer point to them
+				notifier_.unlinked(source.node()->value_, target.node()->value_);
+				span.visits(OrderingPolicy::unlinked(nodes_, source.node(), target.node()));
+				reordered();
 			}
 			else
 			{
 				rv = false;
 			}
 
-			target.node()->visit([](node_type *node, score_type score){ node->score_ -= score; }, source.node()->score_);
-
-			std::sort(nodes_.begin(), nodes_.end());
-
 			return rv;
 		}
 
 		//! unlink source from target if they are linked
-		bool unlink(iterator source, value_type target)
+		template < typename Key >
+		EnableIfKey< Key > unlink(iterator source, const Key & target)
 		{
-			iterator target_iter = std::find(begin(), end(), target);
+			iterator target_iter = find(target);
 
 			if (target_iter == end())
 				throw std::invalid_argument("value not found");
@@ -416,9 +1090,10 @@ namespace Depends {
 		}
 
 		//! unlink source from target if they are linked
-		bool unlink(value_type source, iterator target)
+		template < typename Key >
+		EnableIfKey< Key > unlink(const Key & source, iterator target)
 		{
-			iterator source_iter = std::find(begin(), end(), source);
+			iterator source_iter = find(source);
 
 			if (source_iter == end())
 				throw std::invalid_argument("value not found");
@@ -426,85 +1101,692 @@ namespace Depends {
 		}
 
 		//! unlink source from target if they are linked
-		bool unlink(value_type source, value_type target)
+		template < typename SourceKey, typename TargetKey >
+		EnableIfKeys< SourceKey, TargetKey > unlink(const SourceKey & source, const TargetKey & target)
 		{
-			iterator source_iter = std::find(begin(), end(), source);
-			iterator target_iter = std::find(begin(), end(), target);
+			iterator source_iter = find(source);
+			iterator target_iter = find(target);
 
 			if (source_iter == end() || target_iter == end())
 				throw std::invalid_argument("value not found");
 			return unlink(source_iter, target_iter);
 		}
 
-		/** erase the node at the given iterator, unlinking it from the DAG
-		 * \pre the iterator must be a valid iterator within this container and must not be end
-		 * \param where the iterator indicating the value to delete from the container.*/
-		iterator erase(iterator where)
+		/** Get all nodes of the DAG, partitioned into levels.
+		 * Nodes nothing links to are on level 0, and all nodes on any given level are
+		 * linked to only from nodes on earlier levels. The levels are maintained as
+		 * links are made, so this takes time proportional to the number of nodes:
+		 * only after a link was removed from a node that got its level from it, or
+		 * after nodes that linked to others were erased, are the levels recomputed, which takes
+		 * time proportional to the number of nodes and links.
+		 * \return the levels, each of which contains pointers to the values of its nodes */
+		levels_type levels() const
+		{
+			Tracer::Span span(tracer_, "DAG", "levels");
+			updateLevels();
+			span.visits(nodes_.size());
+
+			std::vector< size_type > sizes;
+			for (auto node : nodes_)
+			{
+				if (node->level_ >= sizes.size())
+					sizes.resize(node->level_ + 1, 0);
+				else
+				{ /* level already known */ }
+				++sizes[node->level_];
+			}
+			std::vector< size_type > ends(sizes.size());
+			std::partial_sum(sizes.begin(), sizes.end(), ends.begin());
+			std::vector< size_type > next(ends.size());
+			std::transform(ends.begin(), ends.end(), sizes.begin(), next.begin(), std::minus< size_type >());
+			std::vector< const_pointer > values(nodes_.size());
+			for (auto node : nodes_)
+			{
+				values[next[node->level_]++] = &node->value_;
+			}
+
+			return levels_type(std::move(values), std::move(ends));
+		}
+
+		/** Get the level of the node at the given location.
+		 * \pre where must be a valid iterator of this container and must not be end
+		 * \see levels */
+		size_type level(const_iterator where) const
+		{
+			updateLevels();
+			return where.node()->level_;
+		}
+
+		/** Get a single-pass range over all values in the DAG, in topological order.
+		 * Whatever the DAG's ordering policy, each value comes after all of the values
+		 * that link to it. The order is produced as the range is iterated (\see
+		 * Details::TopologicalRange), so this costs a count for each node and a pass
+		 * over the links, but no sorting. The range is valid only as long as the DAG
+		 * doesn't change. */
+		topological_range topological() const
 		{
-			while (!where.node()->targets_.empty())
+			Tracer::Span span(tracer_, "DAG", "topological");
+			span.visits(nodes_.size());
+			return topological_range(nodes_);
+		}
+		/** Get a single-pass range over the given values and all values they link to, directly or not, in topological order.
+		 * This only visits the part of the DAG the values reach. \see topological()
+		 * \param first the first of the values to start from
+		 * \param last one-past-the-end of the values to start from
+		 * \throws std::invalid_argument if one of the values is not in the container */
+		template < typename InputIterator >
+		topological_range topological(InputIterator first, InputIterator last) const
+		{
+			Tracer::Span span(tracer_, "DAG", "topological");
+			std::vector< node_type const* > starts;
+			for (; first != last; ++first)
 			{
-				unlink(where, (where.node()->targets_[0])->value_);
+				starts.push_back(findNode(*first));
 			}
-			auto target(where.node());
-			std::for_each(
-				  nodes_.begin()
-				, nodes_.end()
-				, [target](auto *node) {
-						typedef typename std::remove_reference< decltype(*node) >::type NodeType;
-						typedef typename NodeType::targets_type Targets;
-						typename Targets::iterator end(node->targets_.end());
-						for (typename Targets::iterator which(node->targets_.begin()); which != end; )
+			return topological_range(starts.begin(), starts.end());
+		}
+
+		/** Compute the transitive closure of the DAG: for each node, the set of nodes it links to, directly or not.
+		 * This is done for all nodes at once, in a single pass over the DAG from its
+		 * last level to its first (\see levels), in which each node's set is the
+		 * union of those of its targets. Sets are rows of bits, so each union is a
+		 * word-by-word OR. The nodes on each level are shared between the given
+		 * number of threads.
+		 *
+		 * The full closure takes a bit for each pair of nodes. If only the number of
+		 * nodes each node reaches is needed, pass closure_type::COUNT_ONLY, which
+		 * drops each row as soon as all nodes that link to it are done with it.
+		 * \param mode whether to keep the full closure, or only its counts
+		 * \param threads the number of threads to use, or 0 to use one per core
+		 * \return the closure, in which the nodes are numbered in the DAG's order */
+		closure_type closure(typename closure_type::Mode mode = closure_type::FULL, unsigned int threads = 0) const
+		{
+			Tracer::Span span(tracer_, "DAG", "closure");
+			updateLevels();
+			span.visits(nodes_.size());
+			return Details::computeClosure< closure_type >(nodes_, mode, threads);
+		}
+
+		/** Remove every link that is implied by another path through the DAG.
+		 * After this, the DAG is its own transitive reduction: a source is linked
+		 * directly to a target only if there is no other path from the one to the
+		 * other. Whether two nodes are linked, and therefore the order of the
+		 * nodes in the DAG, does not change, but the scores do.
+		 *
+		 * The DAG is reduced in a single pass over its nodes. For each node, its
+		 * targets are considered in topological order and everything reachable from each of
+		 * them is marked, so any target that was already marked is implied by an
+		 * earlier one. Nothing reachable is marked twice for the same node.
+		 * \return the number of links removed */
+		size_type reduce()
+		{
+			Tracer::Span span(tracer_, "DAG", "reduce");
+			Batch batch(*this);
+			size_type removed(0);
+			// a target can only be reached through targets that precede it in topological order,
+			// which is the DAG's own order unless its ordering policy says otherwise
+			std::vector< size_type > ranks;
+			if (!OrderingPolicy::topological)
+			{
+				ranks.resize(nodes_.size());
+				size_type rank(0);
+				inTopologicalOrder([&ranks, &rank](node_type *node){ ranks[node->position_] = rank++; });
+			}
+			else
+			{ /* the positions will do */ }
+			auto rank = [&ranks](node_type *node){ return OrderingPolicy::topological ? node->position_ : ranks[node->position_]; };
+			std::vector< size_type > marks(nodes_.size(), 0);
+			std::vector< node_type* > stack;
+			std::vector< node_type* > targets;
+			for (size_type position(0); position < nodes_.size(); ++position)
+			{
+				if (nodes_[position]->targets_.size() < 2)
+					continue;
+				else
+				{ /* some of the targets may be implied by others */ }
+				targets.assign(nodes_[position]->targets_.begin(), nodes_[position]->targets_.end());
+				std::sort(targets.begin(), targets.end(), [&rank](auto lhs, auto rhs){ return rank(lhs) < rank(rhs); });
+				const size_type mark(position + 1);
+				typename std::vector< node_type* >::iterator kept(targets.begin());
+				for (auto target : targets)
+				{
+					if (marks[target->position_] == mark)
+					{	// implied by an earlier target
+						notifier_.unlinked(nodes_[position]->value_, target->value_);
+						continue;
+					}
+					else
+					{ /* keep this one and mark everything it reaches */ }
+					*kept++ = target;
+					stack.assign(target->targets_.begin(), target->targets_.end());
+					while (!stack.empty())
+					{
+						node_type *node(stack.back());
+						stack.pop_back();
+						size_type &node_mark(marks[node->position_]);
+						if (node_mark != mark)
 						{
-							if (*which == target)
-							{
-								which = node->targets_.erase(which);
-							}
-							else
-							{
-								++which;
-							}
+							node_mark = mark;
+							span.visits(1);
+							stack.insert(stack.end(), node->targets_.begin(), node->targets_.end());
 						}
+						else
+						{ /* already reached through another path */ }
 					}
-				);
+				}
+				if (kept != targets.end())
+				{
+					removed += targets.end() - kept;
+					nodes_[position]->targets_.assign(targets.begin(), kept);
+				}
+				else
+				{ /* nothing implied */ }
+			}
 
-			delete where.node();
-			typename nodes_type::iterator whence(nodes_.erase(where.iter_));
+			if (removed)
+			{
+				OrderingPolicy::relinked(nodes_);
+				reordered();
+			}
+			else
+			{ /* nothing changed */ }
 
-			return iterator(whence);
+			return removed;
+		}
+
+		/** erase the node at the given iterator, unlinking it from the DAG
+		 * \pre the iterator must be a valid iterator within this container and must not be end
+		 * \param where the iterator indicating the value to delete from the container.*/
+		iterator erase(iterator where)
+		{
+			iterator next(where);
+			return erase(where, ++next);
 		}
 	
-		/** erase the values in the given range.
+		/** erase the values in the given range, unlinking them from the DAG.
+		 * The whole range is detached in a single sweep over the DAG's links, so
+		 * this takes time proportional to the number of nodes and links in the
+		 * DAG, regardless of the number of values erased. As erasing a node lowers
+		 * the scores of whatever it linked to, the remaining nodes may be re-ordered.
 		 * \pre both begin and end must be valid iterators in this container
 		 * \pre end must be reachable by incrementing from begin
 		 * \param begin iterator pointing to the first value to delete from the container
-		 * \param end iterator pointing one-past-the-end of the range to delete */
+		 * \param end iterator pointing one-past-the-end of the range to delete
+		 * \return an iterator to the node that is now at begin's position */
 		iterator erase(iterator begin, iterator end)
 		{
-			for (iterator where(begin); where != end; ++where)
+			Tracer::Span span(tracer_, "DAG", "erase", begin == end ? 0 : begin.node());
+			span.visits(nodes_.size());
+			size_type position(begin.iter_ - nodes_.begin());
+			std::vector< bool > erased(nodes_.size(), false);
+			std::fill(erased.begin() + position, erased.begin() + (end.iter_ - nodes_.begin()), true);
+			sweep(erased);
+			return iterator(nodes_.begin() + std::min(position, nodes_.size()));
+		}
+
+		/** erase all values for which the given predicate returns true, unlinking them from the DAG.
+		 * Like erasing a range, this takes a single sweep over the DAG's nodes and links.
+		 * \param pred a predicate called once with each value in the DAG
+		 * \return the number of values erased */
+		template < typename Predicate >
+		size_type eraseIf(Predicate pred)
+		{
+			Tracer::Span span(tracer_, "DAG", "erase");
+			span.visits(nodes_.size());
+			std::vector< bool > erased(nodes_.size(), false);
+			size_type count(0);
+			for (size_type position(0); position < nodes_.size(); ++position)
 			{
-				delete where.node();
+				if (pred(static_cast< const_reference >(nodes_[position]->value_)))
+				{
+					erased[position] = true;
+					++count;
+				}
+				else
+				{ /* keep this one */ }
 			}
-			return iterator(nodes_.erase(begin.iter_, end.iter_));
+			if (count)
+				sweep(erased);
+			else
+			{ /* nothing to erase */ }
+
+			return count;
 		}
 
 		/** Clear the DAG of all its contents.
-		 * \internal Note that this implementation doesn't meet the standard's 
-		 *           performance requirements. */
+		 * This only deletes the nodes: as none of them remain, there is nothing
+		 * to unlink, so this takes time proportional to the number of nodes. */
 		void clear()
 		{
-			erase(begin(), end());
+			Batch batch(*this);
+			for (auto node : nodes_)
+			{
+				notifier_.erased(node->value_, node->value_);
+				delete node;
+			}
+			nodes_.clear();
+			index_.clear();
+			levels_dirty_ = false;
 		}
 		
 	private :
+		//! \internal Find the node of a value that must be in the container
+		template < typename Key >
+		node_type * findNode(const Key & key) const
+		{
+			node_type *node(const_cast< node_type* >(index_.find(key)));
+			if (!node)
+				throw std::invalid_argument("value not found");
+			else
+			{ /* found it */ }
+			return node;
+		}
+
+		/** \internal Make the given links, all or nothing, re-ordering the DAG only once.
+		 * Each link is checked for circular references as it is made, exactly as link
+		 * does, but the ordering policy is only told about the new links at the end.
+		 * \return the number of links made */
+		size_type makeLinks(std::vector< std::pair< node_type*, node_type* > > const &links, Tracer::Span &span)
+		{
+			Batch batch(*this);
+			std::vector< std::pair< node_type*, node_type* > > made;
+			try
+			{
+				for (auto link : links)
+				{
+					node_type *source_node(link.first);
+					node_type *target_node(link.second);
+					if (source_node->targets_.contains(target_node))
+						continue;
+					else
+					{ /* not a duplicate */ }
+					span.visits(OrderingPolicy::check(nodes_, source_node, target_node));
+					if (reject_implied_links_ && linked(iterator(nodes_.begin() + source_node->position_), iterator(nodes_.begin() + target_node->position_)))
+						continue;
+					else
+					{ /* create the link */ }
+					source_node->targets_.insert(target_node);
+					made.push_back(link);
+					span.visits(raiseLevels(source_node, target_node));
+				}
+			}
+			catch (...)
+			{
+				for (auto link : made)
+				{
+					link.first->targets_.erase(link.second);
+				}
+				if (!made.empty())
+				{
+					levels_dirty_ = true;
+					OrderingPolicy::relinked(nodes_);
+				}
+				else
+				{ /* nothing to undo */ }
+				throw;
+			}
+			if (!made.empty())
+			{
+				OrderingPolicy::relinked(nodes_);
+				for (auto link : made)
+				{
+					notifier_.linked(link.first->value_, link.second->value_);
+				}
+				reordered();
+			}
+			else
+			{ /* nothing changed */ }
+
+			return made.size();
+		}
+
+		/** \internal Make the changes staged in a transaction that can fail, all or nothing, logging them in the transaction (\see Transaction).
+		 * The new nodes are added at the end of the DAG, which keeps it in topological
+		 * order as they aren't linked to anything yet; the ordering policy is told
+		 * about all of the new nodes and links at once, when the transaction is finished. */
+		void prepare(Transaction &transaction)
+		{
+			Tracer::Span span(tracer_, "DAG", "prepare");
+			Batch batch(*this);
+			std::vector< node_type* > &inserted(transaction.undo_.inserted_);
+			std::vector< std::pair< node_type*, node_type* > > &removed(transaction.undo_.removed_);
+			std::vector< std::pair< node_type*, node_type* > > &made(transaction.undo_.made_);
+			std::vector< node_type* > &erased(transaction.undo_.erased_);
+			try
+			{
+				nodes_.reserve(nodes_.size() + transaction.inserts_.size());
+				inserted.reserve(transaction.inserts_.size());
+				for (auto const &val : transaction.inserts_)
+				{
+					if (!index_.find(val))
+					{
+						std::unique_ptr< node_type > node(new node_type(val));
+						node->position_ = nodes_.size();
+						index_.insert(node.get());
+						nodes_.push_back(node.get());
+						inserted.push_back(node.release());
+					}
+					else
+					{ /* already there */ }
+				}
+				// look everything up before changing any links
+				std::vector< std::pair< node_type*, node_type* > > unlinks;
+				for (auto const &unlink : transaction.unlinks_)
+				{
+					unlinks.emplace_back(findNode(unlink.first), findNode(unlink.second));
+				}
+				std::vector< std::pair< node_type*, node_type* > > links;
+				for (auto const &link : transaction.links_)
+				{
+					links.emplace_back(findNode(link.first), findNode(link.second));
+				}
+				for (auto const &val : transaction.erases_)
+				{
+					node_type *node(index_.find(val));
+					if (node)
+						erased.push_back(node);
+					else
+					{ /* nothing to erase */ }
+				}
+				span.visits(inserted.size() + unlinks.size() + links.size() + erased.size());
+
+				for (auto unlink : unlinks)
+				{
+					if (unlink.first->targets_.erase(unlink.second))
+						removed.push_back(unlink);
+					else
+					{ /* not linked */ }
+				}
+				for (auto link : links)
+				{
+					if (link.first->targets_.contains(link.second))
+						continue;
+					else
+					{ /* not a duplicate */ }
+					span.visits(OrderingPolicy::check(nodes_, link.first, link.second));
+					if (reject_implied_links_ && linked(iterator(nodes_.begin() + link.first->position_), iterator(nodes_.begin() + link.second->position_)))
+						continue;
+					else
+					{ /* create the link */ }
+					link.first->targets_.insert(link.second);
+					made.push_back(link);
+					span.visits(raiseLevels(link.first, link.second));
+				}
+			}
+			catch (...)
+			{
+				rollback(transaction.undo_);
+				transaction.undo_ = typename Transaction::Undo();
+				throw;
+			}
+		}
+
+		/** \internal Finish a prepared transaction, from its undo log: tell the ordering policy and the observer about its changes and erase its values */
+		void finish(typename Transaction::Undo const &undo)
+		{
+			Tracer::Span span(tracer_, "DAG", "finish");
+			Batch batch(*this);
+			std::vector< node_type* > const &inserted(undo.inserted_);
+			std::vector< std::pair< node_type*, node_type* > > const &removed(undo.removed_);
+			std::vector< std::pair< node_type*, node_type* > > const &made(undo.made_);
+			std::vector< node_type* > const &erased(undo.erased_);
+			if (!removed.empty())
+				levels_dirty_ = true;
+			else
+			{ /* removing no links lowers no levels */ }
+			if (!inserted.empty() || !removed.empty() || !made.empty())
+			{
+				OrderingPolicy::relinked(nodes_);
+				for (auto node : inserted)
+				{
+					notifier_.inserted(node->value_);
+				}
+				for (auto unlink : removed)
+				{
+					notifier_.unlinked(unlink.first->value_, unlink.second->value_);
+				}
+				for (auto link : made)
+				{
+					notifier_.linked(link.first->value_, link.second->value_);
+				}
+				reordered();
+			}
+			else
+			{ /* nothing changed */ }
+			if (!erased.empty())
+			{
+				std::vector< bool > flags(nodes_.size(), false);
+				for (auto node : erased)
+				{
+					flags[node->position_] = true;
+				}
+				sweep(flags);
+			}
+			else
+			{ /* nothing to erase */ }
+		}
+
+		/** \internal Undo the changes made by preparing a transaction, from its undo log, newest first.
+		 * The links that were removed are checked as they are restored, as if they were new,
+		 * as that lets the ordering policy put their nodes back in order. */
+		void rollback(typename Transaction::Undo const &undo)
+		{
+			Batch batch(*this);
+			std::vector< node_type* > const &inserted(undo.inserted_);
+			std::vector< std::pair< node_type*, node_type* > > const &removed(undo.removed_);
+			std::vector< std::pair< node_type*, node_type* > > const &made(undo.made_);
+			for (auto link : made)
+			{
+				link.first->targets_.erase(link.second);
+			}
+			for (auto unlink : removed)
+			{
+				OrderingPolicy::check(nodes_, unlink.first, unlink.second);
+				unlink.first->targets_.insert(unlink.second);
+			}
+			if (!inserted.empty())
+			{
+				std::vector< bool > discarded(nodes_.size(), false);
+				for (auto node : inserted)
+				{
+					discarded[node->position_] = true;
+					index_.erase(node);
+				}
+				typename nodes_type::iterator kept(nodes_.begin());
+				for (auto node : nodes_)
+				{
+					if (discarded[node->position_])
+					{
+						delete node;
+					}
+					else
+					{
+						*kept++ = node;
+					}
+				}
+				nodes_.erase(kept, nodes_.end());
+				renumber();
+			}
+			else
+			{ /* nothing to discard */ }
+			if (!made.empty() || !removed.empty())
+			{
+				levels_dirty_ = true;
+				OrderingPolicy::relinked(nodes_);
+				reordered();
+			}
+			else
+			{ /* the links are as they were */ }
+		}
+
+		/** \internal Raise the levels of target, and of whatever it links to, after it was linked to from source.
+		 * \return the number of nodes visited */
+		std::size_t raiseLevels(node_type *source, node_type *target)
+		{
+			if (levels_dirty_ || target->level_ > source->level_)
+				return 0;
+			else
+			{ /* target's level is raised, which may raise that of its own targets */ }
+			std::size_t visits(0);
+			target->level_ = source->level_ + 1;
+			std::vector< node_type* > stack(1, target);
+			while (!stack.empty())
+			{
+				node_type *node(stack.back());
+				stack.pop_back();
+				++visits;
+				for (auto next : node->targets_)
+				{
+					if (next->level_ <= node->level_)
+					{
+						next->level_ = node->level_ + 1;
+						stack.push_back(next);
+					}
+					else
+					{ /* already deep enough */ }
+				}
+			}
+
+			return visits;
+		}
+
+		//! \internal Recompute the levels of all nodes, if they need to be, in a single pass
+		void updateLevels() const
+		{
+			if (!levels_dirty_)
+				return;
+			else
+			{ /* recompute */ }
+			for (auto node : nodes_)
+			{
+				node->level_ = 0;
+			}
+			inTopologicalOrder([](node_type *node){
+					for (auto target : node->targets_)
+					{
+						target->level_ = std::max(target->level_, node->level_ + 1);
+					}
+				});
+			levels_dirty_ = false;
+		}
+
+		/** \internal Erase the nodes at the positions flagged in erased, in a single sweep.
+		 * First, the links to the erased nodes are removed from the nodes that remain;
+		 * then the erased nodes are deleted. Only if one of them linked to a remaining
+		 * node do the scores and levels change, in which case the ordering policy is told
+		 * so: the remaining nodes are still in the order the policy keeps them in, so any
+		 * re-scoring it does is a single pass.
+		 * \param erased a flag for each node in the DAG, in the DAG's order */
+		void sweep(std::vector< bool > const &erased)
+		{
+			Batch batch(*this);
+			bool rescore_needed(false);
+			for (auto node : nodes_)
+			{
+				typename node_type::targets_type &targets(node->targets_);
+				if (erased[node->position_])
+				{
+					rescore_needed = rescore_needed || std::any_of(targets.begin(), targets.end(), [&erased](auto target){ return !erased[target->position_]; });
+				}
+				else
+				{
+					targets.eraseIf([&erased](auto target){ return erased[target->position_]; });
+				}
+			}
+			typename nodes_type::iterator kept(nodes_.begin());
+			for (auto node : nodes_)
+			{
+				if (erased[node->position_])
+				{
+					notifier_.erased(node->value_, node->value_);
+					index_.erase(node);
+					delete node;
+				}
+				else
+				{
+					*kept++ = node;
+				}
+			}
+			nodes_.erase(kept, nodes_.end());
+			renumber();
+			if (rescore_needed)
+			{
+				levels_dirty_ = true;
+				OrderingPolicy::relinked(nodes_);
+				reordered();
+			}
+			else
+			{ /* nothing that remains was linked to from what was erased, so only the positions changed */ }
+		}
+
+		/** \internal Call f with each node, in topological order.
+		 * If the ordering policy keeps the nodes in topological order, that is the
+		 * DAG's own order; otherwise, it is computed using Kahn's algorithm, which
+		 * takes time proportional to the number of nodes and links. */
+		template < typename F >
+		void inTopologicalOrder(F f) const
+		{
+			if (OrderingPolicy::topological)
+			{
+				for (auto node : nodes_)
+				{
+					f(node);
+				}
+			}
+			else
+			{
+				Details::kahn(nodes_, f);
+			}
+		}
+
+		//! \internal Tell the observer, if any, that the order of the nodes may have changed - unless the ordering policy doesn't depend on the links
+		void reordered()
+		{
+			if (!std::is_same< OrderingPolicy, Ordering::Insertion >::value)
+				notifier_.reordered();
+			else
+			{ /* the nodes stay in the order they were inserted in */ }
+		}
+
+		//! \internal Tell the nodes from the given position onward where they are in the DAG's order
+		void renumber(size_type from = 0)
+		{
+			Details::renumber(nodes_, from, nodes_.size());
+		}
+
 #if DEPENDS_SUPPORT_SERIALIZATION
 		template < typename Archive >
 		void serialize( Archive & ar, const unsigned int version )
 		{
 			ar & boost::serialization::make_nvp("nodes_", nodes_);
+			// levels, positions and the index are not serialized
+			levels_dirty_ = true;
+			if (Archive::is_loading::value)
+			{
+				index_.clear();
+				index_.reserve(nodes_.size());
+				for (auto node : nodes_)
+				{
+					index_.insert(node);
+				}
+				renumber();
+			}
+			else
+			{ /* nothing to rebuild */ }
 		}
 #endif
 
 		mutable nodes_type nodes_;
+		//! \internal The hash index used to find the nodes by value
+		Details::Index< node_type, Hash, KeyEqual > index_;
+		//! \internal The tracer attached to this container, if any
+		Tracer *tracer_;
+		//! \internal Whether links that are already implied are refused
+		bool reject_implied_links_;
+		//! \internal Whether the nodes' levels need to be recomputed before they can be used
+		mutable bool levels_dirty_;
+		//! \internal Collects the changes to report to the observer, if any
+		Details::Notifier< ValueType, ValueType, Hash, KeyEqual, Details::Identity > notifier_;
 
 #if DEPENDS_SUPPORT_SERIALIZATION
 		friend class boost::serialization::access;
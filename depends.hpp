@@ -36,9 +36,16 @@
 #define depends_depends_hpp
 
 #include "dag.hpp"
+#include "details/hyperloglog.hpp"
 #include <algorithm>
 #include <cassert>
+#include <memory>
 #include <set>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace Depends
 {
@@ -52,7 +59,8 @@ namespace Depends
 	 *     that corresponds to a given predicate
 	 *
 	 * This dependency tracker, unlike the DAG class, is neither CopyConstructible 
-	 * nor Assignable and does, therefore, \b not completely emulate an STL container. 
+	 * nor CopyAssignable and does, therefore, \b not completely emulate an STL container. 
+	 * It can, however, be moved, which doesn't move or copy any of the values in it.
 	 * 
 	 * The dependency tracker contains an internal storage to which you can add 
 	 * elements, which (even) remain mutable. Its purpose is to track the dependencies 
@@ -90,18 +98,44 @@ namespace Depends
 	 * \until }
 	 * The same is true for the \link Depends::getPrerequisites getPrerequisites \enlink
 	 * method.
+	 *
+	 * \section explicit_nodes Working without a selection
+	 * Each of the functions that work on the selected item also exists in a version
+	 * that takes an iterator to the item to work on as its first argument, which
+	 * neither needs nor changes the selection. This is also the only way to query
+	 * the tracker from several threads at the same time: \c getPrerequisites,
+	 * \c getDependants and \c depends don't change anything in the tracker when
+	 * called this way, not even the flags of the DAGs it uses. Dependencies can be added
+	 * in bulk using \link Depends::addPrerequisites addPrerequisites \endlink and
+	 * \link Depends::addDependants addDependants \endlink, which make all of the
+	 * links in one go.
+	 *
+	 * \section estimates Estimating the number of dependants
+	 * When exact closures are too large to collect, the tracker can keep a small
+	 * sketch of the dependants and prerequisites of each value (\see setEstimating),
+	 * from which \link Depends::estimateDependants estimateDependants \endlink and
+	 * \link Depends::estimatePrerequisites estimatePrerequisites \endlink estimate
+	 * how many there are in constant time. The sketches are kept up to date as
+	 * dependencies are added; removing one (or a value) has them rebuilt the next
+	 * time they are needed.
 	 * 
 	 * \internal To do all this, the dependency tracker has to do quite a bit of 
 	 * house-keeping: it keeps a set of whatever is stored in the tracker, of 
 	 * which it takes pointers that it puts in the DAG. Clause 8 of section 23.1.2
 	 * of the standard allows us to safely do this as it guarantees that "references"
 	 * (and therefore also pointers) into the container remain valid in the face of
-	 * insertions and erasures. */
-	template < typename ValueType >
+	 * insertions and erasures.
+	 *
+	 * \param ValueType the type of the values to track the dependencies of
+	 * \param Compare the predicate used to order (and find) the values in the tracker.
+	 *        If it is transparent (e.g. std::less<>), values can be found using any
+	 *        key it can compare to a value, without constructing a value from the key:
+	 *        this is what the \c find and \c depends functions do. */
+	template < typename ValueType, typename Compare = std::less< ValueType > >
 	class Depends
 	{
 		// here only so we can use it below
-		typedef std::set< ValueType > Storage;
+		typedef std::set< ValueType, Compare > Storage;
 	public :
 		/** A random-access iterator into our storage. */
 		typedef typename Storage::iterator iterator;
@@ -124,16 +158,78 @@ namespace Depends
 		typedef typename std::iterator_traits< iterator >::difference_type difference_type;
 		//! The size-type as exposed
 		typedef typename Storage::size_type size_type;
+		//! The predicate used to order the values
+		typedef Compare value_compare;
+		/** The transitive closure of the dependants or prerequisites of all values in the tracker.
+		 * The values in it are pointers to the values in the tracker. */
+		typedef typename DAG< pointer >::closure_type closure_type;
+		//! The observers that can be told about changes to the tracker (\see setObserver)
+		typedef Observer< value_type > observer_type;
+		//! The changes reported to the observer
+		typedef ChangeSet< value_type > change_set_type;
+		//! The memory used by the tracker (\see memoryUsage)
+		typedef Details::MemoryUsage memory_usage_type;
+
+	private :
+		//! \internal SFINAE helper to tell keys from iterators in overloads that take either
+		template < typename Key >
+		using EnableIfKey = typename std::enable_if< !std::is_convertible< Key, const_iterator >::value, bool >::type;
+		//! \internal The changes are recorded by pointer, until they are reported
+		typedef Details::Notifier< pointer, value_type, std::hash< pointer >, std::equal_to< pointer >, Details::Dereference > Notifier;
+
+	public :
+		//! The values in the tracker, partitioned into levels (\see levels)
+		typedef Details::Levels< const value_type* > levels_type;
 
 		//! Default-construct and empty tracker
 		Depends()
 			: selected_(0)
+			, tracer_(0)
 		{ /* no-op */ }
 		//! Construct a tracker from a range of things convertible to ValueType
 		template < typename InputIterator >
 		Depends(InputIterator begin, InputIterator end)
 			: selected_(0)
+			, tracer_(0)
 		{ insert(begin, end); }
+		/** Move-construct a tracker, taking over the contents and selection of another one.
+		 * The values are not moved or copied: the other tracker is left empty. */
+		Depends(Depends && d)
+			: storage_(std::move(d.storage_))
+			, dependants_(std::move(d.dependants_))
+			, prerequisites_(std::move(d.prerequisites_))
+			, selected_(d.selected_)
+			, tracer_(d.tracer_)
+			, sketches_(std::move(d.sketches_))
+		{
+			d.storage_.clear();
+			d.selected_ = 0;
+		}
+		~Depends()
+		{
+			clearSelection();
+		}
+
+		/** Move-assign a tracker, taking over the contents and selection of another one.
+		 * The values are not moved or copied: the other tracker is left empty. */
+		Depends & operator=(Depends && d)
+		{
+			if (this != &d)
+			{
+				clearSelection();
+				dependants_ = std::move(d.dependants_);
+				prerequisites_ = std::move(d.prerequisites_);
+				storage_ = std::move(d.storage_);
+				d.storage_.clear();
+				selected_ = d.selected_;
+				d.selected_ = 0;
+				tracer_ = d.tracer_;
+				sketches_ = std::move(d.sketches_);
+			}
+			else
+			{ /* self-assignment */ }
+			return *this;
+		}
 
 		//! Check whether the tracker is empty.
 		bool empty() const throw()
@@ -141,6 +237,36 @@ namespace Depends
 		size_type size() const throw()
 		{ return storage_.size(); }
 
+		/** Get the memory used by the tracker, broken down by what it is used for.
+		 * The values are those in the tracker's storage, each of which is counted with
+		 * the (estimated) overhead of the storage's node: the pointers to them in the
+		 * tracker's DAGs are counted with the DAGs' nodes. The sketches kept for estimates
+		 * (\see setEstimating) are counted as indexes. \see DAG::memoryUsage */
+		memory_usage_type memoryUsage() const
+		{
+			memory_usage_type usage(dependants_.memoryUsage());
+			usage += prerequisites_.memoryUsage();
+			usage.nodes_ += usage.values_;
+			usage.values_ = storage_.size() * (sizeof(value_type) + 4 * sizeof(void*));
+			if (sketches_)
+			{
+				const size_type sketch_size(size_type(1) << sketches_->precision_);
+				usage.indexes_ += sizeof(Sketches) + sketches_->sketches_.bucket_count() * sizeof(void*);
+				usage.indexes_ += sketches_->sketches_.size() * (sizeof(typename std::unordered_map< pointer, SketchPair >::value_type) + 2 * sizeof(void*) + 2 * sketch_size);
+			}
+			else
+			{ /* no sketches */ }
+
+			return usage;
+		}
+		/** Release the memory the tracker has allocated but doesn't use.
+		 * \see DAG::shrink_to_fit */
+		void shrink_to_fit()
+		{
+			dependants_.shrink_to_fit();
+			prerequisites_.shrink_to_fit();
+		}
+
 		//! Get a random-access iterator to the start of our storage
 		iterator begin()
 		{ return iterator(storage_.begin()); }
@@ -166,7 +292,202 @@ namespace Depends
 		const_reverse_iterator rend() const
 		{ return const_reverse_iterator(storage_.rend()); }
 
-		//! find a value equivalent to v
+		/** Attach a tracer to this tracker, or detach the current one by passing NULL.
+		 * The tracer is attached to the tracker's internal DAGs as well, so the spans
+		 * recorded for the DAG operations nest within those of the tracker's.
+		 * The tracer is not owned by the tracker and must outlive it (or be detached first). */
+		void setTracer(Tracer *tracer)
+		{
+			tracer_ = tracer;
+			dependants_.setTracer(tracer);
+			prerequisites_.setTracer(tracer);
+		}
+		//! Get the tracer attached to this tracker, if any
+		Tracer * getTracer() const { return tracer_; }
+
+		/** Attach an observer to this tracker, or detach the current one by passing NULL.
+		 * The observer is told about the values inserted and erased and the dependencies
+		 * added and removed, once for each operation (or Batch of operations). Each
+		 * dependency is reported as a link from the prerequisite to the dependant. As
+		 * the tracker keeps its values in the order of its predicate, the order never
+		 * changes. \see DAG::setObserver */
+		void setObserver(observer_type *observer) { notifier_.setObserver(observer); }
+		//! Get the observer attached to this tracker, if any
+		observer_type * getObserver() const { return notifier_.getObserver(); }
+
+		/** Groups the changes made to a tracker while it exists into a single notification of the tracker's observer.
+		 * Batches can be nested: the changes are reported when the outermost one ends. */
+		class Batch
+		{
+		public :
+			explicit Batch(Depends &depends)
+				: depends_(depends)
+			{
+				depends_.notifier_.begin();
+			}
+			~Batch()
+			{
+				depends_.notifier_.end();
+			}
+
+		private :
+			Batch(const Batch &);
+			Batch & operator=(const Batch &);
+
+			Depends &depends_;
+		};
+
+		/** Stages a group of changes to a tracker, to be made all at once, or not at all, by commit.
+		 * Nothing happens to the tracker until the transaction is committed. Then, the
+		 * values are inserted first (including those that are only mentioned in a
+		 * dependency), dependencies are removed, dependencies are added and values are
+		 * erased last, whatever the order in which they were staged. Both of the
+		 * tracker's DAGs are changed in a single transaction each (\see DAG::Transaction),
+		 * so they are only re-ordered once, and the observer is told about all of the
+		 * changes at once. If a new dependency would create a circular reference,
+		 * nothing is changed. */
+		class Transaction
+		{
+		public :
+			explicit Transaction(Depends &depends)
+				: depends_(depends)
+			{ /* no-op */ }
+
+			//! Stage the insertion of a value
+			void insert(const value_type & v) { inserts_.push_back(v); }
+			//! Stage a dependency of node on prerequisite, inserting either of them if need be
+			void addPrerequisite(const value_type & node, const value_type & prerequisite) { links_.emplace_back(prerequisite, node); }
+			//! Stage a dependency of dependant on node, inserting either of them if need be
+			void addDependant(const value_type & node, const value_type & dependant) { links_.emplace_back(node, dependant); }
+			//! Stage the removal of a direct dependency of node on prerequisite, which is skipped if there is no such dependency
+			void removePrerequisite(const value_type & node, const value_type & prerequisite) { unlinks_.emplace_back(prerequisite, node); }
+			//! Stage the removal of a direct dependency of dependant on node, which is skipped if there is no such dependency
+			void removeDependant(const value_type & node, const value_type & dependant) { unlinks_.emplace_back(node, dependant); }
+			//! Stage the erasure of a value, which is skipped if there is no such value
+			void erase(const value_type & v) { erases_.push_back(v); }
+
+			//! Check whether anything is staged
+			bool empty() const { return inserts_.empty() && links_.empty() && unlinks_.empty() && erases_.empty(); }
+			//! Drop the staged changes, without making them
+			void clear()
+			{
+				inserts_.clear();
+				links_.clear();
+				unlinks_.clear();
+				erases_.clear();
+			}
+
+			/** Make the staged changes, all at once or not at all. Either way, nothing is staged afterwards.
+			 * \throws CircularReference if one of the dependencies would create a circular reference
+			 * \throws std::invalid_argument if a dependency to remove is on a value that isn't in the tracker */
+			void commit()
+			{
+				try
+				{
+					depends_.commit(*this);
+				}
+				catch (...)
+				{
+					clear();
+					throw;
+				}
+				clear();
+			}
+
+		private :
+			Transaction(const Transaction &);
+			Transaction & operator=(const Transaction &);
+
+			Depends &depends_;
+			std::vector< value_type > inserts_;
+			//! the dependencies, as (prerequisite, dependant) pairs
+			std::vector< std::pair< value_type, value_type > > links_;
+			std::vector< std::pair< value_type, value_type > > unlinks_;
+			std::vector< value_type > erases_;
+
+			friend class Depends;
+		};
+
+		/** Set whether dependencies that are already implied by other dependencies should be refused.
+		 * When set, adding a prerequisite that the selected value already depends on,
+		 * directly or not, (or a dependant that already depends on the selected value)
+		 * leaves the tracker untouched. \see DAG::setRejectImpliedLinks */
+		void setRejectImpliedLinks(bool reject)
+		{
+			dependants_.setRejectImpliedLinks(reject);
+			prerequisites_.setRejectImpliedLinks(reject);
+		}
+		//! Check whether dependencies that are already implied by other dependencies are refused
+		bool getRejectImpliedLinks() const { return dependants_.getRejectImpliedLinks(); }
+
+		/** Set whether the tracker keeps the sketches needed to estimate the number of dependants and prerequisites of its values.
+		 * Each value gets two sketches of 2^precision bytes each, so the default of 8
+		 * costs half a kilobyte per value, for a standard error of about 6.5% (1.04
+		 * divided by the square root of 2^precision). The sketches are built the first
+		 * time they are needed. \see estimateDependants
+		 * \pre 4 <= precision <= 16 */
+		void setEstimating(bool estimate, unsigned int precision = Details::HyperLogLog::default_precision)
+		{
+			sketches_.reset(estimate ? new Sketches(precision) : 0);
+		}
+		//! Check whether the tracker keeps the sketches needed to estimate the number of dependants and prerequisites of its values
+		bool getEstimating() const { return sketches_ != 0; }
+
+		/** Get all values in the tracker, partitioned into levels.
+		 * Values without prerequisites are on level 0, and the prerequisites of the
+		 * values on any given level are all on earlier levels, so the values on a
+		 * level can all be processed at the same time once the earlier levels are
+		 * done. \see DAG::levels */
+		levels_type levels() const
+		{
+			Tracer::Span span(tracer_, "Depends", "levels");
+			typename DAG< pointer >::levels_type levels(dependants_.levels());
+			std::vector< const value_type* > values;
+			values.reserve(levels.values().size());
+			for (auto value : levels.values())
+			{
+				values.push_back(*value);
+			}
+
+			return levels_type(std::move(values), levels.ends());
+		}
+
+		/** Remove every direct dependency that is implied by other dependencies.
+		 * If 'a' depends on 'b' and on 'c', and 'b' depends on 'c', the direct dependency
+		 * of 'a' on 'c' is removed: 'a' still depends on 'c', but no longer \b directly.
+		 * \see DAG::reduce
+		 * \return the number of direct dependencies removed */
+		size_type reduce()
+		{
+			Tracer::Span span(tracer_, "Depends", "reduce");
+			Batch batch(*this);
+			size_type removed(prerequisites_.reduce());
+			// the dependants_ DAG links each prerequisite to its dependants, as the observer expects
+			struct Unlinked : DAG< pointer >::observer_type
+			{
+				Unlinked(Notifier &notifier) : notifier_(notifier) {}
+				virtual void changed(typename DAG< pointer >::change_set_type const &changes)
+				{
+					for (auto const &link : changes.unlinked_)
+					{
+						notifier_.unlinked(link.first, link.second);
+					}
+				}
+				Notifier &notifier_;
+			} unlinked(notifier_);
+			if (getObserver())
+				dependants_.setObserver(&unlinked);
+			else
+			{ /* no-one to tell */ }
+			size_type removed_dependants(dependants_.reduce());
+			dependants_.setObserver(0);
+			assert(removed == removed_dependants);
+
+			return removed;
+		}
+
+		/** find a value equivalent to v.
+		 * Unless the tracker's predicate is transparent, v is converted to the value type first. */
 		template < typename V >
 		const_iterator find(const V & v) const throw()
 		{ return storage_.find(v); }
@@ -184,16 +505,21 @@ namespace Depends
 		//! Insert an element into our storage and return an iterator and a bool indicating whether there was an insertion
 		std::pair< iterator, bool > insert( const value_type & v )
 		{
-			std::pair< iterator, bool > retval(storage_.insert(v));
-			if (retval.second)
-			{
-				prerequisites_.insert(getPointer(retval.first));
-				dependants_.insert(getPointer(retval.first));
-			}
-			else
-			{ /* nothing really inserted */ }
-
-			return retval;
+			Tracer::Span span(tracer_, "Depends", "insert");
+			return track(storage_.insert(v));
+		}
+		//! Move an element into our storage and return an iterator and a bool indicating whether there was an insertion
+		std::pair< iterator, bool > insert( value_type && v )
+		{
+			Tracer::Span span(tracer_, "Depends", "insert");
+			return track(storage_.insert(std::move(v)));
+		}
+		//! Construct an element in our storage and return an iterator and a bool indicating whether there was an insertion
+		template < typename... Args >
+		std::pair< iterator, bool > emplace( Args&&... args )
+		{
+			Tracer::Span span(tracer_, "Depends", "insert");
+			return track(storage_.emplace(std::forward< Args >(args)...));
 		}
 		//! Insert an element with a hint as to the location where that should be done. Note we don't use the hint.
 		iterator insert( const iterator & where, const value_type & what )
@@ -216,6 +542,8 @@ namespace Depends
 		// erase the value at the indicated position
 		void erase(iterator where)
 		{
+			Tracer::Span span(tracer_, "Depends", "erase", getPointer(where));
+			Batch batch(*this);
 			if (selected_)
 			{
 				if (where == *selected_)
@@ -226,8 +554,10 @@ namespace Depends
 			else
 			{ /* no selection - nothing to clear */ }
 			pointer p(getPointer(where));
+			invalidateSketches();
+			notifier_.erased(p, *p);
 			bool found_in_blockers(false);
-			typename DAG< pointer >::iterator whence(std::find(dependants_.begin(), dependants_.end(), p));
+			typename DAG< pointer >::iterator whence(dependants_.find(p));
 			if (whence != dependants_.end())
 			{
 				dependants_.erase(whence);
@@ -235,7 +565,7 @@ namespace Depends
 			}
 			else
 			{ /* value not in the blockers DAG */ }
-			whence = std::find(prerequisites_.begin(), prerequisites_.end(), p);
+			whence = prerequisites_.find(p);
 			if (whence != prerequisites_.end())
 			{
 				prerequisites_.erase(whence);
@@ -247,21 +577,156 @@ namespace Depends
 			}
 			storage_.erase(where);
 		}
-		// erase all the values in the given sequence
+		// erase all the values in the given sequence. The whole sequence is detached
+		// from both DAGs in a single sweep over each of them, so this takes time
+		// proportional to the size of the tracker, however many values are erased.
 		void erase(const iterator & begin, const iterator & end)
 		{
-			for (iterator where(begin); where != end; erase(where++))
-				;
+			if (begin == end)
+				return;
+			else
+			{ /* something to erase */ }
+			Tracer::Span span(tracer_, "Depends", "erase", getPointer(begin));
+			Batch batch(*this);
+			// as our storage is ordered, whether a value is in the sequence only takes two comparisons
+			value_compare compare(storage_.value_comp());
+			const bool to_end(end == storage_.end());
+			auto in_range = [&compare, to_end, begin, end](pointer p){ return !compare(*p, *begin) && (to_end || compare(*p, *end)); };
+			if (selected_ && in_range(getPointer(*selected_)))
+				clearSelection();
+			else
+			{ /* not erasing the selection */ }
+			invalidateSketches();
+			if (getObserver())
+			{
+				for (const_iterator which(begin); which != end; ++which)
+				{
+					notifier_.erased(getPointer(which), *which);
+				}
+			}
+			else
+			{ /* no-one to tell */ }
+			size_type erased(dependants_.eraseIf(in_range));
+			size_type erased_prerequisites(prerequisites_.eraseIf(in_range));
+			assert(erased == erased_prerequisites);
+			storage_.erase(begin, end);
 		}
 		// clear the container
 		void clear()
 		{
+			Batch batch(*this);
 			clearSelection();
+			invalidateSketches();
+			if (getObserver())
+			{
+				for (const_iterator which(begin()); which != end(); ++which)
+				{
+					notifier_.erased(getPointer(which), *which);
+				}
+			}
+			else
+			{ /* no-one to tell */ }
 			dependants_.clear();
 			prerequisites_.clear();
 			storage_.clear();
 		}
 
+		/** Replace the contents of the tracker with the given values and links, built in bulk.
+		 * Rather than adding the prerequisites one at a time, each of the tracker's DAGs
+		 * is built in a single pass (\see DAG::assign), so this takes time proportional
+		 * to the number of values and links. Duplicate values and links are skipped. The
+		 * selection is cleared. If anything is thrown, the tracker is left untouched.
+		 * The observer is only told about the values and links that weren't there before,
+		 * or aren't there anymore.
+		 * \param first_value the first of the values to put in the tracker
+		 * \param last_value one-past-the-end of the values
+		 * \param first_link the first of the links, each of which is a pair with a prerequisite and its dependant as its first and second member
+		 * \param last_link one-past-the-end of the links
+		 * \throws CircularReference if the links contain a circular reference
+		 * \throws std::invalid_argument if one of the links is to or from a value that isn't among the values */
+		template < typename ValueIterator, typename LinkIterator >
+		void assign(ValueIterator first_value, ValueIterator last_value, LinkIterator first_link, LinkIterator last_link)
+		{
+			Tracer::Span span(tracer_, "Depends", "assign");
+			Batch batch(*this);
+			Storage storage(first_value, last_value, storage_.key_comp());
+			std::vector< pointer > values;
+			values.reserve(storage.size());
+			for (auto const &value : storage)
+			{
+				values.push_back(&value);
+			}
+			std::vector< std::pair< pointer, pointer > > dependant_links;
+			std::vector< std::pair< pointer, pointer > > prerequisite_links;
+			for (; first_link != last_link; ++first_link)
+			{
+				auto prerequisite(storage.find(first_link->first));
+				auto dependant(storage.find(first_link->second));
+				if (prerequisite == storage.end() || dependant == storage.end())
+					throw std::invalid_argument("value not found");
+				else
+				{ /* both are there */ }
+				dependant_links.emplace_back(&*prerequisite, &*dependant);
+				prerequisite_links.emplace_back(&*dependant, &*prerequisite);
+			}
+			DAG< pointer > dependants;
+			dependants.assign(values.begin(), values.end(), dependant_links.begin(), dependant_links.end());
+			DAG< pointer > prerequisites;
+			prerequisites.assign(values.begin(), values.end(), prerequisite_links.begin(), prerequisite_links.end());
+
+			if (getObserver())
+			{
+				// only what actually changes is reported: the old and new contents are compared
+				// by value, as the values that stay are at a new address
+				for (const_iterator which(begin()); which != end(); ++which)
+				{
+					auto kept(storage.find(*which));
+					if (kept == storage.end())
+					{
+						notifier_.erased(getPointer(which), *which);
+						continue;
+					}
+					else
+					{ /* the links from it that aren't made again are removed */ }
+					for (auto dependant : dependants_.find(getPointer(which)).node()->targets_)
+					{
+						auto still(storage.find(*(dependant->value_)));
+						if (still != storage.end() && !dependants.find(&*kept).node()->targets_.contains(dependants.find(&*still).node()))
+							notifier_.unlinked(&*kept, &*still);
+						else
+						{ /* still linked, or its dependant goes */ }
+					}
+				}
+				for (auto value : values)
+				{
+					if (storage_.find(*value) == storage_.end())
+						notifier_.inserted(value);
+					else
+					{ /* was already there */ }
+				}
+				for (auto prerequisite(dependants.begin()); prerequisite != dependants.end(); ++prerequisite)
+				{
+					auto was_prerequisite(storage_.find(**prerequisite));
+					for (auto dependant : prerequisite.node()->targets_)
+					{
+						auto was_dependant(storage_.find(*(dependant->value_)));
+						if (was_prerequisite == storage_.end() || was_dependant == storage_.end() || !directlyLinked(&*was_prerequisite, &*was_dependant))
+							notifier_.linked(*prerequisite, dependant->value_);
+						else
+						{ /* already linked */ }
+					}
+				}
+			}
+			else
+			{ /* no-one to tell */ }
+			clearSelection();
+			invalidateSketches();
+			dependants_.swap(dependants);
+			prerequisites_.swap(prerequisites);
+			// the values are not copied: the pointers to them remain valid
+			storage_.swap(storage);
+		}
+
 		/** Select something in the tracker to track the dependencies for.
 		 * This method performs the selection by iterator. */
 		void select(const_iterator what)
@@ -280,31 +745,78 @@ namespace Depends
 		{
 			select(insert(v).first);
 		}
+		/** Select something in the tracker to track the dependencies for.
+		 * This method tries to find the given value in the tracker and will
+		 * move it into the tracker if it doesn't exist yet. */
+		void select(value_type && v)
+		{
+			select(insert(std::move(v)).first);
+		}
 
 		/** Link the pointed-to value to the currently selected value as a prerequisite. */
 		void addPrerequisite(const_iterator whence)
 		{
 			assert(selected_);
-			prerequisites_.link(getPointer(*selected_), getPointer(whence));
-			dependants_.link(getPointer(whence), getPointer(*selected_));
+			addPrerequisite(*selected_, whence);
 		}
 		/** Link the value to the currently selected value as a prerequisite - the value is added to the tracker if need be. */
 		void addPrerequisite(const value_type & v)
 		{
+			Batch batch(*this);
 			addPrerequisite(insert(v).first);
 		}
+		/** Link the value to the currently selected value as a prerequisite - the value is moved into the tracker if need be. */
+		void addPrerequisite(value_type && v)
+		{
+			Batch batch(*this);
+			addPrerequisite(insert(std::move(v)).first);
+		}
+		/** Link the value pointed to by whence to the value pointed to by node as a prerequisite.
+		 * This, and all the other functions that take the node to work on as their first
+		 * argument, neither need nor change the current selection. */
+		void addPrerequisite(const_iterator node, const_iterator whence)
+		{
+			Tracer::Span span(tracer_, "Depends", "addPrerequisite", getPointer(node), getPointer(whence));
+			Batch batch(*this);
+			if (prerequisites_.link(getPointer(node), getPointer(whence)))
+				notifier_.linked(getPointer(whence), getPointer(node));
+			else
+			{ /* already there, or implied */ }
+			dependants_.link(getPointer(whence), getPointer(node));
+			updateSketches(getPointer(whence), getPointer(node));
+		}
+		/** Link all values in the given range to the value pointed to by node as prerequisites.
+		 * Values that aren't in the tracker yet are added to it. All of the links are
+		 * made at once, so the tracker's DAGs are only re-ordered once; if any of them
+		 * would create a circular reference, none of them are made.
+		 * \throws CircularReference if one of the links would create a circular reference */
+		template < typename InputIterator >
+		void addPrerequisites(const_iterator node, InputIterator first, InputIterator last)
+		{
+			Tracer::Span span(tracer_, "Depends", "addPrerequisites", getPointer(node));
+			Batch batch(*this);
+			std::vector< pointer > prerequisites(insertAll(first, last));
+			std::vector< bool > existed(existingLinks(prerequisites, getPointer(node)));
+			prerequisites_.linkTargets(prerequisites_.find(getPointer(node)), prerequisites.begin(), prerequisites.end());
+			dependants_.linkSources(prerequisites.begin(), prerequisites.end(), dependants_.find(getPointer(node)));
+			for (size_type which(0); which < existed.size(); ++which)
+			{
+				if (!existed[which] && directlyLinked(prerequisites[which], getPointer(node)))
+					notifier_.linked(prerequisites[which], getPointer(node));
+				else
+				{ /* not linked by this call */ }
+			}
+			for (auto prerequisite : prerequisites)
+			{
+				updateSketches(prerequisite, getPointer(node));
+			}
+		}
 		/** Remove the link between the pointed-to value and the currently selected one.
 		 * \warning Such a link can only be broken if it is a direct one! */
 		void removePrerequisite(const_iterator whence)
 		{
 			assert(selected_);
-			if (whence == end())
-				return;
-			else
-			{ /* dependency could exist */ }
-			bool was_prereq(prerequisites_.unlink(getPointer(*selected_), getPointer(whence)));
-			bool was_dep(dependants_.unlink(getPointer(whence), getPointer(*selected_)));
-			assert((was_dep && was_prereq) || (!was_dep && !was_prereq));
+			removePrerequisite(*selected_, whence);
 		}
 		/** Remove the link between the give value and the currently selected one.
 		 * \warning Such a link can only be broken if it is a direct one! */
@@ -312,72 +824,107 @@ namespace Depends
 		{
 			removePrerequisite(find(value));
 		}
+		/** Remove the link between the value pointed to by whence and the one pointed to by node.
+		 * \warning Such a link can only be broken if it is a direct one! */
+		void removePrerequisite(const_iterator node, const_iterator whence)
+		{
+			if (whence == end())
+				return;
+			else
+			{ /* dependency could exist */ }
+			Tracer::Span span(tracer_, "Depends", "removePrerequisite", getPointer(node), getPointer(whence));
+			Batch batch(*this);
+			bool was_prereq(prerequisites_.unlink(getPointer(node), getPointer(whence)));
+			bool was_dep(dependants_.unlink(getPointer(whence), getPointer(node)));
+			assert((was_dep && was_prereq) || (!was_dep && !was_prereq));
+			if (was_dep)
+			{
+				invalidateSketches();
+				notifier_.unlinked(getPointer(whence), getPointer(node));
+			}
+			else
+			{ /* nothing changed */ }
+		}
 		/** Get the prerequisites of the currently selected value.
 		 * \param all set to true if you want \b all prerequisites, including those that 
 		 *        are not direct prerequisites. If false (the default) only direct 
 		 *        prerequisites will be returned.  */
 		std::set< value_type > getPrerequisites(bool all = false) const
 		{
-			typedef typename DAG< pointer >::node_type node_type;
-
-			std::set< value_type > retval;
-			typename DAG< pointer >::const_iterator selected(std::find(prerequisites_.begin(), prerequisites_.end(), getPointer(*selected_)));
-			node_type const *selected_node(selected.node());
-			if (all)
-			{
-				auto retrieveTargets = [](node_type *node, std::set< pointer > *data){
-					data->insert(node->value_);
-				};
-
-				std::set< pointer > temp;
-				for (auto target : selected_node->targets_)
-				{
-					target->visit(retrieveTargets, &temp);
-				}
-
-				std::copy(
-					  boost::indirect_iterator< typename std::set< pointer >::const_iterator >(temp.begin())
-					, boost::indirect_iterator< typename std::set< pointer >::const_iterator >(temp.end())
-					, std::inserter(retval, retval.begin())
-					);
-			}
-			else
-			{
-				typename DAG< pointer >::node_type::targets_type::const_iterator end(selected_node->targets_.end());
-				typename DAG< pointer >::node_type::targets_type::const_iterator where(selected_node->targets_.begin());
-				while (where != end)
-				{
-					retval.insert(*((*where)->value_));
-					++where;
-				}
-			}
-
-			return retval;
+			assert(selected_);
+			return getPrerequisites(*selected_, all);
+		}
+		/** Get the prerequisites of the value pointed to by node.
+		 * This doesn't change anything in the tracker, so any number of threads can call
+		 * it (and getDependants) at the same time, as long as none of them changes the tracker.
+		 * \param all set to true if you want \b all prerequisites, including those that 
+		 *        are not direct prerequisites. If false (the default) only direct 
+		 *        prerequisites will be returned.  */
+		std::set< value_type > getPrerequisites(const_iterator node, bool all = false) const
+		{
+			Tracer::Span span(tracer_, "Depends", "getPrerequisites", getPointer(node));
+			return collect(prerequisites_, node, all);
 		}
 
 		/** Link the pointed-to value to the currently selected value as a dependant. */
 		void addDependant(const_iterator whence)
 		{
 			assert(selected_);
-			dependants_.link(getPointer(*selected_), getPointer(whence));
-			prerequisites_.link(getPointer(whence), getPointer(*selected_));
+			addDependant(*selected_, whence);
 		}
 		/** Link the value to the currently selected value as a dependant - the value is added to the tracker if need be. */
 		void addDependant(const value_type & v)
 		{
+			Batch batch(*this);
 			addDependant(insert(v).first);
 		}
+		/** Link the value to the currently selected value as a dependant - the value is moved into the tracker if need be. */
+		void addDependant(value_type && v)
+		{
+			Batch batch(*this);
+			addDependant(insert(std::move(v)).first);
+		}
+		/** Link the value pointed to by whence to the value pointed to by node as a dependant. */
+		void addDependant(const_iterator node, const_iterator whence)
+		{
+			Tracer::Span span(tracer_, "Depends", "addDependant", getPointer(node), getPointer(whence));
+			Batch batch(*this);
+			if (dependants_.link(getPointer(node), getPointer(whence)))
+				notifier_.linked(getPointer(node), getPointer(whence));
+			else
+			{ /* already there, or implied */ }
+			prerequisites_.link(getPointer(whence), getPointer(node));
+			updateSketches(getPointer(node), getPointer(whence));
+		}
+		/** Link all values in the given range to the value pointed to by node as dependants.
+		 * \see addPrerequisites for how this works */
+		template < typename InputIterator >
+		void addDependants(const_iterator node, InputIterator first, InputIterator last)
+		{
+			Tracer::Span span(tracer_, "Depends", "addDependants", getPointer(node));
+			Batch batch(*this);
+			std::vector< pointer > dependants(insertAll(first, last));
+			std::vector< bool > existed(existingLinks(getPointer(node), dependants));
+			dependants_.linkTargets(dependants_.find(getPointer(node)), dependants.begin(), dependants.end());
+			prerequisites_.linkSources(dependants.begin(), dependants.end(), prerequisites_.find(getPointer(node)));
+			for (size_type which(0); which < existed.size(); ++which)
+			{
+				if (!existed[which] && directlyLinked(getPointer(node), dependants[which]))
+					notifier_.linked(getPointer(node), dependants[which]);
+				else
+				{ /* not linked by this call */ }
+			}
+			for (auto dependant : dependants)
+			{
+				updateSketches(getPointer(node), dependant);
+			}
+		}
 		/** Remove the link between the pointed-to value and the currently selected one.
 		 * \warning Such a link can only be broken if it is a direct one! */
 		void removeDependant(const_iterator whence)
 		{
 			assert(selected_);
-			if (whence == end())
-				return;
-			else
-			{ /* dependency could exist */ }
-			dependants_.unlink(getPointer(*selected_), getPointer(whence));
-			prerequisites_.unlink(getPointer(whence), getPointer(*selected_));
+			removeDependant(*selected_, whence);
 		}
 		/** Remove the link between the pointed-to value and the currently selected one.
 		 * \warning Such a link can only be broken if it is a direct one! */
@@ -385,47 +932,40 @@ namespace Depends
 		{
 			removeDependant(find(value));
 		}
+		/** Remove the link between the value pointed to by whence and the one pointed to by node.
+		 * \warning Such a link can only be broken if it is a direct one! */
+		void removeDependant(const_iterator node, const_iterator whence)
+		{
+			if (whence == end())
+				return;
+			else
+			{ /* dependency could exist */ }
+			Tracer::Span span(tracer_, "Depends", "removeDependant", getPointer(node), getPointer(whence));
+			Batch batch(*this);
+			if (dependants_.unlink(getPointer(node), getPointer(whence)))
+			{
+				invalidateSketches();
+				notifier_.unlinked(getPointer(node), getPointer(whence));
+			}
+			else
+			{ /* nothing changed */ }
+			prerequisites_.unlink(getPointer(whence), getPointer(node));
+		}
 		/** Get the dependants of the currently selected value.
 		* \param all set to true if you want \b all dependants, including those that 
 		*        are not direct dependants. If false (the default) only direct 
 		*        dependants will be returned.  */
 		std::set< value_type > getDependants(bool all = false) const
 		{
-			typedef typename DAG< pointer >::node_type node_type;
-
-			std::set< value_type > retval;
-			typename DAG< pointer >::const_iterator selected(std::find(dependants_.begin(), dependants_.end(), getPointer(*selected_)));
-			node_type const *selected_node(selected.node());
-			if (all)
-			{
-				auto retrieveTargets = [](node_type *node, std::set< pointer > *data){
-					data->insert(node->value_);
-				};
-
-				std::set< pointer > temp;
-				for (auto target : selected_node->targets_)
-				{
-					target->visit(retrieveTargets, &temp);
-				}
-
-				std::copy(
-					  boost::indirect_iterator< typename std::set< pointer >::const_iterator >(temp.begin())
-					, boost::indirect_iterator< typename std::set< pointer >::const_iterator >(temp.end())
-					, std::inserter(retval, retval.begin())
-					);
-			}
-			else
-			{
-				typename DAG< pointer >::node_type::targets_type::const_iterator end(selected_node->targets_.end());
-				typename DAG< pointer >::node_type::targets_type::const_iterator where(selected_node->targets_.begin());
-				while (where != end)
-				{
-					retval.insert(*((*where)->value_));
-					++where;
-				}
-			}
-
-			return retval;
+			assert(selected_);
+			return getDependants(*selected_, all);
+		}
+		/** Get the dependants of the value pointed to by node.
+		 * \see getPrerequisites(const_iterator, bool) */
+		std::set< value_type > getDependants(const_iterator node, bool all = false) const
+		{
+			Tracer::Span span(tracer_, "Depends", "getDependants", getPointer(node));
+			return collect(dependants_, node, all);
 		}
 
 
@@ -436,32 +976,95 @@ namespace Depends
 				return false;
 			else
 			{ /* such a dependency could exist */ }
+			Tracer::Span span(tracer_, "Depends", "depends", getPointer(source), getPointer(target));
 
 			// target depends on source if target is a dependant of source
 			// in which case source should also be a prerequisite of target
+			std::size_t visits(0);
+			bool const retval(reaches(dependants_, getPointer(source), getPointer(target), visits));
 #ifndef NDEBUG
-			assert(
-				(dependants_.linked(getPointer(source), getPointer(target)) && prerequisites_.linked(getPointer(target), getPointer(source))) ||
-				((!dependants_.linked(getPointer(source), getPointer(target))) && (!prerequisites_.linked(getPointer(target), getPointer(source)))));
+			// the check isn't part of the work release builds do, so it isn't traced
+			std::size_t unrecorded(0);
+			assert(retval == reaches(prerequisites_, getPointer(target), getPointer(source), unrecorded));
 #endif
-			return dependants_.linked(getPointer(source), getPointer(target));
+			span.visits(visits);
+
+			return retval;
 		}
-		//! check whether target depends on source
-		bool depends(const_iterator target, const value_type & source) const
+		//! check whether target depends on source (\see find for the keys that can be used)
+		template < typename SourceKey >
+		EnableIfKey< SourceKey > depends(const_iterator target, const SourceKey & source) const
 		{
 			return depends(target, find(source));
 		}
-		//! check whether target depends on source
-		bool depends(const value_type & target, const_iterator source) const
+		//! check whether target depends on source (\see find for the keys that can be used)
+		template < typename TargetKey >
+		EnableIfKey< TargetKey > depends(const TargetKey & target, const_iterator source) const
 		{
 			return depends(find(target), source);
 		}
-		//! check whether target depends on source
-		bool depends(const value_type & target, const value_type & source) const
+		//! check whether target depends on source (\see find for the keys that can be used)
+		template < typename TargetKey, typename SourceKey >
+		typename std::enable_if< !std::is_convertible< TargetKey, const_iterator >::value && !std::is_convertible< SourceKey, const_iterator >::value, bool >::type depends(const TargetKey & target, const SourceKey & source) const
 		{
 			return depends(find(target), find(source));
 		}
 
+		/** Get all dependants of all values in the tracker at once.
+		 * This is much faster than calling getDependants(node, true) for each of them.
+		 * \see DAG::closure for how it works and what the parameters mean */
+		closure_type getAllDependants(typename closure_type::Mode mode = closure_type::FULL, unsigned int threads = 0) const
+		{
+			Tracer::Span span(tracer_, "Depends", "getAllDependants");
+			return dependants_.closure(mode, threads);
+		}
+		/** Get all prerequisites of all values in the tracker at once.
+		 * \see getAllDependants */
+		closure_type getAllPrerequisites(typename closure_type::Mode mode = closure_type::FULL, unsigned int threads = 0) const
+		{
+			Tracer::Span span(tracer_, "Depends", "getAllPrerequisites");
+			return prerequisites_.closure(mode, threads);
+		}
+
+		/** Estimate the number of values that depend on the value pointed to by node, directly or not.
+		 * This takes the same, small, amount of time however many dependants there are,
+		 * but the tracker must keep the sketches to estimate from (\see setEstimating).
+		 * If dependencies were removed since the last estimate, the sketches of all
+		 * values are rebuilt first, which takes time proportional to the size of the
+		 * tracker and the number of dependencies in it.
+		 * \throws std::logic_error if the tracker doesn't keep sketches */
+		double estimateDependants(const_iterator node) const
+		{
+			Tracer::Span span(tracer_, "Depends", "estimateDependants", getPointer(node));
+			return sketchesOf(node).first.estimate();
+		}
+		/** Estimate the number of values the value pointed to by node depends on, directly or not.
+		 * \see estimateDependants */
+		double estimatePrerequisites(const_iterator node) const
+		{
+			Tracer::Span span(tracer_, "Depends", "estimatePrerequisites", getPointer(node));
+			return sketchesOf(node).second.estimate();
+		}
+
+		/** For each of a range of (target, source) pairs, check whether target depends on source.
+		 * This answers the queries in bulk, which is much faster than asking each of
+		 * them separately when there are many (\see DAG::linkedAll). Each pair's
+		 * target and source can be iterators into the tracker or keys to find (\see find).
+		 * \param first the first of the pairs, with the target as its first member and the source as its second
+		 * \param last one-past-the-end of the pairs
+		 * \return a vector with the answer for each pair, in order */
+		template < typename InputIterator >
+		std::vector< bool > dependsAll(InputIterator first, InputIterator last) const
+		{
+			Tracer::Span span(tracer_, "Depends", "dependsAll");
+			std::vector< std::pair< pointer, pointer > > queries;
+			for (; first != last; ++first)
+			{
+				queries.push_back(std::make_pair(pointerTo(first->second), pointerTo(first->first)));
+			}
+			return dependants_.linkedAll(queries.begin(), queries.end());
+		}
+
 	private :
 		// Neither CopyConstructible nor Assignable
 		Depends(const Depends &);
@@ -475,6 +1078,395 @@ namespace Depends
 			selected_ = 0;
 		}
 
+		/** \internal The sketches of the dependants (first) and prerequisites (second) of a value */
+		typedef std::pair< Details::HyperLogLog, Details::HyperLogLog > SketchPair;
+		/** \internal The sketches of all values in the tracker, when it keeps them.
+		 * The sketches of a value don't count the value itself. */
+		struct Sketches
+		{
+			explicit Sketches(unsigned int precision)
+				: precision_(precision)
+				, dirty_(true)
+			{ /* no-op */ }
+
+			unsigned int precision_;
+			//! whether the sketches need to be rebuilt before they can be used
+			bool dirty_;
+			std::unordered_map< pointer, SketchPair > sketches_;
+		};
+
+		//! \internal Have the sketches, if any, rebuilt the next time they are needed
+		void invalidateSketches()
+		{
+			if (sketches_)
+				sketches_->dirty_ = true;
+			else
+			{ /* no sketches to invalidate */ }
+		}
+
+		/** \internal Get the (up-to-date) sketches of a value, rebuilding them all if need be.
+		 * The sketches are rebuilt in the order of the levels: the prerequisites of a value
+		 * are the union of its direct prerequisites and of their prerequisites, which are
+		 * all on earlier levels, and its dependants are the same thing the other way around. */
+		SketchPair const & sketchesOf(const_iterator node) const
+		{
+			if (!sketches_)
+				throw std::logic_error("Estimates need the tracker to keep sketches");
+			else
+			{ /* we have sketches */ }
+			if (sketches_->dirty_)
+			{
+				sketches_->sketches_.clear();
+				typename DAG< pointer >::levels_type levels(dependants_.levels());
+				std::vector< pointer > order;
+				order.reserve(levels.values().size());
+				for (auto value : levels.values())
+				{
+					order.push_back(*value);
+				}
+				for (auto value : order)
+				{
+					sketches_->sketches_.emplace(value, SketchPair(Details::HyperLogLog(sketches_->precision_), Details::HyperLogLog(sketches_->precision_)));
+				}
+				for (auto value : order)
+				{
+					merge(prerequisites_, value, &SketchPair::second);
+				}
+				for (auto value = order.rbegin(); value != order.rend(); ++value)
+				{
+					merge(dependants_, *value, &SketchPair::first);
+				}
+				sketches_->dirty_ = false;
+			}
+			else
+			{ /* sketches are up-to-date */ }
+
+			return sketches_->sketches_.find(getPointer(node))->second;
+		}
+
+		//! \internal Merge the sketches (and values) of the direct targets of value in the given DAG into value's sketch
+		void merge(DAG< pointer > const &dag, pointer value, Details::HyperLogLog SketchPair::*which) const
+		{
+			Details::HyperLogLog &sketch(sketches_->sketches_.find(value)->second.*which);
+			for (auto target : dag.find(value).node()->targets_)
+			{
+				sketch.insert(Details::HyperLogLog::hash(target->value_));
+				sketch.merge(sketches_->sketches_.find(target->value_)->second.*which);
+			}
+		}
+
+		/** \internal Bring the sketches up to date with a new dependency of dependant on prerequisite.
+		 * The dependant and its dependants are now dependants of prerequisite and of all of
+		 * its prerequisites, so the dependant's sketch, with the dependant itself, is merged
+		 * into all of theirs (and the other way around for the sketches of the prerequisites).
+		 * When the merge doesn't change a sketch, it won't change those of the values further
+		 * along either, as their sketches already contain it, so the propagation stops there. */
+		void updateSketches(pointer prerequisite, pointer dependant)
+		{
+			if (sketches_ && !sketches_->dirty_)
+			{
+				propagate(prerequisites_, prerequisite, dependant, &SketchPair::first);
+				propagate(dependants_, dependant, prerequisite, &SketchPair::second);
+			}
+			else
+			{ /* sketches will be rebuilt when they are needed */ }
+		}
+
+		//! \internal Propagate the sketch (and value) of from to the sketches of to and all of its targets in dag
+		void propagate(DAG< pointer > const &dag, pointer to, pointer from, Details::HyperLogLog SketchPair::*which)
+		{
+			typedef typename DAG< pointer >::node_type node_type;
+			Details::HyperLogLog delta(sketches_->sketches_.find(from)->second.*which);
+			delta.insert(Details::HyperLogLog::hash(from));
+
+			std::vector< node_type const* > stack(1, dag.find(to).node());
+			while (!stack.empty())
+			{
+				node_type const *node(stack.back());
+				stack.pop_back();
+				if ((sketches_->sketches_.find(node->value_)->second.*which).merge(delta))
+					stack.insert(stack.end(), node->targets_.begin(), node->targets_.end());
+				else
+				{ /* already contains all of it, as do those further along */ }
+			}
+		}
+
+		/** \internal Start tracking the dependencies of a value that was just inserted
+		 * in our storage, if it was really inserted.
+		 * \param inserted the result of the insertion into our storage */
+		std::pair< iterator, bool > track(std::pair< iterator, bool > inserted)
+		{
+			if (inserted.second)
+			{
+				Batch batch(*this);
+				notifier_.inserted(getPointer(inserted.first));
+				prerequisites_.insert(getPointer(inserted.first));
+				dependants_.insert(getPointer(inserted.first));
+				if (sketches_ && !sketches_->dirty_)
+					sketches_->sketches_.emplace(getPointer(inserted.first), SketchPair(Details::HyperLogLog(sketches_->precision_), Details::HyperLogLog(sketches_->precision_)));
+				else
+				{ /* sketches will be rebuilt when they are needed */ }
+			}
+			else
+			{ /* nothing really inserted */ }
+
+			return inserted;
+		}
+
+		/** \internal Make the changes staged in a transaction, all or nothing (\see Transaction).
+		 * The values are inserted in our storage first, and erased from it again if
+		 * either of our DAGs refuses its transaction. Both DAGs' transactions are
+		 * prepared before either is finished, so if the second one can't be prepared,
+		 * the first is rolled back and the DAGs stay each other's mirror image. */
+		void commit(Transaction const &transaction)
+		{
+			Tracer::Span span(tracer_, "Depends", "commit");
+			Batch batch(*this);
+			std::vector< iterator > inserted;
+			typename DAG< pointer >::Transaction dependants(dependants_);
+			typename DAG< pointer >::Transaction prerequisites(prerequisites_);
+			std::vector< std::pair< pointer, pointer > > links;
+			std::vector< std::pair< pointer, pointer > > unlinks;
+			std::vector< bool > existed;
+			std::vector< pointer > erased;
+			try
+			{
+				auto intern = [&](const value_type & v) -> pointer {
+						std::pair< iterator, bool > result(storage_.insert(v));
+						if (result.second)
+						{
+							inserted.push_back(result.first);
+							dependants.insert(getPointer(result.first));
+							prerequisites.insert(getPointer(result.first));
+						}
+						else
+						{ /* already there */ }
+						return getPointer(result.first);
+					};
+				for (auto const &v : transaction.inserts_)
+				{
+					intern(v);
+				}
+				for (auto const &link : transaction.links_)
+				{
+					links.emplace_back(intern(link.first), intern(link.second));
+				}
+				for (auto const &unlink : transaction.unlinks_)
+				{
+					const_iterator prerequisite(storage_.find(unlink.first));
+					const_iterator dependant(storage_.find(unlink.second));
+					if (prerequisite == end() || dependant == end())
+						throw std::invalid_argument("value not found");
+					else
+					{ /* both are there */ }
+					unlinks.emplace_back(getPointer(prerequisite), getPointer(dependant));
+				}
+				for (auto const &v : transaction.erases_)
+				{
+					const_iterator where(storage_.find(v));
+					if (where != end())
+						erased.push_back(getPointer(where));
+					else
+					{ /* nothing to erase */ }
+				}
+				std::sort(erased.begin(), erased.end());
+				erased.erase(std::unique(erased.begin(), erased.end()), erased.end());
+				// if we're observed, find out which of the links exist before we change them
+				for (size_type which(0); getObserver() && which < links.size() + unlinks.size(); ++which)
+				{
+					std::pair< pointer, pointer > const &link(which < links.size() ? links[which] : unlinks[which - links.size()]);
+					existed.push_back(dependants_.find(link.first) != dependants_.end() && dependants_.find(link.second) != dependants_.end() && directlyLinked(link.first, link.second));
+				}
+				for (auto const &link : links)
+				{
+					dependants.link(link.first, link.second);
+					prerequisites.link(link.second, link.first);
+				}
+				for (auto const &unlink : unlinks)
+				{
+					dependants.unlink(unlink.first, unlink.second);
+					prerequisites.unlink(unlink.second, unlink.first);
+				}
+				for (auto p : erased)
+				{
+					dependants.erase(p);
+					prerequisites.erase(p);
+				}
+				dependants.prepare();
+				try
+				{
+					prerequisites.prepare();
+				}
+				catch (...)
+				{
+					dependants.rollback();
+					throw;
+				}
+			}
+			catch (...)
+			{
+				for (auto where : inserted)
+				{
+					storage_.erase(where);
+				}
+				throw;
+			}
+			dependants.finish();
+			prerequisites.finish();
+
+			if (!transaction.links_.empty() || !transaction.unlinks_.empty() || !erased.empty() || !inserted.empty())
+				invalidateSketches();
+			else
+			{ /* the sketches are still up-to-date */ }
+			for (auto where : inserted)
+			{
+				notifier_.inserted(getPointer(where));
+			}
+			for (size_type which(0); which < existed.size(); ++which)
+			{
+				std::pair< pointer, pointer > const &link(which < links.size() ? links[which] : unlinks[which - links.size()]);
+				bool const remains(dependants_.find(link.first) != dependants_.end() && dependants_.find(link.second) != dependants_.end() && directlyLinked(link.first, link.second));
+				if (which < links.size() && !existed[which] && remains)
+					notifier_.linked(link.first, link.second);
+				else if (which >= links.size() && existed[which] && !remains)
+					notifier_.unlinked(link.first, link.second);
+				else
+				{ /* no change to report */ }
+			}
+			for (auto p : erased)
+			{
+				if (selected_ && getPointer(*selected_) == p)
+					clearSelection();
+				else
+				{ /* not erasing the selection */ }
+				notifier_.erased(p, *p);
+				storage_.erase(storage_.find(*p));
+			}
+		}
+
+		//! \internal Check whether dependant depends directly on prerequisite
+		bool directlyLinked(pointer prerequisite, pointer dependant) const
+		{
+			return dependants_.find(prerequisite).node()->targets_.contains(dependants_.find(dependant).node());
+		}
+		//! \internal Check, if we're observed, which of the prerequisites the dependant already depends on directly
+		std::vector< bool > existingLinks(std::vector< pointer > const &prerequisites, pointer dependant) const
+		{
+			std::vector< bool > retval;
+			for (size_type which(0); getObserver() && which < prerequisites.size(); ++which)
+			{
+				retval.push_back(directlyLinked(prerequisites[which], dependant));
+			}
+			return retval;
+		}
+		//! \internal Check, if we're observed, which of the dependants already depend directly on the prerequisite
+		std::vector< bool > existingLinks(pointer prerequisite, std::vector< pointer > const &dependants) const
+		{
+			std::vector< bool > retval;
+			for (size_type which(0); getObserver() && which < dependants.size(); ++which)
+			{
+				retval.push_back(directlyLinked(prerequisite, dependants[which]));
+			}
+			return retval;
+		}
+
+		/** \internal Insert the values in the given range, if need be, and get pointers to them. */
+		template < typename InputIterator >
+		std::vector< pointer > insertAll(InputIterator first, InputIterator last)
+		{
+			std::vector< pointer > retval;
+			for (; first != last; ++first)
+			{
+				retval.push_back(getPointer(insert(*first).first));
+			}
+
+			return retval;
+		}
+
+		/** \internal Get the values the given node links to, directly or not, in one of our DAGs.
+		 * Unlike the DAG's own traversals, this doesn't flag the nodes it visits, so any
+		 * number of threads can do it at the same time, and it reaches each node only once. */
+		static std::set< value_type > collect(DAG< pointer > const &dag, const_iterator node, bool all)
+		{
+			typedef typename DAG< pointer >::node_type node_type;
+			node_type const *source(dag.find(getPointer(node)).node());
+
+			std::set< value_type > retval;
+			if (all)
+			{
+				std::set< pointer > reached;
+				std::vector< node_type const* > stack(source->targets_.begin(), source->targets_.end());
+				while (!stack.empty())
+				{
+					node_type const *target(stack.back());
+					stack.pop_back();
+					if (reached.insert(target->value_).second)
+						stack.insert(stack.end(), target->targets_.begin(), target->targets_.end());
+					else
+					{ /* already reached through another path */ }
+				}
+
+				std::copy(
+					  boost::indirect_iterator< typename std::set< pointer >::const_iterator >(reached.begin())
+					, boost::indirect_iterator< typename std::set< pointer >::const_iterator >(reached.end())
+					, std::inserter(retval, retval.begin())
+					);
+			}
+			else
+			{
+				for (auto target : source->targets_)
+				{
+					retval.insert(*(target->value_));
+				}
+			}
+
+			return retval;
+		}
+
+		/** \internal Check whether there is a path from source to target in one of our DAGs.
+		 * As with DAG::linked, a value reaches itself. Like collect, this doesn't flag
+		 * the nodes it visits. */
+		static bool reaches(DAG< pointer > const &dag, pointer source, pointer target, std::size_t &visits)
+		{
+			typedef typename DAG< pointer >::node_type node_type;
+			if (source == target)
+				return true;
+			else
+			{ /* look for a path */ }
+			node_type const *from(dag.find(source).node());
+
+			std::unordered_set< node_type const* > reached;
+			std::vector< node_type const* > stack(from->targets_.begin(), from->targets_.end());
+			while (!stack.empty())
+			{
+				node_type const *node(stack.back());
+				stack.pop_back();
+				if (node->value_ == target)
+					return true;
+				else if (reached.insert(node).second)
+				{
+					++visits;
+					stack.insert(stack.end(), node->targets_.begin(), node->targets_.end());
+				}
+				else
+				{ /* already reached through another path */ }
+			}
+
+			return false;
+		}
+
+		//! \internal Get a pointer to the value an iterator points to, or NULL for end()
+		pointer pointerTo(const_iterator where) const
+		{
+			return where == end() ? 0 : getPointer(where);
+		}
+		//! \internal Get a pointer to the value equivalent to a key, or NULL if there is none
+		template < typename Key >
+		typename std::enable_if< !std::is_convertible< Key, const_iterator >::value, pointer >::type pointerTo(const Key & key) const
+		{
+			return pointerTo(find(key));
+		}
+
 		static pointer getPointer(const_iterator i)
 		{
 			return const_cast< pointer >(&(*i));
@@ -488,6 +1480,8 @@ namespace Depends
 			   & boost::serialization::make_nvp("dependants_", dependants_)
 			   & boost::serialization::make_nvp("prerequisites_", prerequisites_)
 			   ;
+			// the sketches are not serialized
+			invalidateSketches();
 		}
 #endif
 
@@ -499,6 +1493,12 @@ namespace Depends
 		 * the tracker if there is. The selection is cleared when the selected 
 		 * object is removed from the container. */
 		const_iterator * selected_;
+		//! \internal The tracer attached to this tracker, if any
+		Tracer *tracer_;
+		//! \internal The sketches used for estimates, if the tracker keeps them
+		std::unique_ptr< Sketches > sketches_;
+		//! \internal Collects the changes to report to the observer, if any
+		Notifier notifier_;
 
 #if DEPENDS_SUPPORT_SERIALIZATION
 		friend class boost::serialization::access;
@@ -0,0 +1,292 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/adjacency.hpp Definition of the set of targets the DAG's nodes link to.
+ * You will normally never want to include this file directly, as it is included by node.hpp */
+#ifndef depends_details_adjacency_hpp
+#define depends_details_adjacency_hpp
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include "smallvector.hpp"
+#if DEPENDS_SUPPORT_SERIALIZATION
+#include <vector>
+#include <boost/serialization/split_member.hpp>
+#endif
+
+namespace Depends
+{
+	namespace Details
+	{
+		/** The targets a node links to: a set that adapts its representation to its size.
+		 * The targets are kept in a SmallVector, the first N of them inline. Linear
+		 * scans of a few targets are as fast as anything else, but some nodes (e.g.
+		 * a library everything depends on) have many thousands of them, so once a
+		 * node has more than Threshold targets, a hash index from each target to its
+		 * position is built as well. With or without the index, checking whether a
+		 * target is in the set, adding one (duplicates are refused) and removing one
+		 * take constant time: removing moves the last target into the removed one's
+		 * place, so the targets are in no particular order.
+		 *
+		 * The targets can only be changed through the set's own functions, which
+		 * keep the index up-to-date; iteration is read-only.
+		 *
+		 * \param T the type of the targets, which must be trivially copyable and hashable
+		 * \param N the number of targets kept inline
+		 * \param Threshold the number of targets beyond which the set is indexed */
+		template < typename T, std::size_t N, std::size_t Threshold = 32 >
+		class Adjacency
+		{
+			typedef SmallVector< T, N > Values;
+			typedef std::unordered_map< T, std::size_t > Index;
+		public :
+			typedef T value_type;
+			typedef typename Values::const_iterator const_iterator;
+			typedef const_iterator iterator;
+			typedef typename Values::size_type size_type;
+			typedef typename Values::difference_type difference_type;
+
+			//! The number of targets beyond which the set is indexed
+			static const size_type threshold = Threshold;
+
+			Adjacency()
+			{ /* no-op */ }
+			Adjacency(Adjacency const &other)
+				: values_(other.values_)
+				, index_(other.index_ ? new Index(*other.index_) : 0)
+			{ /* no-op */ }
+			Adjacency(Adjacency &&other) = default;
+			Adjacency & operator=(Adjacency const &other)
+			{
+				Adjacency temp(other);
+				swap(temp);
+				return *this;
+			}
+			Adjacency & operator=(Adjacency &&other) = default;
+
+			const_iterator begin() const { return values_.begin(); }
+			const_iterator end() const { return values_.end(); }
+			size_type size() const { return values_.size(); }
+			bool empty() const { return values_.empty(); }
+			T const & operator[](size_type i) const { return values_[i]; }
+			//! check whether the targets are indexed
+			bool isIndexed() const { return bool(index_); }
+
+			//! the number of bytes allocated for the targets that don't fit inline, including the unused ones
+			size_type allocated() const { return values_.allocated(); }
+			//! the number of bytes allocated for targets but not used
+			size_type unused() const { return values_.isInline() ? 0 : (values_.capacity() - values_.size()) * sizeof(T); }
+			//! an estimate of the number of bytes used by the index, if any
+			size_type indexAllocated() const
+			{
+				return index_ ? sizeof(Index) + index_->bucket_count() * sizeof(void*) + index_->size() * (sizeof(typename Index::value_type) + 2 * sizeof(void*)) : 0;
+			}
+			//! release unused memory, by moving the targets inline if they fit and shrinking the index's table of buckets
+			void shrink_to_fit()
+			{
+				values_.shrink_to_fit();
+				if (index_)
+					index_->rehash(0);
+				else
+				{ /* no index */ }
+			}
+
+			//! check whether the given target is in the set
+			bool contains(T const &value) const
+			{
+				return find(value) != size();
+			}
+
+			//! add a target to the set, unless it already is in it, in which case this returns false
+			bool insert(T const &value)
+			{
+				if (contains(value))
+					return false;
+				else
+				{ /* add it */ }
+				values_.push_back(value);
+				if (index_)
+					index_->emplace(value, values_.size() - 1);
+				else if (values_.size() > Threshold)
+					reindex();
+				else
+				{ /* small enough to scan */ }
+
+				return true;
+			}
+
+			//! remove a target from the set, returning false if it wasn't in it
+			bool erase(T const &value)
+			{
+				size_type position(find(value));
+				if (position == size())
+					return false;
+				else
+				{ /* remove it */ }
+				const size_type last(values_.size() - 1);
+				if (position != last)
+				{
+					values_[position] = values_[last];
+					if (index_)
+						(*index_)[values_[position]] = position;
+					else
+					{ /* not indexed */ }
+				}
+				else
+				{ /* already at the end */ }
+				values_.pop_back();
+				if (index_)
+					index_->erase(value);
+				else
+				{ /* not indexed */ }
+
+				return true;
+			}
+
+			/** remove all targets for which the given predicate returns true, keeping the others in order.
+			 * \return the number of targets removed */
+			template < typename Predicate >
+			size_type eraseIf(Predicate pred)
+			{
+				typename Values::iterator kept(values_.begin());
+				for (typename Values::iterator which(values_.begin()); which != values_.end(); ++which)
+				{
+					if (!pred(*which))
+						*kept++ = *which;
+					else
+					{ /* removed */ }
+				}
+				const size_type removed(values_.end() - kept);
+				if (removed)
+				{
+					values_.erase(kept, values_.end());
+					reindex();
+				}
+				else
+				{ /* nothing changed */ }
+
+				return removed;
+			}
+
+			/** replace the targets with those in the given range.
+			 * \pre the range doesn't contain any duplicates */
+			template < typename InputIterator >
+			void assign(InputIterator first, InputIterator last)
+			{
+				values_.assign(first, last);
+				reindex();
+			}
+
+			void clear()
+			{
+				values_.clear();
+				index_.reset();
+			}
+
+			void swap(Adjacency &other)
+			{
+				values_.swap(other.values_);
+				index_.swap(other.index_);
+			}
+
+		private :
+			//! \internal get the position of the given target, or size() if it isn't in the set
+			size_type find(T const &value) const
+			{
+				if (index_)
+				{
+					typename Index::const_iterator where(index_->find(value));
+					return where == index_->end() ? size() : where->second;
+				}
+				else
+				{
+					size_type position(0);
+					while (position < values_.size() && !(values_[position] == value))
+					{
+						++position;
+					}
+					return position;
+				}
+			}
+
+			//! \internal build the index if the set is large enough to need one, or drop it if it isn't
+			void reindex()
+			{
+				if (values_.size() <= Threshold)
+				{
+					index_.reset();
+					return;
+				}
+				else
+				{ /* needs an index */ }
+				if (!index_)
+					index_.reset(new Index);
+				else
+					index_->clear();
+				index_->reserve(values_.size());
+				for (size_type position(0); position < values_.size(); ++position)
+				{
+					index_->emplace(values_[position], position);
+				}
+			}
+
+#if DEPENDS_SUPPORT_SERIALIZATION
+			// serialized as a std::vector, so archives don't depend on the representation
+			template < typename Archive >
+			void save(Archive &ar, unsigned int const version) const
+			{
+				std::vector< T > values(begin(), end());
+				ar & boost::serialization::make_nvp("values", values);
+			}
+			template < typename Archive >
+			void load(Archive &ar, unsigned int const version)
+			{
+				std::vector< T > values;
+				ar & boost::serialization::make_nvp("values", values);
+				assign(values.begin(), values.end());
+			}
+			BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+			friend class boost::serialization::access;
+#endif
+
+			Values values_;
+			//! \internal the position of each target, only if there are more than Threshold of them
+			std::unique_ptr< Index > index_;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,383 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/closure.hpp Definition of the transitive closure of a DAG.
+ * You will normally never want to include this file directly, as it is included by dag.hpp */
+#ifndef depends_details_closure_hpp
+#define depends_details_closure_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Depends
+{
+	namespace Details
+	{
+		/** The transitive closure of a DAG: for each of its nodes, the set of nodes it reaches.
+		 * The nodes are numbered in the DAG's order at the time the closure was
+		 * computed, and each node's set is a row of bits, one for each node. A
+		 * closure computed with COUNT_ONLY only has the size of each node's set,
+		 * which takes much less memory, as each row can be dropped as soon as the
+		 * nodes linking to it are done with it.
+		 *
+		 * Note that, with all rows, the closure of a DAG of n nodes takes n * n bits.
+		 *
+		 * The nodes can be looked up by value, using the same hash function and
+		 * equality predicate as the DAG. */
+		template < typename ValueType, typename Hash = std::hash< ValueType >, typename KeyEqual = std::equal_to< ValueType > >
+		class Closure
+		{
+			//! \internal Hash and compare pointers to values by the values they point to
+			struct Indirect
+			{
+				std::size_t operator()(const ValueType *value) const { return Hash()(*value); }
+				bool operator()(const ValueType *lhs, const ValueType *rhs) const { return KeyEqual()(*lhs, *rhs); }
+			};
+			typedef std::unordered_map< const ValueType*, std::size_t, Indirect, Indirect > Indices;
+
+		public :
+			typedef std::size_t size_type;
+			typedef unsigned long long word_type;
+			typedef const ValueType & const_reference;
+			typedef const ValueType * const_pointer;
+
+			//! What to keep of the closure
+			enum Mode { FULL, COUNT_ONLY };
+
+			//! The number of bits in each word of a row
+			static const size_type bits_per_word = sizeof(word_type) * 8;
+
+			Closure()
+				: words_(0)
+			{ /* no-op */ }
+			/** Construct from the values of the nodes, the sizes of their closures and (optionally) the rows themselves.
+			 * \pre rows is either empty or has one row of words words per value */
+			Closure(std::vector< const_pointer > values, std::vector< size_type > counts, std::vector< word_type > rows, size_type words)
+				: values_(std::move(values))
+				, counts_(std::move(counts))
+				, rows_(std::move(rows))
+				, words_(words)
+			{
+				assert(rows_.empty() || rows_.size() == values_.size() * words_);
+				indices_.reserve(values_.size());
+				for (size_type index(0); index < values_.size(); ++index)
+				{
+					indices_[values_[index]] = index;
+				}
+			}
+
+			//! get the number of nodes in the closure
+			size_type size() const { return values_.size(); }
+			//! check whether the closure is empty
+			bool empty() const { return values_.empty(); }
+			//! check whether the closure has the sets of nodes each node reaches, or only their sizes
+			bool hasRows() const { return !rows_.empty() || values_.empty(); }
+
+			//! get the value of the node at the given index
+			const_reference value(size_type index) const { return *values_[index]; }
+			//! get the index of the node with the given value, or size() if it isn't in the closure
+			size_type index(const_reference value) const
+			{
+				typename Indices::const_iterator where(indices_.find(&value));
+				return where == indices_.end() ? size() : where->second;
+			}
+
+			//! get the number of nodes reached from the node at the given index
+			size_type count(size_type index) const { return counts_[index]; }
+
+			/** check whether the node at index source reaches the one at index target
+			 * \pre hasRows() */
+			bool reaches(size_type source, size_type target) const
+			{
+				assert(hasRows());
+				return (rows_[source * words_ + target / bits_per_word] >> (target % bits_per_word)) & 1;
+			}
+
+			/** write a pointer to the value of each node reached from the node at the given index to out
+			 * \pre hasRows() */
+			template < typename OutputIterator >
+			OutputIterator reached(size_type source, OutputIterator out) const
+			{
+				assert(hasRows());
+				const word_type *row(&rows_[source * words_]);
+				for (size_type word(0); word < words_; ++word)
+				{
+					for (word_type bits(row[word]); bits; bits &= bits - 1)
+					{
+						size_type bit(0);
+						while (!((bits >> bit) & 1))
+						{
+							++bit;
+						}
+						*out++ = values_[word * bits_per_word + bit];
+					}
+				}
+
+				return out;
+			}
+
+		private :
+			std::vector< const_pointer > values_;
+			std::vector< size_type > counts_;
+			std::vector< word_type > rows_;
+			size_type words_;
+			Indices indices_;
+		};
+
+		//! A barrier for a fixed number of threads, which can be re-used as soon as all of them passed it
+		class Barrier
+		{
+		public :
+			explicit Barrier(std::size_t threads)
+				: threads_(threads)
+				, waiting_(0)
+				, generation_(0)
+			{ /* no-op */ }
+
+			void wait()
+			{
+				std::unique_lock< std::mutex > lock(mutex_);
+				const std::size_t generation(generation_);
+				if (++waiting_ == threads_)
+				{
+					waiting_ = 0;
+					++generation_;
+					condition_.notify_all();
+				}
+				else
+				{
+					condition_.wait(lock, [this, generation]{ return generation != generation_; });
+				}
+			}
+
+		private :
+			std::mutex mutex_;
+			std::condition_variable condition_;
+			const std::size_t threads_;
+			std::size_t waiting_;
+			std::size_t generation_;
+		};
+
+		/** Compute the transitive closure of the given nodes.
+		 * The nodes are processed level by level, starting with the last level: all
+		 * the nodes a node links to are on later levels, so by the time a node is
+		 * processed, the rows of all of its targets are complete and its own row is
+		 * the bitwise OR of theirs, plus a bit for each target. The nodes on the same
+		 * level don't depend on each other, so they are shared between the threads,
+		 * which wait for each other at the end of each level.
+		 * \pre each node's position_ is its index in nodes and its level_ is up-to-date
+		 * \param threads the number of threads to use, or 0 to use one per core */
+		template < typename Result, typename NodeType >
+		Result computeClosure(std::vector< NodeType* > const &nodes, typename Result::Mode mode, unsigned int threads)
+		{
+			typedef typename Result::word_type Word;
+			typedef typename Result::size_type size_type;
+			const size_type count(nodes.size());
+			const size_type words((count + Result::bits_per_word - 1) / Result::bits_per_word);
+
+			// the nodes, sorted by level, and the index at which each level ends
+			size_type depth(0);
+			for (auto node : nodes)
+			{
+				depth = std::max< size_type >(depth, node->level_ + 1);
+			}
+			std::vector< size_type > ends(depth + 1, 0);
+			for (auto node : nodes)
+			{
+				++ends[node->level_ + 1];
+			}
+			std::partial_sum(ends.begin(), ends.end(), ends.begin());
+			std::vector< size_type > next(ends.begin(), ends.end() - 1);
+			std::vector< NodeType* > by_level(count);
+			for (auto node : nodes)
+			{
+				by_level[next[node->level_]++] = node;
+			}
+
+			std::vector< Word > rows(mode == Result::FULL ? count * words : 0, 0);
+			// with COUNT_ONLY, each row only lives until the last node linking to it is done with it
+			std::vector< std::unique_ptr< Word[] > > partial(mode == Result::FULL ? 0 : count);
+			std::unique_ptr< std::atomic< size_type >[] > pending(mode == Result::FULL ? 0 : new std::atomic< size_type >[count]);
+			if (mode != Result::FULL)
+			{
+				for (size_type index(0); index < count; ++index)
+				{
+					pending[index] = 0;
+				}
+				for (auto node : nodes)
+				{
+					for (auto target : node->targets_)
+					{
+						++pending[target->position_];
+					}
+				}
+			}
+			else
+			{ /* all rows are kept */ }
+			std::vector< size_type > counts(count, 0);
+
+			auto process = [&](NodeType *node) {
+					const size_type position(node->position_);
+					Word *row;
+					if (mode == Result::FULL)
+					{
+						row = &rows[position * words];
+					}
+					else
+					{
+						partial[position].reset(new Word[words]());
+						row = partial[position].get();
+					}
+					for (auto target : node->targets_)
+					{
+						const size_type target_position(target->position_);
+						row[target_position / Result::bits_per_word] |= Word(1) << (target_position % Result::bits_per_word);
+						const Word *target_row(mode == Result::FULL ? &rows[target_position * words] : partial[target_position].get());
+						for (size_type word(0); word < words; ++word)
+						{
+							row[word] |= target_row[word];
+						}
+					}
+					size_type bits(0);
+					for (size_type word(0); word < words; ++word)
+					{
+						bits += std::bitset< Result::bits_per_word >(row[word]).count();
+					}
+					counts[position] = bits;
+					if (mode != Result::FULL)
+					{
+						for (auto target : node->targets_)
+						{
+							if (--pending[target->position_] == 0)
+								partial[target->position_].reset();
+							else
+							{ /* some other node still needs it */ }
+						}
+						if (pending[position] == 0)
+							partial[position].reset();
+						else
+						{ /* the nodes linking to this one still need it */ }
+					}
+					else
+					{ /* all rows are kept */ }
+				};
+
+			if (threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+			else
+			{ /* as requested */ }
+			threads = static_cast< unsigned int >(std::max< size_type >(1, std::min< size_type >(threads, count)));
+			std::unique_ptr< std::atomic< size_type >[] > claimed(new std::atomic< size_type >[depth + 1]);
+			for (size_type level(0); level <= depth; ++level)
+			{
+				claimed[level] = ends[level];
+			}
+			// the threads only start working once they're all there, so they know how many to wait for
+			std::promise< void > start;
+			std::shared_future< void > started(start.get_future());
+			std::unique_ptr< Barrier > barrier;
+			std::mutex error_lock;
+			std::exception_ptr error;
+			std::atomic< bool > failed(false);
+			auto work = [&]() {
+					started.wait();
+					for (size_type level(depth); level-- > 0; )
+					{
+						for (size_type which(claimed[level]++); which < ends[level + 1] && !failed; which = claimed[level]++)
+						{
+							try
+							{
+								process(by_level[which]);
+							}
+							catch (...)
+							{
+								std::lock_guard< std::mutex > lock(error_lock);
+								if (!error)
+									error = std::current_exception();
+								else
+								{ /* only the first one is kept */ }
+								failed = true;
+							}
+						}
+						barrier->wait();
+					}
+				};
+			std::vector< std::thread > workers;
+			workers.reserve(threads - 1);
+			try
+			{
+				for (unsigned int thread(1); thread < threads; ++thread)
+				{
+					workers.push_back(std::thread(work));
+				}
+			}
+			catch (const std::system_error &)
+			{ /* make do with the threads we have */ }
+			barrier.reset(new Barrier(workers.size() + 1));
+			start.set_value();
+			work();
+			for (auto &worker : workers)
+			{
+				worker.join();
+			}
+			if (error)
+				std::rethrow_exception(error);
+			else
+			{ /* all went well */ }
+
+			std::vector< typename Result::const_pointer > values(count);
+			for (auto node : nodes)
+			{
+				values[node->position_] = &node->value_;
+			}
+			return Result(std::move(values), std::move(counts), std::move(rows), words);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,175 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/hyperloglog.hpp Definition of the sketches used to estimate the sizes of closures.
+ * You will normally never want to include this file directly, as it is included by depends.hpp */
+#ifndef depends_details_hyperloglog_hpp
+#define depends_details_hyperloglog_hpp
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Depends
+{
+	namespace Details
+	{
+		/** A HyperLogLog sketch: an estimate of the number of distinct elements in a set.
+		 * Each element is hashed to 64 bits, the first few of which select one of the
+		 * sketch's registers, which keeps the longest run of leading zeroes seen in the
+		 * rest. Two sketches are merged by taking the maximum of each register, which
+		 * gives the sketch of the union of their sets: that is what makes them useful
+		 * to estimate the sizes of closures, which are unions of the closures of their
+		 * targets. With 2^p registers, the standard error of the estimate is about
+		 * 1.04 / sqrt(2^p), so 6.5% with the default of 256 registers.
+		 *
+		 * Elements can't be removed from a sketch. */
+		class HyperLogLog
+		{
+		public :
+			typedef std::size_t size_type;
+
+			//! The default precision: the base-2 logarithm of the number of registers
+			static const unsigned int default_precision = 8;
+
+			/** Construct an empty sketch with 2^precision registers.
+			 * \pre 4 <= precision <= 16 */
+			explicit HyperLogLog(unsigned int precision = default_precision)
+				: precision_(precision)
+				, registers_(size_type(1) << precision, 0)
+			{
+				assert(precision >= 4 && precision <= 16);
+			}
+
+			//! get the precision of the sketch
+			unsigned int precision() const { return precision_; }
+
+			/** add an element, given its hash, to the set.
+			 * \return true if the sketch changed */
+			bool insert(unsigned long long hash)
+			{
+				const size_type which(hash >> (64 - precision_));
+				const unsigned long long rest(hash << precision_);
+				unsigned char rank(1);
+				for (unsigned long long bit(1ULL << 63); rank <= 64 - precision_ && !(rest & bit); bit >>= 1)
+				{
+					++rank;
+				}
+				if (rank > registers_[which])
+				{
+					registers_[which] = rank;
+					return true;
+				}
+				else
+				{
+					return false;
+				}
+			}
+
+			/** merge another sketch into this one, which then estimates the union of both sets.
+			 * \pre both sketches have the same precision
+			 * \return true if the sketch changed */
+			bool merge(const HyperLogLog &other)
+			{
+				assert(precision_ == other.precision_);
+				bool changed(false);
+				for (size_type which(0); which < registers_.size(); ++which)
+				{
+					if (other.registers_[which] > registers_[which])
+					{
+						registers_[which] = other.registers_[which];
+						changed = true;
+					}
+					else
+					{ /* already at least as high */ }
+				}
+
+				return changed;
+			}
+
+			//! estimate the number of distinct elements in the set
+			double estimate() const
+			{
+				const double m(registers_.size());
+				double sum(0);
+				size_type zeroes(0);
+				for (auto value : registers_)
+				{
+					sum += std::ldexp(1.0, -int(value));
+					zeroes += value == 0;
+				}
+				const double alpha(m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / (1 + 1.079 / m));
+				const double raw(alpha * m * m / sum);
+				// for small sets, counting the empty registers is more accurate
+				if (raw <= 2.5 * m && zeroes)
+				{
+					return m * std::log(m / zeroes);
+				}
+				else
+				{
+					return raw;
+				}
+			}
+
+			//! empty the set
+			void clear()
+			{
+				std::fill(registers_.begin(), registers_.end(), 0);
+			}
+
+			/** Hash a pointer for insertion in a sketch.
+			 * The bits of the address are mixed (using MurmurHash3's finalizer) so
+			 * that all of the hash's bits depend on all of the address' bits. */
+			static unsigned long long hash(const void *pointer)
+			{
+				unsigned long long hash(reinterpret_cast< std::uintptr_t >(pointer));
+				hash ^= hash >> 33;
+				hash *= 0xff51afd7ed558ccdULL;
+				hash ^= hash >> 33;
+				hash *= 0xc4ceb9fe1a85ec53ULL;
+				hash ^= hash >> 33;
+
+				return hash;
+			}
+
+		private :
+			unsigned int precision_;
+			std::vector< unsigned char > registers_;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,274 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/index.hpp Definition of the hash index the DAG uses to find its nodes.
+ * You will normally never want to include this file directly, as it is included by dag.hpp */
+#ifndef depends_details_index_hpp
+#define depends_details_index_hpp
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace Depends
+{
+	namespace Details
+	{
+		//! Map any type to void, to detect whether a type is valid
+		template < typename T >
+		struct Void
+		{
+			typedef void type;
+		};
+
+		//! Check whether a hash function or equality predicate accepts keys of other types than its value type
+		template < typename T, typename = void >
+		struct IsTransparent : std::false_type
+		{ /* no-op */ };
+		template < typename T >
+		struct IsTransparent< T, typename Void< typename T::is_transparent >::type > : std::true_type
+		{ /* no-op */ };
+
+		/** An open-addressing hash table of node pointers, keyed by the nodes' values.
+		 * This is a linear-probing table that stores each node's hash next to it, and
+		 * that is never more than half full. Erasing shifts the nodes after the erased
+		 * one back into place, so no tombstones are ever left behind.
+		 *
+		 * Looking up a key of another type than the nodes' value type is done without
+		 * converting the key if both the hash function and the equality predicate are
+		 * transparent (i.e. have an is_transparent member type), just like the standard
+		 * unordered containers do. The equality predicate is called with the key first
+		 * and the node's value second. */
+		template < typename NodeType, typename Hash, typename KeyEqual >
+		class Index
+		{
+		public :
+			typedef typename NodeType::value_type value_type;
+			typedef std::size_t size_type;
+
+			Index()
+				: size_(0)
+			{ /* no-op */ }
+
+			//! get the number of nodes in the index
+			size_type size() const { return size_; }
+			//! get the number of slots in the index
+			size_type capacity() const { return slots_.size(); }
+
+			/** Find the node with a value equal to the given key.
+			 * \return the node, or NULL if there is none */
+			template < typename Key >
+			NodeType * find(const Key &key) const
+			{
+				return find(key, std::integral_constant< bool, IsTransparent< Hash >::value && IsTransparent< KeyEqual >::value >());
+			}
+
+			/** Add a node to the index.
+			 * \pre there is no node with an equal value in the index yet */
+			void insert(NodeType *node)
+			{
+				if ((size_ + 1) * 2 > slots_.size())
+					rehash(slots_.empty() ? 16 : slots_.size() * 2);
+				else
+				{ /* enough room */ }
+				place(Slot(hash(node->value_), node));
+				++size_;
+			}
+
+			//! Remove a node from the index, if it is there
+			void erase(const NodeType *node)
+			{
+				if (slots_.empty())
+					return;
+				else
+				{ /* look for the node */ }
+				size_type mask(slots_.size() - 1);
+				size_type where(hash(node->value_) & mask);
+				while (slots_[where].node_ != node)
+				{
+					if (!slots_[where].node_)
+						return;
+					else
+					{ /* keep probing */ }
+					where = (where + 1) & mask;
+				}
+				// shift whatever follows back into place
+				size_type next((where + 1) & mask);
+				while (slots_[next].node_)
+				{
+					size_type ideal(slots_[next].hash_ & mask);
+					// move the node at next into the hole unless its ideal slot is cyclically within (where, next]
+					if (((next - ideal) & mask) >= ((next - where) & mask))
+					{
+						slots_[where] = slots_[next];
+						where = next;
+					}
+					else
+					{ /* already as close to its ideal slot as it can be */ }
+					next = (next + 1) & mask;
+				}
+				slots_[where] = Slot();
+				--size_;
+			}
+
+			//! Remove all nodes from the index
+			void clear()
+			{
+				slots_.clear();
+				size_ = 0;
+			}
+
+			//! Make room for at least the given number of nodes
+			void reserve(size_type count)
+			{
+				size_type capacity(minimumCapacity(count));
+				if (capacity > slots_.size())
+					rehash(capacity);
+				else
+				{ /* already big enough */ }
+			}
+
+			//! Get the number of bytes allocated for the index's slots
+			size_type allocated() const { return slots_.capacity() * sizeof(Slot); }
+			//! Get the number of bytes allocated for slots that shrink_to_fit would release
+			size_type unused() const { return allocated() - (size_ ? minimumCapacity(size_) * sizeof(Slot) : 0); }
+			//! Make the index as small as it can be for the nodes in it
+			void shrink_to_fit()
+			{
+				if (!size_)
+					std::vector< Slot >().swap(slots_);
+				else if (minimumCapacity(size_) < slots_.size())
+					rehash(minimumCapacity(size_));
+				else
+				{ /* already as small as it gets */ }
+			}
+
+		private :
+			struct Slot
+			{
+				Slot()
+					: hash_(0)
+					, node_(0)
+				{ /* no-op */ }
+				Slot(size_type hash, NodeType *node)
+					: hash_(hash)
+					, node_(node)
+				{ /* no-op */ }
+
+				size_type hash_;
+				NodeType *node_;
+			};
+
+			template < typename Key >
+			NodeType * find(const Key &key, std::true_type) const
+			{
+				if (slots_.empty())
+					return 0;
+				else
+				{ /* look for the key */ }
+				size_type hash(Index::hash(key));
+				size_type mask(slots_.size() - 1);
+				for (size_type where(hash & mask); slots_[where].node_; where = (where + 1) & mask)
+				{
+					if (slots_[where].hash_ == hash && KeyEqual()(key, slots_[where].node_->value_))
+						return slots_[where].node_;
+					else
+					{ /* keep probing */ }
+				}
+
+				return 0;
+			}
+
+			NodeType * find(const value_type &key, std::false_type) const
+			{
+				return find(key, std::true_type());
+			}
+
+			/** \internal Hash a key, mixing the bits of the hash so the low bits, which select
+			 * the slot, depend on all of them: std::hash is the identity for integers and
+			 * pointers, whose low bits are often all the same. */
+			template < typename Key >
+			static size_type hash(const Key &key)
+			{
+				unsigned long long hash(Hash()(key));
+				hash ^= hash >> 33;
+				hash *= 0xff51afd7ed558ccdULL;
+				hash ^= hash >> 33;
+
+				return static_cast< size_type >(hash);
+			}
+
+			//! \internal the smallest number of slots the index can have with the given number of nodes in it
+			static size_type minimumCapacity(size_type count)
+			{
+				size_type capacity(16);
+				while (capacity < count * 2)
+				{
+					capacity *= 2;
+				}
+				return capacity;
+			}
+
+			void place(const Slot &slot)
+			{
+				size_type mask(slots_.size() - 1);
+				size_type where(slot.hash_ & mask);
+				while (slots_[where].node_)
+				{
+					where = (where + 1) & mask;
+				}
+				slots_[where] = slot;
+			}
+
+			void rehash(size_type capacity)
+			{
+				assert((capacity & (capacity - 1)) == 0);
+				std::vector< Slot > slots(capacity);
+				slots_.swap(slots);
+				for (auto const &slot : slots)
+				{
+					if (slot.node_)
+						place(slot);
+					else
+					{ /* empty slot */ }
+				}
+			}
+
+			std::vector< Slot > slots_;
+			size_type size_;
+		};
+	}
+}
+
+#endif
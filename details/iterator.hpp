@@ -37,6 +37,7 @@
 #define depends_details_iterator_hpp
 
 #include <iterator>
+#include <type_traits>
 #include "node.hpp"
 
 namespace Depends
@@ -49,7 +50,7 @@ namespace Depends
 		{
 			typedef Iterator< ValueType, ValueType&, ValueType*, ScoreType, IteratorType > iterator;
 			typedef Iterator< ValueType, ValueType const&, ValueType const*, ScoreType, IteratorType > const_iterator;
-			typedef Node< ValueType, ScoreType > node_type;
+			typedef typename std::remove_pointer< typename std::iterator_traits< IteratorType >::value_type >::type node_type;
 			
 			Iterator(IteratorType const&i) : iter_(i) {}
 			Iterator(IteratorType &&i) : iter_(std::move(i)) {}
@@ -0,0 +1,100 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/levels.hpp Definition of the level-partitioned view of a DAG.
+ * You will normally never want to include this file directly, as it is included by dag.hpp */
+#ifndef depends_details_levels_hpp
+#define depends_details_levels_hpp
+
+#include <cassert>
+#include <utility>
+#include <vector>
+
+namespace Depends
+{
+	namespace Details
+	{
+		/** The nodes of a DAG, partitioned into levels.
+		 * A node's level is the length of the longest path that leads to it, so
+		 * nodes nothing links to are on level 0, and every node is linked to only
+		 * from nodes on earlier levels. All nodes on the same level can therefore
+		 * be processed at the same time, once all earlier levels are done.
+		 *
+		 * The values of all levels are stored contiguously, one level after the
+		 * other, so each level is a range within a single vector. */
+		template < typename ValueType >
+		class Levels
+		{
+		public :
+			typedef ValueType value_type;
+			typedef typename std::vector< ValueType >::const_iterator const_iterator;
+			typedef typename std::vector< ValueType >::size_type size_type;
+
+			Levels()
+				: bounds_(1, 0)
+			{ /* no-op */ }
+			/** Construct from the values of all levels, in order, and the index at which each level ends.
+			 * \pre bounds is sorted and its last element is the number of values */
+			Levels(std::vector< ValueType > values, std::vector< size_type > ends)
+				: values_(std::move(values))
+				, bounds_(1, 0)
+			{
+				bounds_.insert(bounds_.end(), ends.begin(), ends.end());
+				assert(bounds_.back() == values_.size());
+			}
+
+			//! get the number of levels
+			size_type size() const { return bounds_.size() - 1; }
+			//! check whether there are any levels at all
+			bool empty() const { return size() == 0; }
+
+			//! get an iterator to the first value on the given level
+			const_iterator begin(size_type level) const { return values_.begin() + bounds_[level]; }
+			//! get an iterator one past the last value on the given level
+			const_iterator end(size_type level) const { return values_.begin() + bounds_[level + 1]; }
+			//! get the number of values on the given level
+			size_type size(size_type level) const { return bounds_[level + 1] - bounds_[level]; }
+
+			//! get the values of all levels, one level after the other
+			const std::vector< ValueType > & values() const { return values_; }
+			//! get the index one past the last value of each level
+			std::vector< size_type > ends() const { return std::vector< size_type >(bounds_.begin() + 1, bounds_.end()); }
+
+		private :
+			std::vector< ValueType > values_;
+			std::vector< size_type > bounds_;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,118 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/mappedfile.hpp Definition of a read-only memory-mapped file.
+ * You will normally never want to include this file directly, as it is included by importer.hpp */
+#ifndef depends_details_mappedfile_hpp
+#define depends_details_mappedfile_hpp
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Depends
+{
+	namespace Details
+	{
+		//! A file, mapped read-only for as long as this object lives
+		class MappedFile
+		{
+		public :
+			/** Open and map the file. An empty file isn't mapped at all.
+			 * \throws std::system_error if it can't be opened or mapped */
+			explicit MappedFile(const std::string &path)
+				: data_(0)
+				, size_(0)
+			{
+				int fd(::open(path.c_str(), O_RDONLY));
+				if (fd < 0)
+					throw std::system_error(errno, std::generic_category(), "open " + path);
+				else
+				{ /* opened */ }
+				struct stat status;
+				if (::fstat(fd, &status) != 0)
+					fail(fd, "fstat " + path);
+				else
+				{ /* we know its size */ }
+				size_ = status.st_size;
+				if (size_)
+				{
+					void *address(::mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0));
+					if (address == MAP_FAILED)
+						fail(fd, "mmap " + path);
+					else
+					{ /* mapped: the mapping outlives the descriptor */ }
+					// it is read from start to end, once
+					::madvise(address, size_, MADV_SEQUENTIAL);
+					data_ = static_cast< const char* >(address);
+				}
+				else
+				{ /* nothing to map */ }
+				::close(fd);
+			}
+
+			~MappedFile()
+			{
+				if (data_)
+					::munmap(const_cast< char* >(data_), size_);
+				else
+				{ /* not mapped */ }
+			}
+
+			const char * begin() const { return data_; }
+			const char * end() const { return data_ + size_; }
+			std::size_t size() const { return size_; }
+
+		private :
+			MappedFile(const MappedFile &) = delete;
+			MappedFile & operator=(const MappedFile &) = delete;
+
+			void fail(int fd, const std::string &what)
+			{
+				int error(errno);
+				::close(fd);
+				throw std::system_error(error, std::generic_category(), what);
+			}
+
+			const char *data_;
+			std::size_t size_;
+		};
+	}
+}
+
+#endif
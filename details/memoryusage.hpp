@@ -0,0 +1,88 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/memoryusage.hpp Definition of the report of the memory used by a DAG or a dependency tracker.
+ * You will normally never want to include this file directly, as it is included by dag.hpp */
+#ifndef depends_details_memoryusage_hpp
+#define depends_details_memoryusage_hpp
+
+#include <cstddef>
+
+namespace Depends
+{
+	namespace Details
+	{
+		/** The memory used by a DAG or a dependency tracker, in bytes, broken down by what it is used for.
+		 * Only the memory the container allocates itself is counted: memory allocated
+		 * by the values themselves (e.g. the characters of a string) and the memory
+		 * allocator's own overhead are not. The sizes of the standard containers' nodes
+		 * are estimates. Every allocated byte is counted once: the unused capacity of
+		 * everything is counted as slack, and nowhere else. */
+		struct MemoryUsage
+		{
+			MemoryUsage()
+				: nodes_(0)
+				, adjacency_(0)
+				, values_(0)
+				, indexes_(0)
+				, slack_(0)
+			{ /* no-op */ }
+
+			//! Get the total memory used
+			std::size_t total() const { return nodes_ + adjacency_ + values_ + indexes_ + slack_; }
+
+			MemoryUsage & operator+=(MemoryUsage const &other)
+			{
+				nodes_ += other.nodes_;
+				adjacency_ += other.adjacency_;
+				values_ += other.values_;
+				indexes_ += other.indexes_;
+				slack_ += other.slack_;
+				return *this;
+			}
+
+			//! The nodes, without their values, and the DAG's list of them
+			std::size_t nodes_;
+			//! The links that don't fit in the nodes themselves
+			std::size_t adjacency_;
+			//! The values
+			std::size_t values_;
+			//! The hash tables used to find values and links, and the sketches used for estimates
+			std::size_t indexes_;
+			//! The capacity that is allocated but not used, which shrink_to_fit releases
+			std::size_t slack_;
+		};
+	}
+}
+
+#endif
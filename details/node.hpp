@@ -36,8 +36,11 @@
 #ifndef depends_details_node_hpp
 #define depends_details_node_hpp
 
+#include <utility>
+#include <vector>
 #include "../exceptions.hpp"
 #include "scopedflag.hpp"
+#include "adjacency.hpp"
 
 namespace Depends
 {
@@ -69,20 +72,32 @@ namespace Depends
 			}
 		};
 
-		//! A node, as stored in the DAG
-		template <class ValueType, typename ScoreType>
+		/** A node, as stored in the DAG.
+		 * The first InlineTargets targets of the node are kept in the node itself
+		 * (\see Adjacency). */
+		template < class ValueType, typename ScoreType, std::size_t InlineTargets = 4 >
 		struct Node
 		{
 			typedef ValueType value_type;
 			typedef ScoreType score_type;
-			typedef std::vector< Node* > targets_type;
+			typedef Adjacency< Node*, InlineTargets > targets_type;
 			
 			enum Flag { VISITED = 1 };
 
-			Node(ValueType const &v)
+			explicit Node(ValueType const &v)
 				: value_(v)
 				, score_(1)
 				, flags_(0)
+				, level_(0)
+				, position_(0)
+			{
+			}
+			explicit Node(ValueType &&v)
+				: value_(std::move(v))
+				, score_(1)
+				, flags_(0)
+				, level_(0)
+				, position_(0)
 			{
 			}
 			Node(Node const&) = default;
@@ -131,20 +146,29 @@ namespace Depends
 					}
 				}
 			}
-			void visit()
+			//! visit all nodes reachable from this one, returning the number of nodes visited
+			std::size_t visit()
 			{
-				visit([](Node*, int){}, 0);
+				std::size_t visits(0);
+				visit([](Node*, std::size_t *visits){ ++*visits; }, &visits);
+				return visits;
 			}
 
 			targets_type targets_;
 			ValueType value_;
 			ScoreType score_;
 			unsigned int flags_;
+			//! the length of the longest path leading to this node (not serialized)
+			std::size_t level_;
+			//! the node's position in the DAG's order (not serialized)
+			std::size_t position_;
 
 		private :
 			Node()
 				: score_(0)
 				, flags_(0)
+				, level_(0)
+				, position_(0)
 			{ /* only here for serialization */ }
 
 #if DEPENDS_SUPPORT_SERIALIZATION
@@ -0,0 +1,222 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/notifier.hpp Definition of the helper that collects and coalesces the changes reported to an observer.
+ * You will normally never want to include this file directly, as it is included by dag.hpp */
+#ifndef depends_details_notifier_hpp
+#define depends_details_notifier_hpp
+
+#include <cassert>
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "../observer.hpp"
+
+namespace Depends
+{
+	namespace Details
+	{
+		/** Collects the changes made to a container until the outermost group of operations is done, then reports them to the observer.
+		 * Changes are recorded by key, which is whatever the container uses to identify
+		 * its values, and turned into values only when they are reported, except for
+		 * the values that are erased: those are turned into values right away.
+		 * \param Key the type of the keys the changes are recorded by
+		 * \param ValueType the type of the values reported
+		 * \param Hash the hash function for the keys
+		 * \param KeyEqual the equality predicate for the keys
+		 * \param Convert a function object type that turns a key into the value it identifies */
+		template < typename Key, typename ValueType, typename Hash, typename KeyEqual, typename Convert >
+		class Notifier
+		{
+		public :
+			typedef Observer< ValueType > observer_type;
+			typedef ChangeSet< ValueType > change_set_type;
+
+			Notifier()
+				: observer_(0)
+				, depth_(0)
+				, reordered_(false)
+			{ /* no-op */ }
+
+			void setObserver(observer_type *observer) { observer_ = observer; }
+			observer_type * getObserver() const { return observer_; }
+
+			//! Start a group of operations
+			void begin() { ++depth_; }
+			//! End a group of operations, reporting the changes if this was the outermost group
+			void end(Convert convert = Convert())
+			{
+				assert(depth_);
+				forget();
+				if (--depth_ || !observer_)
+					return;
+				else
+				{ /* report what changed */ }
+				change_set_type changes;
+				for (auto const &key : inserted_)
+				{
+					changes.inserted_.push_back(convert(key));
+				}
+				changes.erased_.swap(erased_);
+				for (auto const &link : links_)
+				{
+					if (link.second > 0)
+						changes.linked_.push_back(std::make_pair(convert(link.first.first), convert(link.first.second)));
+					else if (link.second < 0)
+						changes.unlinked_.push_back(std::make_pair(convert(link.first.first), convert(link.first.second)));
+					else
+					{ /* made and removed again */ }
+				}
+				changes.reordered_ = reordered_;
+				inserted_.clear();
+				links_.clear();
+				reordered_ = false;
+				if (!changes.empty())
+					observer_->changed(changes);
+				else
+				{ /* nothing to report */ }
+			}
+
+			void inserted(Key const &key)
+			{
+				if (observer_)
+					inserted_.insert(key);
+				else
+				{ /* not observed */ }
+			}
+			/** Record that the value with the given key is erased.
+			 * The links to and from it are forgotten at the end of the operation,
+			 * after which the key may be re-used for another value. */
+			void erased(Key const &key, ValueType const &value)
+			{
+				if (observer_)
+				{
+					if (!inserted_.erase(key))
+						erased_.push_back(value);
+					else
+					{ /* inserted and erased in the same group */ }
+					erased_keys_.insert(key);
+				}
+				else
+				{ /* not observed */ }
+			}
+			void linked(Key const &source, Key const &target)
+			{
+				if (observer_)
+					++links_[std::make_pair(source, target)];
+				else
+				{ /* not observed */ }
+			}
+			void unlinked(Key const &source, Key const &target)
+			{
+				if (observer_)
+					--links_[std::make_pair(source, target)];
+				else
+				{ /* not observed */ }
+			}
+			void reordered()
+			{
+				if (observer_)
+					reordered_ = true;
+				else
+				{ /* not observed */ }
+			}
+
+		private :
+			// Neither CopyConstructible nor Assignable
+			Notifier(const Notifier &);
+			Notifier & operator=(const Notifier &);
+
+			typedef std::pair< Key, Key > Link;
+			struct LinkHash
+			{
+				std::size_t operator()(Link const &link) const
+				{
+					Hash hash;
+					return hash(link.first) * 31 + hash(link.second);
+				}
+			};
+			struct LinkEqual
+			{
+				bool operator()(Link const &lhs, Link const &rhs) const
+				{
+					KeyEqual equal;
+					return equal(lhs.first, rhs.first) && equal(lhs.second, rhs.second);
+				}
+			};
+
+			//! \internal Forget the links to and from the values erased by the operation that just ended
+			void forget()
+			{
+				if (erased_keys_.empty())
+					return;
+				else
+				{ /* drop their links */ }
+				for (auto link(links_.begin()); link != links_.end(); )
+				{
+					if (erased_keys_.count(link->first.first) || erased_keys_.count(link->first.second))
+						link = links_.erase(link);
+					else
+						++link;
+				}
+				erased_keys_.clear();
+			}
+
+			observer_type *observer_;
+			std::size_t depth_;
+			std::unordered_set< Key, Hash, KeyEqual > inserted_;
+			std::vector< ValueType > erased_;
+			std::unordered_set< Key, Hash, KeyEqual > erased_keys_;
+			//! \internal The number of times each link was made, less the number of times it was removed: -1, 0 or 1
+			std::unordered_map< Link, int, LinkHash, LinkEqual > links_;
+			bool reordered_;
+		};
+
+		//! \internal A Notifier's Convert for containers that record their changes by value
+		struct Identity
+		{
+			template < typename T >
+			T const & operator()(T const &t) const { return t; }
+		};
+		//! \internal A Notifier's Convert for containers that record their changes by pointer
+		struct Dereference
+		{
+			template < typename T >
+			T const & operator()(T const *t) const { return *t; }
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,178 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/persistentvector.hpp Definition of the persistent vector used by Depends::PersistentDAG.
+ * You will normally never want to include this file directly, as it is included by persistentdag.hpp */
+#ifndef depends_details_persistentvector_hpp
+#define depends_details_persistentvector_hpp
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace Depends
+{
+	namespace Details
+	{
+		/** A vector of which copies share their structure.
+		 * The values are kept in the leaves of a tree in which every node has
+		 * (up to) 2^Bits children. Copying the vector only copies a pointer to
+		 * the root of that tree, and changing a value in a vector only copies
+		 * the nodes on the path from the root to the value's leaf if those nodes
+		 * are shared with another vector - so the other vector never sees the
+		 * change. Nodes that are not shared are modified in place.
+		 *
+		 * Any number of threads may read from vectors that share structure at
+		 * the same time, but any single vector must not be read while it is
+		 * being modified or copied. */
+		template < typename ValueType, unsigned int Bits = 5 >
+		class PersistentVector
+		{
+		public :
+			typedef ValueType value_type;
+			typedef std::size_t size_type;
+
+			PersistentVector()
+				: size_(0)
+				, shift_(0)
+			{ /* no-op */ }
+
+			//! get the number of values in the vector
+			size_type size() const { return size_; }
+			//! check whether the vector is empty
+			bool empty() const { return size_ == 0; }
+
+			//! get the value at the given index. \pre index < size()
+			const ValueType & operator[](size_type index) const
+			{
+				assert(index < size_);
+				const Node *node(root_.get());
+				for (unsigned int shift(shift_); shift; shift -= Bits)
+				{
+					node = node->children_[(index >> shift) & mask__].get();
+				}
+
+				return node->values_[index & mask__];
+			}
+
+			//! replace the value at the given index. \pre index < size()
+			void set(size_type index, ValueType value)
+			{
+				assert(index < size_);
+				*find(index) = std::move(value);
+			}
+
+			//! add a value at the end of the vector
+			void push_back(ValueType value)
+			{
+				if (!root_)
+				{
+					root_ = std::make_shared< Node >();
+				}
+				else if (size_ == (size_type(width__) << shift_))
+				{	// the tree is full: add a level
+					std::shared_ptr< Node > root(std::make_shared< Node >());
+					root->children_.push_back(root_);
+					root_ = root;
+					shift_ += Bits;
+				}
+				else
+				{ /* there's room in the tree */ }
+				++size_;
+				*find(size_ - 1) = std::move(value);
+			}
+
+		private :
+			enum : size_type { width__ = size_type(1) << Bits, mask__ = width__ - 1 };
+
+			//! \internal a node of the tree: leaves have values, all other nodes have children
+			struct Node
+			{
+				std::vector< std::shared_ptr< Node > > children_;
+				std::vector< ValueType > values_;
+			};
+
+			/** \internal find the slot for the value at the given index, making a copy
+			 * of every shared node on the way (and creating those that are missing) */
+			ValueType * find(size_type index)
+			{
+				Node *node(unshare(root_));
+				for (unsigned int shift(shift_); shift; shift -= Bits)
+				{
+					size_type which((index >> shift) & mask__);
+					if (which >= node->children_.size())
+					{
+						assert(which == node->children_.size());
+						node->children_.push_back(std::make_shared< Node >());
+					}
+					else
+					{ /* existing child */ }
+					node = unshare(node->children_[which]);
+				}
+				size_type which(index & mask__);
+				if (which >= node->values_.size())
+				{
+					assert(which == node->values_.size());
+					node->values_.resize(which + 1);
+				}
+				else
+				{ /* existing value */ }
+
+				return &node->values_[which];
+			}
+
+			//! \internal make sure the given node is not shared with any other vector
+			static Node * unshare(std::shared_ptr< Node > &node)
+			{
+				if (node.use_count() > 1)
+					node = std::make_shared< Node >(*node);
+				else
+				{
+					/* we're the only owner: use_count is a relaxed read, so order whatever the thread that dropped
+					 * the last other reference did with the node before the changes we're about to make to it */
+					std::atomic_thread_fence(std::memory_order_acquire);
+				}
+
+				return node.get();
+			}
+
+			std::shared_ptr< Node > root_;
+			size_type size_;
+			unsigned int shift_;
+		};
+	}
+}
+
+#endif
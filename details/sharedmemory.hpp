@@ -0,0 +1,160 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/sharedmemory.hpp Definition of a mapped POSIX shared-memory segment.
+ * You will normally never want to include this file directly, as it is included by shareddag.hpp */
+#ifndef depends_details_sharedmemory_hpp
+#define depends_details_sharedmemory_hpp
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Depends
+{
+	namespace Details
+	{
+		//! A named POSIX shared-memory segment, mapped for as long as this object lives
+		class SharedMemory
+		{
+		public :
+			enum Mode {
+				  READ			//!< map an existing segment, read-only
+				, OPEN_OR_CREATE	//!< map a segment read-write, creating it or growing it to the given size if needed
+				, CREATE		//!< create a new segment of the given size and map it read-write; fails if it exists
+				};
+
+			SharedMemory()
+				: address_(0)
+				, size_(0)
+			{ /* no-op */ }
+
+			/** Open and map the named segment.
+			 * \throws std::system_error if it can't be opened, created or mapped */
+			SharedMemory(const std::string &name, Mode mode, std::size_t size = 0, mode_t permissions = 0644)
+				: address_(0)
+				, size_(size)
+			{
+				int flags(mode == READ ? O_RDONLY : mode == OPEN_OR_CREATE ? O_RDWR | O_CREAT : O_RDWR | O_CREAT | O_EXCL);
+				int fd(::shm_open(name.c_str(), flags, permissions));
+				if (fd < 0)
+					throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+				else
+				{ /* opened */ }
+				struct stat status;
+				if (::fstat(fd, &status) != 0)
+					fail(fd, "fstat " + name);
+				else
+				{ /* we know its size */ }
+				if (mode == READ)
+					size_ = status.st_size;
+				else if (std::size_t(status.st_size) < size_ && ::ftruncate(fd, size_) != 0)
+					fail(fd, "ftruncate " + name);
+				else
+				{ /* large enough */ }
+				if (!size_)
+				{
+					::close(fd);
+					throw std::system_error(std::make_error_code(std::errc::invalid_argument), "empty segment " + name);
+				}
+				else
+				{ /* something to map */ }
+				void *address(::mmap(0, size_, mode == READ ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+				if (address == MAP_FAILED)
+					fail(fd, "mmap " + name);
+				else
+				{ /* mapped: the mapping outlives the descriptor */ }
+				::close(fd);
+				address_ = address;
+			}
+
+			SharedMemory(SharedMemory &&other)
+				: address_(other.address_)
+				, size_(other.size_)
+			{
+				other.address_ = 0;
+				other.size_ = 0;
+			}
+
+			SharedMemory & operator=(SharedMemory &&other)
+			{
+				SharedMemory temp(std::move(other));
+				swap(temp);
+				return *this;
+			}
+
+			~SharedMemory()
+			{
+				if (address_)
+					::munmap(address_, size_);
+				else
+				{ /* not mapped */ }
+			}
+
+			void swap(SharedMemory &other)
+			{
+				std::swap(address_, other.address_);
+				std::swap(size_, other.size_);
+			}
+
+			void * address() const { return address_; }
+			std::size_t size() const { return size_; }
+
+			/** Remove the named segment. Whoever has it mapped keeps it until they unmap it.
+			 * \return false if there was no such segment */
+			static bool unlink(const std::string &name) { return ::shm_unlink(name.c_str()) == 0; }
+
+		private :
+			SharedMemory(const SharedMemory &) = delete;
+			SharedMemory & operator=(const SharedMemory &) = delete;
+
+			static void fail(int fd, const std::string &what)
+			{
+				int error(errno);
+				::close(fd);
+				throw std::system_error(error, std::generic_category(), what);
+			}
+
+			void *address_;
+			std::size_t size_;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,264 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/smallvector.hpp Definition of the vector the DAG's nodes keep their targets in.
+ * You will normally never want to include this file directly, as it is included by node.hpp */
+#ifndef depends_details_smallvector_hpp
+#define depends_details_smallvector_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Depends
+{
+	namespace Details
+	{
+		/** A vector that keeps up to N values inline, only allocating once it grows beyond that.
+		 * Most nodes in a DAG only link to a few others, so keeping their targets in
+		 * the node itself saves an allocation per node and a cache miss per node
+		 * visited. Only trivially copyable values are supported (the DAG only stores
+		 * pointers in it), which keeps copying and growing a matter of memcpy.
+		 *
+		 * \param T the type of the values, which must be trivially copyable
+		 * \param N the number of values kept inline */
+		template < typename T, std::size_t N >
+		class SmallVector
+		{
+			static_assert(std::is_trivially_copyable< T >::value, "SmallVector only supports trivially copyable values");
+		public :
+			typedef T value_type;
+			typedef T & reference;
+			typedef T const & const_reference;
+			typedef T * pointer;
+			typedef T const * const_pointer;
+			typedef T * iterator;
+			typedef T const * const_iterator;
+			typedef std::reverse_iterator< iterator > reverse_iterator;
+			typedef std::reverse_iterator< const_iterator > const_reverse_iterator;
+			typedef std::size_t size_type;
+			typedef std::ptrdiff_t difference_type;
+
+			//! The number of values kept inline
+			static const size_type inline_capacity = N;
+
+			SmallVector()
+				: data_(inlineData())
+				, size_(0)
+				, capacity_(N)
+			{ /* no-op */ }
+			SmallVector(SmallVector const &other)
+				: data_(inlineData())
+				, size_(0)
+				, capacity_(N)
+			{
+				assign(other.begin(), other.end());
+			}
+			SmallVector(SmallVector &&other)
+				: data_(inlineData())
+				, size_(0)
+				, capacity_(N)
+			{
+				steal(other);
+			}
+			~SmallVector()
+			{
+				release();
+			}
+
+			SmallVector & operator=(SmallVector const &other)
+			{
+				if (this != &other)
+					assign(other.begin(), other.end());
+				else
+				{ /* self-assignment */ }
+				return *this;
+			}
+			SmallVector & operator=(SmallVector &&other)
+			{
+				if (this != &other)
+				{
+					release();
+					data_ = inlineData();
+					size_ = 0;
+					capacity_ = N;
+					steal(other);
+				}
+				else
+				{ /* self-assignment */ }
+				return *this;
+			}
+
+			iterator begin() { return data_; }
+			const_iterator begin() const { return data_; }
+			const_iterator cbegin() const { return data_; }
+			iterator end() { return data_ + size_; }
+			const_iterator end() const { return data_ + size_; }
+			const_iterator cend() const { return data_ + size_; }
+			reverse_iterator rbegin() { return reverse_iterator(end()); }
+			const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+			reverse_iterator rend() { return reverse_iterator(begin()); }
+			const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+			size_type size() const { return size_; }
+			bool empty() const { return size_ == 0; }
+			size_type capacity() const { return capacity_; }
+			//! check whether the values are kept inline
+			bool isInline() const { return data_ == inlineData(); }
+			//! the number of bytes allocated outside of the vector itself
+			size_type allocated() const { return isInline() ? 0 : capacity_ * sizeof(T); }
+
+			reference operator[](size_type i) { return data_[i]; }
+			const_reference operator[](size_type i) const { return data_[i]; }
+			reference front() { return data_[0]; }
+			const_reference front() const { return data_[0]; }
+			reference back() { return data_[size_ - 1]; }
+			const_reference back() const { return data_[size_ - 1]; }
+
+			void push_back(T const &value)
+			{
+				if (size_ == capacity_)
+				{	// value may be one of our own
+					T copy(value);
+					reserve(capacity_ ? capacity_ * 2 : 1);
+					data_[size_++] = copy;
+				}
+				else
+				{
+					data_[size_++] = value;
+				}
+			}
+			void pop_back() { --size_; }
+			void clear() { size_ = 0; }
+
+			iterator erase(const_iterator where)
+			{
+				return erase(where, where + 1);
+			}
+			iterator erase(const_iterator first, const_iterator last)
+			{
+				iterator target(data_ + (first - data_));
+				std::memmove(target, last, (end() - last) * sizeof(T));
+				size_ -= last - first;
+				return target;
+			}
+
+			template < typename InputIterator >
+			void assign(InputIterator first, InputIterator last)
+			{
+				clear();
+				for (; first != last; ++first)
+				{
+					push_back(*first);
+				}
+			}
+
+			//! make room for at least capacity values
+			void reserve(size_type capacity)
+			{
+				if (capacity <= capacity_)
+					return;
+				else
+				{ /* grow */ }
+				T *data(static_cast< T* >(::operator new(capacity * sizeof(T))));
+				std::memcpy(data, data_, size_ * sizeof(T));
+				release();
+				data_ = data;
+				capacity_ = capacity;
+			}
+			//! release any memory that isn't needed, moving the values back inline if they fit
+			void shrink_to_fit()
+			{
+				if (isInline() || size_ == capacity_)
+					return;
+				else
+				{ /* shrink */ }
+				T *data(size_ <= N ? inlineData() : static_cast< T* >(::operator new(size_ * sizeof(T))));
+				std::memcpy(data, data_, size_ * sizeof(T));
+				release();
+				data_ = data;
+				capacity_ = size_ <= N ? N : size_;
+			}
+
+			void swap(SmallVector &other)
+			{
+				SmallVector temp(std::move(other));
+				other = std::move(*this);
+				*this = std::move(temp);
+			}
+
+		private :
+			T * inlineData() { return reinterpret_cast< T* >(&inline_); }
+			T const * inlineData() const { return reinterpret_cast< T const* >(&inline_); }
+
+			//! \internal free the heap-allocated values, if any
+			void release()
+			{
+				if (!isInline())
+					::operator delete(data_);
+				else
+				{ /* nothing to free */ }
+			}
+
+			/** \internal take the values from other, which is left empty.
+			 * \pre this vector is empty and inline */
+			void steal(SmallVector &other)
+			{
+				if (other.isInline())
+				{
+					std::memcpy(data_, other.data_, other.size_ * sizeof(T));
+				}
+				else
+				{
+					data_ = other.data_;
+					capacity_ = other.capacity_;
+					other.data_ = other.inlineData();
+					other.capacity_ = N;
+				}
+				size_ = other.size_;
+				other.size_ = 0;
+			}
+
+			T *data_;
+			size_type size_;
+			size_type capacity_;
+			typename std::aligned_storage< sizeof(T) * (N ? N : 1), alignof(T) >::type inline_;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,212 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file details/topological.hpp Definition of the lazy topological view of a DAG.
+ * You will normally never want to include this file directly, as it is included by dag.hpp */
+#ifndef depends_details_topological_hpp
+#define depends_details_topological_hpp
+
+#include <cstddef>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+namespace Depends
+{
+	namespace Details
+	{
+		/** A single-pass range over the nodes of a DAG, or of part of it, in topological order.
+		 * The order is produced as the range is iterated, using Kahn's algorithm: each
+		 * node has a count of the links to it that haven't been followed yet, and a node
+		 * is next in line once that count drops to zero. Nothing more than those counts
+		 * and the nodes that are next in line are kept, so no sorted copy of the nodes is
+		 * ever made, and iteration can stop at any time.
+		 *
+		 * The range can cover all of the DAG's nodes, or only a set of starting nodes and
+		 * everything they link to, directly or not. In the latter case, only the links
+		 * between the nodes in the range count, and the counts are kept in a hash table,
+		 * so the range takes time and memory proportional to its own size rather than to
+		 * that of the DAG.
+		 *
+		 * The range is only valid as long as the DAG doesn't change. */
+		template < typename NodeType, typename ValueType >
+		class TopologicalRange
+		{
+		public :
+			typedef NodeType node_type;
+			typedef std::size_t size_type;
+
+			//! The range's input iterator
+			class iterator : public std::iterator< std::input_iterator_tag, ValueType, std::ptrdiff_t, ValueType const*, ValueType const& >
+			{
+			public :
+				iterator()
+					: range_(0)
+				{ /* no-op */ }
+
+				ValueType const & operator*() const { return range_->ready_.back()->value_; }
+				ValueType const * operator->() const { return &range_->ready_.back()->value_; }
+				//! Get the node the iterator is at
+				node_type const * node() const { return range_->ready_.back(); }
+
+				iterator & operator++()
+				{
+					range_->next();
+					return *this;
+				}
+				//! The iterator is single-pass, so this doesn't return a copy
+				void operator++(int) { range_->next(); }
+
+				//! Only an iterator at the end of the range compares equal to another one
+				bool operator==(iterator const &other) const { return atEnd() == other.atEnd(); }
+				bool operator!=(iterator const &other) const { return !(*this == other); }
+
+			private :
+				explicit iterator(TopologicalRange *range)
+					: range_(range)
+				{ /* no-op */ }
+
+				bool atEnd() const { return !range_ || range_->ready_.empty(); }
+
+				TopologicalRange *range_;
+
+				friend class TopologicalRange;
+			};
+
+			/** Construct a range over all of the given nodes.
+			 * \pre each node's position_ is its index in nodes */
+			template < typename Nodes >
+			explicit TopologicalRange(Nodes const &nodes)
+				: counts_(nodes.size(), 0)
+				, whole_(true)
+			{
+				for (auto node : nodes)
+				{
+					for (auto target : node->targets_)
+					{
+						++counts_[target->position_];
+					}
+				}
+				for (auto node : nodes)
+				{
+					if (!counts_[node->position_])
+						ready_.push_back(node);
+					else
+					{ /* not ready yet */ }
+				}
+			}
+
+			/** Construct a range over the given starting nodes and everything they link to.
+			 * Starting nodes that are reached from other starting nodes, or given more than
+			 * once, appear in the range only once, in their place in the order. */
+			template < typename InputIterator >
+			TopologicalRange(InputIterator first, InputIterator last)
+				: whole_(false)
+			{
+				std::vector< node_type const* > starts(first, last);
+				std::vector< node_type const* > stack(starts);
+				partial_counts_.reserve(starts.size());
+				for (auto start : starts)
+				{
+					partial_counts_.insert(std::make_pair(start, 0));
+				}
+				while (!stack.empty())
+				{
+					node_type const *node(stack.back());
+					stack.pop_back();
+					for (auto target : node->targets_)
+					{
+						if (partial_counts_.insert(std::make_pair(target, 0)).second)
+							stack.push_back(target);
+						else
+						{ /* already reached */ }
+					}
+				}
+				for (auto const &entry : partial_counts_)
+				{
+					for (auto target : entry.first->targets_)
+					{
+						++partial_counts_[target];
+					}
+				}
+				for (auto start : starts)
+				{
+					size_type &count(partial_counts_[start]);
+					if (!count)
+					{
+						ready_.push_back(start);
+						// so a start given more than once is only ready once
+						count = static_cast< size_type >(-1);
+					}
+					else
+					{ /* reached from another starting node */ }
+				}
+			}
+
+			//! Get an iterator to the first node in the range; this can only be done once
+			iterator begin() { return iterator(this); }
+			iterator end() { return iterator(); }
+
+		private :
+			//! \internal Get the number of links to the given node that haven't been followed yet
+			size_type & count(node_type const *node)
+			{
+				return whole_ ? counts_[node->position_] : partial_counts_.find(node)->second;
+			}
+
+			//! \internal Move on to the next node: the targets of the current one that have nothing else linking to them are next in line
+			void next()
+			{
+				node_type const *node(ready_.back());
+				ready_.pop_back();
+				for (auto target : node->targets_)
+				{
+					if (!--count(target))
+						ready_.push_back(target);
+					else
+					{ /* something else still links to it */ }
+				}
+			}
+
+			//! \internal The counts, by position, for a range over the whole DAG
+			std::vector< size_type > counts_;
+			//! \internal The counts, for a range over part of the DAG
+			std::unordered_map< node_type const*, size_type > partial_counts_;
+			bool whole_;
+			//! \internal The nodes that are next in line, the current one last
+			std::vector< node_type const* > ready_;
+		};
+	}
+}
+
+#endif
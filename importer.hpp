@@ -0,0 +1,376 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file importer.hpp Reading dependencies in bulk from text files of edges. */
+#ifndef depends_importer_hpp
+#define depends_importer_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "details/mappedfile.hpp"
+
+namespace Depends
+{
+	/** A list of edges read from a text file, with the names of the values interned.
+	 * Each line of the file holds the name of a source followed by the name of its
+	 * target, separated by spaces or tabs: in a DAG, the source is linked to the
+	 * target; in a Depends tracker, the source is a prerequisite of the target. A
+	 * line with a single name adds the value without linking it to anything. Empty
+	 * lines are skipped, as is anything from a name that starts with a '#' to the
+	 * end of its line.
+	 *
+	 * The file is mapped into memory and split into chunks at line boundaries,
+	 * which are tokenized in parallel, each with a table of its own to intern the
+	 * names it finds. The chunks' tables are then merged, in order, so that each
+	 * name is copied only once and the values are numbered in the order in which
+	 * they first appear in the file, however many threads are used. The links are
+	 * kept as pairs of such numbers.
+	 *
+	 * The result is meant to be built in bulk, with a single check for circular
+	 * references and a single re-ordering, rather than linked one edge at a time
+	 * (\see assignTo).
+	 * \code
+	 * Depends::DAG< std::string > dag;
+	 * Depends::EdgeList("manifest.txt").assignTo(dag);
+	 * \endcode */
+	class EdgeList
+	{
+	public :
+		typedef std::size_t size_type;
+		typedef std::vector< std::string > values_type;
+		//! The links, as the positions of their source and target in values()
+		typedef std::vector< std::pair< size_type, size_type > > links_type;
+
+		//! A link, as the names of its source and target
+		struct Link
+		{
+			const std::string &first;
+			const std::string &second;
+		};
+
+		//! Iterates over the links as the names of their sources and targets, which is what DAG::assign and Depends::assign take
+		class LinkIterator : public std::iterator< std::forward_iterator_tag, Link, std::ptrdiff_t, const Link*, Link >
+		{
+		public :
+			//! \internal what operator-> returns: a link that lives as long as it is being looked at
+			struct Arrow
+			{
+				const Link * operator->() const { return &link_; }
+				Link link_;
+			};
+
+			LinkIterator(EdgeList const *list, links_type::const_iterator where)
+				: list_(list)
+				, where_(where)
+			{ /* no-op */ }
+
+			Link operator*() const { Link link = { list_->values_[where_->first], list_->values_[where_->second] }; return link; }
+			Arrow operator->() const { Arrow arrow = { **this }; return arrow; }
+
+			bool operator==(const LinkIterator &other) const { return where_ == other.where_; }
+			bool operator!=(const LinkIterator &other) const { return where_ != other.where_; }
+
+			LinkIterator& operator++() { ++where_; return *this; }
+			LinkIterator operator++(int) { LinkIterator tmp(*this); ++where_; return tmp; }
+
+		private :
+			EdgeList const *list_;
+			links_type::const_iterator where_;
+		};
+
+		/** Read the edges in the given file.
+		 * \param path the file to read
+		 * \param threads the number of threads to use, or 0 to use one per core.
+		 *        Small files are read by fewer threads, as each chunk is at least
+		 *        a megabyte
+		 * \throws std::system_error if the file can't be read
+		 * \throws std::invalid_argument if a line has more than two names on it */
+		explicit EdgeList(const std::string &path, unsigned int threads = 0)
+		{
+			Details::MappedFile file(path);
+			read(file.begin(), file.end(), threads);
+		}
+
+		/** Read the edges in the given text, which is in the same format as the files.
+		 * \see EdgeList(const std::string &, unsigned int) */
+		EdgeList(const char *first, const char *last, unsigned int threads = 0)
+		{
+			read(first, last, threads);
+		}
+
+		//! Get the values, in the order in which they first appear
+		values_type const & values() const { return values_; }
+		//! Get the links, as the positions of their source and target in values()
+		links_type const & links() const { return links_; }
+
+		LinkIterator linksBegin() const { return LinkIterator(this, links_.begin()); }
+		LinkIterator linksEnd() const { return LinkIterator(this, links_.end()); }
+
+		/** Replace the contents of a DAG or a Depends tracker with the values and links, built in bulk.
+		 * \throws CircularReference if the links contain a circular reference, in which case the target is left untouched */
+		template < typename Target >
+		void assignTo(Target &target) const
+		{
+			target.assign(values_.begin(), values_.end(), linksBegin(), linksEnd());
+		}
+
+	private :
+		enum : size_type { minimum_chunk__ = 1 << 20 };
+
+		//! \internal a name, as it is found in the file
+		struct Token
+		{
+			const char *begin_;
+			size_type size_;
+			size_type hash_;
+		};
+		struct TokenHash
+		{
+			size_type operator()(const Token &token) const { return token.hash_; }
+		};
+		struct TokenEqual
+		{
+			bool operator()(const Token &lhs, const Token &rhs) const { return lhs.size_ == rhs.size_ && std::memcmp(lhs.begin_, rhs.begin_, lhs.size_) == 0; }
+		};
+		typedef std::unordered_map< Token, size_type, TokenHash, TokenEqual > Interned;
+
+		//! \internal what each chunk of the file comes down to: its names, and its links as positions among those names
+		struct Chunk
+		{
+			Chunk()
+				: lines_(0)
+				, error_(false)
+			{ /* no-op */ }
+
+			const char *begin_;
+			const char *end_;
+			std::vector< Token > tokens_;
+			links_type links_;
+			size_type lines_;
+			bool error_;
+		};
+
+		static bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+		//! \internal FNV-1a
+		static size_type hash(const char *first, const char *last)
+		{
+			std::uint64_t retval(0xcbf29ce484222325ull);
+			for (; first != last; ++first)
+			{
+				retval = (retval ^ static_cast< unsigned char >(*first)) * 0x100000001b3ull;
+			}
+			return static_cast< size_type >(retval);
+		}
+
+		//! \internal tokenize a chunk, interning its names; stops at the first malformed line
+		static void tokenize(Chunk &chunk)
+		{
+			Interned interned;
+			const char *where(chunk.begin_);
+			while (where != chunk.end_)
+			{
+				size_type names[2];
+				unsigned int count(0);
+				for (;;)
+				{
+					while (where != chunk.end_ && isBlank(*where))
+					{
+						++where;
+					}
+					if (where == chunk.end_ || *where == '\n')
+						break;
+					else if (*where == '#')
+					{
+						where = static_cast< const char* >(std::memchr(where, '\n', chunk.end_ - where));
+						where = where ? where : chunk.end_;
+						break;
+					}
+					else
+					{ /* a name */ }
+					const char *name(where);
+					while (where != chunk.end_ && *where != '\n' && !isBlank(*where))
+					{
+						++where;
+					}
+					if (count == 2)
+					{
+						chunk.error_ = true;
+						return;
+					}
+					else
+					{ /* expected */ }
+					Token token = { name, size_type(where - name), hash(name, where) };
+					auto inserted(interned.emplace(token, chunk.tokens_.size()));
+					if (inserted.second)
+						chunk.tokens_.push_back(token);
+					else
+					{ /* seen it before */ }
+					names[count++] = inserted.first->second;
+				}
+				if (count == 2)
+					chunk.links_.emplace_back(names[0], names[1]);
+				else
+				{ /* a lone value, or nothing */ }
+				++chunk.lines_;
+				if (where != chunk.end_)
+					++where;
+				else
+				{ /* last line without a newline */ }
+			}
+		}
+
+		//! \internal split the text into chunks, tokenize them in parallel and merge the results
+		void read(const char *first, const char *last, unsigned int threads)
+		{
+			size_type const size(last - first);
+			if (threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+			else
+			{ /* as requested */ }
+			threads = static_cast< unsigned int >(std::max< size_type >(1, std::min< size_type >(threads, size / minimum_chunk__)));
+			std::vector< Chunk > chunks(threads);
+			const char *begin(first);
+			for (unsigned int which(0); which < threads; ++which)
+			{
+				const char *end(which + 1 == threads ? last : first + size / threads * (which + 1));
+				end = std::max(begin, end);
+				const char *newline(end == last ? 0 : static_cast< const char* >(std::memchr(end, '\n', last - end)));
+				end = newline ? newline + 1 : last;
+				chunks[which].begin_ = begin;
+				chunks[which].end_ = end;
+				begin = end;
+			}
+
+			std::mutex error_lock;
+			std::exception_ptr error;
+			auto work = [&](Chunk &chunk) {
+					try
+					{
+						tokenize(chunk);
+					}
+					catch (...)
+					{
+						std::lock_guard< std::mutex > lock(error_lock);
+						if (!error)
+							error = std::current_exception();
+						else
+						{ /* only the first one is kept */ }
+					}
+				};
+			std::vector< std::thread > workers;
+			workers.reserve(threads - 1);
+			unsigned int spawned(1);
+			try
+			{
+				for (; spawned < threads; ++spawned)
+				{
+					workers.push_back(std::thread(work, std::ref(chunks[spawned])));
+				}
+			}
+			catch (const std::system_error &)
+			{ /* make do with the threads we have */ }
+			work(chunks[0]);
+			for (unsigned int which(spawned); which < threads; ++which)
+			{
+				work(chunks[which]);
+			}
+			for (auto &worker : workers)
+			{
+				worker.join();
+			}
+			if (error)
+				std::rethrow_exception(error);
+			else
+			{ /* all went well */ }
+
+			merge(chunks);
+		}
+
+		//! \internal merge the chunks' names, in order, and renumber their links
+		void merge(std::vector< Chunk > &chunks)
+		{
+			size_type lines(0);
+			size_type links(0);
+			for (auto const &chunk : chunks)
+			{
+				if (chunk.error_)
+					throw std::invalid_argument("line " + std::to_string(lines + chunk.lines_ + 1) + ": expected a source and a target");
+				else
+				{ /* fine */ }
+				lines += chunk.lines_;
+				links += chunk.links_.size();
+			}
+			links_.reserve(links);
+			Interned interned;
+			for (auto &chunk : chunks)
+			{
+				std::vector< size_type > renumbered;
+				renumbered.reserve(chunk.tokens_.size());
+				for (auto const &token : chunk.tokens_)
+				{
+					auto inserted(interned.emplace(token, values_.size()));
+					if (inserted.second)
+						values_.emplace_back(token.begin_, token.size_);
+					else
+					{ /* another chunk had it first */ }
+					renumbered.push_back(inserted.first->second);
+				}
+				for (auto const &link : chunk.links_)
+				{
+					links_.emplace_back(renumbered[link.first], renumbered[link.second]);
+				}
+				links_type().swap(chunk.links_);
+			}
+		}
+
+		values_type values_;
+		links_type links_;
+	};
+}
+
+#endif
@@ -0,0 +1,103 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file observer.hpp The interface through which changes to a Depends::DAG or a Depends::Depends are reported. */
+#ifndef depends_observer_hpp
+#define depends_observer_hpp
+
+#include <utility>
+#include <vector>
+
+namespace Depends
+{
+	/** The changes made to a DAG or a dependency tracker by a group of operations.
+	 * The changes are coalesced: a link that is made and then removed again, or a
+	 * value that is inserted and then erased again, in the same group doesn't appear
+	 * at all. A value that is erased takes its links with it, so these are not
+	 * reported separately. The values and links in each list are in no particular order. */
+	template < typename ValueType >
+	struct ChangeSet
+	{
+		typedef ValueType value_type;
+		//! A link, with the source as its first member and the target as its second
+		typedef std::pair< value_type, value_type > link_type;
+
+		ChangeSet()
+			: reordered_(false)
+		{ /* no-op */ }
+
+		//! Check whether nothing changed
+		bool empty() const
+		{
+			return inserted_.empty() && erased_.empty() && linked_.empty() && unlinked_.empty() && !reordered_;
+		}
+
+		//! The values that were inserted
+		std::vector< value_type > inserted_;
+		//! The values that were erased
+		std::vector< value_type > erased_;
+		//! The links that were made
+		std::vector< link_type > linked_;
+		//! The links that were removed
+		std::vector< link_type > unlinked_;
+		//! Whether the order of the values that remain may have changed
+		bool reordered_;
+	};
+
+	/** Gets told about the changes made to a DAG or a dependency tracker.
+	 * An observer is attached to a container using its \c setObserver method,
+	 * after which each operation that changes the container reports its changes
+	 * in a single call to \c changed, once it is done: an operation that makes
+	 * thousands of links, such as DAG::linkTargets, calls it only once. Several
+	 * operations can be grouped into a single notification by doing them while a
+	 * \c Batch of the container exists. Containers without an observer pay for a
+	 * single test of a null pointer per change.
+	 *
+	 * The observer is called after the container is done changing, so it can query
+	 * the container, but it must not throw. An observer must outlive any container
+	 * it is attached to. */
+	template < typename ValueType >
+	class Observer
+	{
+	public :
+		typedef ValueType value_type;
+		typedef ChangeSet< ValueType > change_set_type;
+
+		virtual ~Observer() {}
+
+		//! Called with the changes made by an operation, or by a batch of them
+		virtual void changed(change_set_type const &changes) = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,342 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file ordering.hpp The ordering policies of the Depends::DAG class.
+ * A DAG takes one of these as a template parameter to decide, at compile time,
+ * in which order it keeps its nodes and what it does to maintain that order when
+ * links are made or removed. You will normally not need to include this file
+ * directly, as it is included by dag.hpp */
+#ifndef depends_ordering_hpp
+#define depends_ordering_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "details/scopedflag.hpp"
+#include "exceptions.hpp"
+
+namespace Depends
+{
+	namespace Details
+	{
+		//! Tell the nodes in [from, to) where they are in the given order
+		template < typename Nodes >
+		void renumber(Nodes &nodes, std::size_t from, std::size_t to)
+		{
+			for (std::size_t position(from); position < to; ++position)
+			{
+				nodes[position]->position_ = position;
+			}
+		}
+
+		/** Call f with each of the given nodes, in topological order, using Kahn's algorithm.
+		 * This takes time proportional to the number of nodes and links.
+		 * \pre each node's position_ is its index in nodes */
+		template < typename Nodes, typename F >
+		void kahn(Nodes const &nodes, F f)
+		{
+			std::vector< std::size_t > incoming(nodes.size(), 0);
+			for (auto node : nodes)
+			{
+				for (auto target : node->targets_)
+				{
+					++incoming[target->position_];
+				}
+			}
+			Nodes ready;
+			for (auto node : nodes)
+			{
+				if (!incoming[node->position_])
+					ready.push_back(node);
+				else
+				{ /* not ready yet */ }
+			}
+			while (!ready.empty())
+			{
+				auto node(ready.back());
+				ready.pop_back();
+				f(node);
+				for (auto target : node->targets_)
+				{
+					if (!--incoming[target->position_])
+						ready.push_back(target);
+					else
+					{ /* something else still links to it */ }
+				}
+			}
+		}
+
+		/** Check that linking source to target would not create a circular reference,
+		 * by visiting everything reachable from the target with the source flagged.
+		 * \return the number of nodes visited
+		 * \throws CircularReference if the target reaches the source */
+		template < typename NodeType >
+		std::size_t checkLink(NodeType *source, NodeType *target)
+		{
+			ScopedFlag< NodeType > scoped_flag(source, NodeType::VISITED);
+			return target->visit();
+		}
+	}
+
+	/** The ordering policies a DAG can be instantiated with.
+	 * Each policy decides in which order a DAG keeps, and therefore iterates over,
+	 * its nodes. The policy is called by the DAG, with the DAG's vector of nodes,
+	 * whenever a node is inserted or a link is made or removed:
+	 * \li \c insert(nodes, node) puts a new node in the vector
+	 * \li \c check(nodes, source, target) throws a CircularReference if linking
+	 *     source to target would create one and returns the number of nodes visited
+	 *     to find out. It may re-order the nodes, as long as their order remains
+	 *     valid for the policy with the new link added.
+	 * \li \c linked(nodes, source, target) is called once the link is made
+	 * \li \c unlinked(nodes, source, target) is called once a link is removed
+	 * \li \c relinked(nodes) is called after several links were made or removed
+	 *     at once, and after erasing nodes. The nodes may not be in the order the
+	 *     policy keeps them in when several links were made.
+	 *
+	 * All of these must leave each node's position_ set to its index in the vector.
+	 * Policies that keep the nodes in topological order set \c topological to true;
+	 * the DAG computes a topological order when it needs one otherwise. */
+	namespace Ordering
+	{
+		/** Keep the nodes sorted by score, as the DAG always has.
+		 * A node's score is one more than the sum of the scores of the nodes linked
+		 * to it. Each link propagates the source's score through everything the
+		 * target reaches, after which the nodes are sorted by score, so making or
+		 * removing a link takes time proportional to the size of the DAG. */
+		struct Score
+		{
+			typedef unsigned long score_type;
+			static const bool topological = true;
+
+			template < typename Nodes, typename NodeType >
+			static void insert(Nodes &nodes, NodeType *node)
+			{
+				// a new node has the lowest possible score
+				nodes.insert(nodes.begin(), node);
+				Details::renumber(nodes, 0, nodes.size());
+			}
+
+			template < typename Nodes, typename NodeType >
+			static std::size_t check(Nodes &, NodeType *source, NodeType *target)
+			{
+				return Details::checkLink(source, target);
+			}
+
+			template < typename Nodes, typename NodeType >
+			static std::size_t linked(Nodes &nodes, NodeType *source, NodeType *target)
+			{
+				Propagation propagation(source->score_);
+				target->visit([](NodeType *node, Propagation *propagation){ node->score_ += propagation->score_; ++propagation->visits_; }, &propagation);
+				sort(nodes);
+
+				return propagation.visits_;
+			}
+
+			template < typename Nodes, typename NodeType >
+			static std::size_t unlinked(Nodes &nodes, NodeType *source, NodeType *target)
+			{
+				Propagation propagation(source->score_);
+				target->visit([](NodeType *node, Propagation *propagation){ node->score_ -= propagation->score_; ++propagation->visits_; }, &propagation);
+				sort(nodes);
+
+				return propagation.visits_;
+			}
+
+			/** Recompute all scores from scratch in a single pass over the DAG, which
+			 * is exactly what linked and unlinked maintain incrementally, and sort.
+			 * Several links may have been made since the nodes were last sorted, so
+			 * the pass is made in an order computed for the purpose. */
+			template < typename Nodes >
+			static void relinked(Nodes &nodes)
+			{
+				for (auto node : nodes)
+				{
+					node->score_ = 1;
+				}
+				Details::kahn(nodes, [](auto node){
+						for (auto target : node->targets_)
+						{
+							target->score_ += node->score_;
+						}
+					});
+				sort(nodes);
+			}
+
+		private :
+			/** \internal The data passed along when propagating a score through the DAG:
+			 * the score to propagate and a count of the nodes visited while doing so. */
+			struct Propagation
+			{
+				Propagation(score_type score)
+					: score_(score)
+					, visits_(0)
+				{ /* no-op */ }
+
+				score_type score_;
+				std::size_t visits_;
+			};
+
+			//! \internal Sort the nodes by score, putting the ones nothing links to first
+			template < typename Nodes >
+			static void sort(Nodes &nodes)
+			{
+				std::sort(nodes.begin(), nodes.end(), [](auto lhs, auto rhs){ return lhs->score_ < rhs->score_; });
+				Details::renumber(nodes, 0, nodes.size());
+			}
+		};
+
+		/** Keep the nodes in the order in which they were inserted.
+		 * Making a link only costs the check for a circular reference, and removing
+		 * one costs nothing more than removing it from the source. This is for DAGs
+		 * that are never iterated over in topological order: those parts of the DAG
+		 * that need one (levels and reduce) compute it when called. */
+		struct Insertion
+		{
+			typedef unsigned long score_type;
+			static const bool topological = false;
+
+			template < typename Nodes, typename NodeType >
+			static void insert(Nodes &nodes, NodeType *node)
+			{
+				nodes.push_back(node);
+				node->position_ = nodes.size() - 1;
+			}
+
+			template < typename Nodes, typename NodeType >
+			static std::size_t check(Nodes &, NodeType *source, NodeType *target)
+			{
+				return Details::checkLink(source, target);
+			}
+
+			template < typename Nodes, typename NodeType >
+			static std::size_t linked(Nodes &, NodeType *, NodeType *)
+			{
+				return 0;
+			}
+
+			template < typename Nodes, typename NodeType >
+			static std::size_t unlinked(Nodes &, NodeType *, NodeType *)
+			{
+				return 0;
+			}
+
+			template < typename Nodes >
+			static void relinked(Nodes &)
+			{ /* no-op */ }
+		};
+
+		/** Keep the nodes in topological order, maintaining that order incrementally.
+		 * This is the algorithm of Marchetti-Spaccamela, Nanni and Rohnert: a link
+		 * from a source to a target that already comes after it in the DAG's order
+		 * needs neither a check for a circular reference nor any re-ordering. Only
+		 * when the target comes first is everything the target reaches between the
+		 * two searched (which is where a circular reference would be found) and
+		 * moved after the source, in the same relative order. Removing a link never
+		 * invalidates a topological order, so it costs nothing more than removing
+		 * it from the source.
+		 *
+		 * Nodes are inserted at the end. The scores of the nodes are not maintained. */
+		struct Topological
+		{
+			typedef unsigned long score_type;
+			static const bool topological = true;
+
+			template < typename Nodes, typename NodeType >
+			static void insert(Nodes &nodes, NodeType *node)
+			{
+				nodes.push_back(node);
+				node->position_ = nodes.size() - 1;
+			}
+
+			template < typename Nodes, typename NodeType >
+			static std::size_t check(Nodes &nodes, NodeType *source, NodeType *target)
+			{
+				if (target->position_ > source->position_)
+					return 0;
+				else
+				{ /* the target and everything it reaches up to the source may have to move */ }
+				const std::size_t lower(target->position_);
+				const std::size_t upper(source->position_);
+				// everything the target reaches within [lower, upper]: nothing beyond
+				// the source can reach it, so that is where the search stops
+				std::vector< bool > reached(upper - lower + 1, false);
+				std::vector< NodeType* > stack(1, target);
+				reached[0] = true;
+				std::size_t visits(0);
+				while (!stack.empty())
+				{
+					NodeType *node(stack.back());
+					stack.pop_back();
+					++visits;
+					if (node == source)
+						throw CircularReference("Circular reference detected");
+					else
+					{ /* carry on */ }
+					for (auto next : node->targets_)
+					{
+						if (next->position_ <= upper && !reached[next->position_ - lower])
+						{
+							reached[next->position_ - lower] = true;
+							stack.push_back(next);
+						}
+						else
+						{ /* beyond the source, or already reached */ }
+					}
+				}
+				// move what was reached after what wasn't: positions are only updated afterwards
+				std::stable_partition(nodes.begin() + lower, nodes.begin() + upper + 1, [&reached, lower](NodeType *node){ return !reached[node->position_ - lower]; });
+				Details::renumber(nodes, lower, upper + 1);
+
+				return visits;
+			}
+
+			template < typename Nodes, typename NodeType >
+			static std::size_t linked(Nodes &, NodeType *, NodeType *)
+			{
+				return 0;
+			}
+
+			template < typename Nodes, typename NodeType >
+			static std::size_t unlinked(Nodes &, NodeType *, NodeType *)
+			{
+				return 0;
+			}
+
+			template < typename Nodes >
+			static void relinked(Nodes &)
+			{ /* no-op */ }
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,489 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file persistentdag.hpp A Directed Acyclic Graph of which copies share their structure (Depends::PersistentDAG). */
+#ifndef depends_persistentdag_hpp
+#define depends_persistentdag_hpp
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "details/persistentvector.hpp"
+#include "exceptions.hpp"
+
+namespace Depends
+{
+	/** A persistent, structurally shared, directed acyclic graph.
+	 * Like the DAG class, this is a collection of values linked together
+	 * without cycles, but copying a PersistentDAG - i.e. taking a snapshot of
+	 * it - takes constant time: the copy shares all of its structure with the
+	 * original. Modifying either one afterwards only copies the nodes that are
+	 * modified and the parts of the graph's internal tables that lead to them,
+	 * so every other snapshot remains unchanged, valid and queryable. This makes
+	 * it cheap to keep many versions of a graph around, e.g. to try out a few
+	 * "what-if" scenarios and drop the ones that didn't pan out.
+	 *
+	 * The nodes are kept in the order in which they were inserted, and found
+	 * through a hash table of which copies, too, share their structure. Unlike
+	 * the DAG class, a PersistentDAG does not keep its nodes sorted: order()
+	 * computes a topological order on demand.
+	 *
+	 * Different threads may use different snapshots at the same time, but any
+	 * one snapshot must not be read while it is being modified or copied.
+	 *
+	 * \param ValueType the type of whatever the DAG should be decorated with
+	 * \param Hash the hash function used to find values in the DAG
+	 * \param KeyEqual the predicate used to compare values in the DAG */
+	template < class ValueType, class Hash = std::hash< ValueType >, class KeyEqual = std::equal_to< ValueType > >
+	class PersistentDAG
+	{
+		//! \internal a node in the DAG, as stored: it is never modified once shared
+		struct Record
+		{
+			Record(const ValueType &value)
+				: value_(value)
+				, erased_(false)
+			{ /* no-op */ }
+
+			ValueType value_;
+			std::vector< std::size_t > targets_;
+			bool erased_;
+		};
+		typedef std::shared_ptr< const Record > RecordPointer;
+		typedef std::shared_ptr< const std::vector< std::size_t > > BucketPointer;
+
+	public :
+		typedef ValueType value_type;
+		typedef const ValueType & const_reference;
+		typedef const ValueType * const_pointer;
+		typedef std::size_t size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		/** This exception is thrown in case a new link creates a
+		 * circular reference */
+		typedef CircularReference circular_reference_exception;
+
+		//! forward iterator over the values in the DAG, in the order they were inserted
+		class const_iterator : public std::iterator< std::forward_iterator_tag, ValueType, std::ptrdiff_t, const ValueType *, const ValueType & >
+		{
+		public :
+			const_iterator()
+				: records_(0)
+				, index_(0)
+			{ /* no-op */ }
+
+			const ValueType & operator*() const { return (*records_)[index_]->value_; }
+			const ValueType * operator->() const { return &(*records_)[index_]->value_; }
+
+			bool operator==(const const_iterator &i) const { return index_ == i.index_; }
+			bool operator!=(const const_iterator &i) const { return index_ != i.index_; }
+
+			const_iterator & operator++() { ++index_; skipErased(); return *this; }
+			const_iterator operator++(int) { const_iterator tmp(*this); ++*this; return tmp; }
+
+		private :
+			const_iterator(const Details::PersistentVector< RecordPointer > *records, size_type index)
+				: records_(records)
+				, index_(index)
+			{
+				skipErased();
+			}
+
+			void skipErased()
+			{
+				while (index_ < records_->size() && (*records_)[index_]->erased_)
+				{
+					++index_;
+				}
+			}
+
+			const Details::PersistentVector< RecordPointer > *records_;
+			size_type index_;
+
+			friend class PersistentDAG;
+		};
+		typedef const_iterator iterator;
+
+		//! DefaultConstructible
+		PersistentDAG()
+			: size_(0)
+		{ /* no-op */ }
+
+		//! Construct a DAG from a range of values, without linking any of them
+		template < typename InputIterator >
+		PersistentDAG(InputIterator first, InputIterator last)
+			: size_(0)
+		{
+			insert(first, last);
+		}
+
+		/** Take a snapshot of the DAG, in constant time.
+		 * This is the same thing as copying it: a snapshot is a PersistentDAG in
+		 * its own right, and can be modified without affecting the original. */
+		PersistentDAG snapshot() const { return *this; }
+
+		//! get an iterator to the first value in the DAG
+		const_iterator begin() const { return const_iterator(&records_, 0); }
+		//! get an iterator one past the last value in the DAG
+		const_iterator end() const { return const_iterator(&records_, records_.size()); }
+
+		//! get the number of values in the DAG
+		size_type size() const { return size_; }
+		//! check whether the DAG is empty
+		bool empty() const { return size_ == 0; }
+		//! swap the contents of this DAG with another one
+		void swap(PersistentDAG &d)
+		{
+			std::swap(records_, d.records_);
+			std::swap(buckets_, d.buckets_);
+			std::swap(size_, d.size_);
+		}
+
+		//! find a value in the DAG, or return end()
+		const_iterator find(const value_type &value) const
+		{
+			return const_iterator(&records_, indexOf(value));
+		}
+		//! check whether the DAG contains a given value
+		bool contains(const value_type &value) const
+		{
+			return indexOf(value) != records_.size();
+		}
+
+		/** Insert a value in the DAG, without linking it to anything.
+		 * \return an iterator to the value and true if it was inserted, false if it was already there */
+		std::pair< const_iterator, bool > insert(const value_type &value)
+		{
+			size_type index(indexOf(value));
+			if (index != records_.size())
+				return std::make_pair(const_iterator(&records_, index), false);
+			else
+			{ /* insert it */ }
+			records_.push_back(std::make_shared< const Record >(value));
+			++size_;
+			if (size_ > buckets_.size())
+			{	// also puts the new record in its bucket
+				rehash(std::max< size_type >(16, buckets_.size() * 2));
+			}
+			else
+			{
+				addToBucket(index);
+			}
+
+			return std::make_pair(const_iterator(&records_, index), true);
+		}
+
+		//! Insert a range of values in the DAG, skipping anything that would be a duplicate
+		template < typename InputIterator >
+		void insert(InputIterator first, InputIterator last)
+		{
+			for (; first != last; ++first)
+			{
+				insert(*first);
+			}
+		}
+
+		/** Link two values together.
+		 * \pre both values must already be in the DAG
+		 * \return false if the values were already linked directly, true otherwise
+		 * \throws std::invalid_argument if either value is not in the DAG
+		 * \throws circular_reference_exception if the link would create a circular reference */
+		bool link(const value_type &source, const value_type &target)
+		{
+			size_type source_index(indexOf(source));
+			size_type target_index(indexOf(target));
+			if (source_index == records_.size() || target_index == records_.size())
+				throw std::invalid_argument("value not found");
+			else
+			{ /* both values found */ }
+			const std::vector< size_type > &targets(records_[source_index]->targets_);
+			if (std::find(targets.begin(), targets.end(), target_index) != targets.end())
+				return false;
+			else
+			{ /* not linked yet */ }
+			if (source_index == target_index || reaches(target_index, source_index))
+				throw CircularReference("Circular reference detected");
+			else
+			{ /* all is well */ }
+
+			std::shared_ptr< Record > record(std::make_shared< Record >(*records_[source_index]));
+			record->targets_.push_back(target_index);
+			records_.set(source_index, record);
+
+			return true;
+		}
+
+		//! check whether there is a path from source to target
+		bool linked(const value_type &source, const value_type &target) const
+		{
+			size_type source_index(indexOf(source));
+			size_type target_index(indexOf(target));
+			if (source_index == records_.size() || target_index == records_.size())
+				return false;
+			else
+			{ /* both values found */ }
+
+			return reaches(source_index, target_index);
+		}
+
+		/** unlink source from target if they are linked directly
+		 * \throws std::invalid_argument if either value is not in the DAG */
+		bool unlink(const value_type &source, const value_type &target)
+		{
+			size_type source_index(indexOf(source));
+			size_type target_index(indexOf(target));
+			if (source_index == records_.size() || target_index == records_.size())
+				throw std::invalid_argument("value not found");
+			else
+			{ /* both values found */ }
+			const std::vector< size_type > &targets(records_[source_index]->targets_);
+			typename std::vector< size_type >::const_iterator where(std::find(targets.begin(), targets.end(), target_index));
+			if (where == targets.end())
+				return false;
+			else
+			{ /* remove the link */ }
+
+			std::shared_ptr< Record > record(std::make_shared< Record >(*records_[source_index]));
+			record->targets_.erase(record->targets_.begin() + (where - targets.begin()));
+			records_.set(source_index, record);
+
+			return true;
+		}
+
+		/** Erase a value from the DAG, unlinking it from everything it was linked with.
+		 * This takes time proportional to the size of the DAG, as anything may link to the value.
+		 * \return the number of values erased (0 or 1) */
+		size_type erase(const value_type &value)
+		{
+			size_type index(indexOf(value));
+			if (index == records_.size())
+				return 0;
+			else
+			{ /* erase it */ }
+
+			for (size_type which(0); which < records_.size(); ++which)
+			{
+				const std::vector< size_type > &targets(records_[which]->targets_);
+				if (std::find(targets.begin(), targets.end(), index) != targets.end())
+				{
+					std::shared_ptr< Record > record(std::make_shared< Record >(*records_[which]));
+					record->targets_.erase(std::remove(record->targets_.begin(), record->targets_.end(), index), record->targets_.end());
+					records_.set(which, record);
+				}
+				else
+				{ /* not linked to the erased value */ }
+			}
+			std::shared_ptr< Record > record(std::make_shared< Record >(records_[index]->value_));
+			record->erased_ = true;
+			records_.set(index, record);
+			removeFromBucket(index);
+			--size_;
+
+			return 1;
+		}
+
+		/** Get the values a given value is linked to.
+		 * \param value the value to get the targets of
+		 * \param all if true, get everything reachable from the value rather than only its direct targets */
+		std::vector< value_type > getTargets(const value_type &value, bool all = false) const
+		{
+			std::vector< value_type > retval;
+			size_type index(indexOf(value));
+			if (index == records_.size())
+				return retval;
+			else
+			{ /* value found */ }
+			if (all)
+			{
+				std::vector< bool > visited(records_.size(), false);
+				std::vector< size_type > stack(records_[index]->targets_);
+				while (!stack.empty())
+				{
+					size_type which(stack.back());
+					stack.pop_back();
+					if (!visited[which])
+					{
+						visited[which] = true;
+						const Record &record(*records_[which]);
+						retval.push_back(record.value_);
+						stack.insert(stack.end(), record.targets_.begin(), record.targets_.end());
+					}
+					else
+					{ /* already found through another path */ }
+				}
+			}
+			else
+			{
+				for (auto target : records_[index]->targets_)
+				{
+					retval.push_back(records_[target]->value_);
+				}
+			}
+
+			return retval;
+		}
+
+		/** Get the values of the DAG in topological order.
+		 * Every value comes after all the values linked to it, just like in the
+		 * DAG class. This takes time proportional to the size of the DAG.
+		 * \return pointers to the values, which remain valid as long as this snapshot does */
+		std::vector< const_pointer > order() const
+		{
+			std::vector< size_type > in_degrees(records_.size(), 0);
+			for (size_type which(0); which < records_.size(); ++which)
+			{
+				for (auto target : records_[which]->targets_)
+				{
+					++in_degrees[target];
+				}
+			}
+			std::vector< size_type > ready;
+			for (size_type which(0); which < records_.size(); ++which)
+			{
+				if (in_degrees[which] == 0 && !records_[which]->erased_)
+					ready.push_back(which);
+				else
+				{ /* not ready yet, or not there at all */ }
+			}
+			std::vector< const_pointer > retval;
+			retval.reserve(size_);
+			for (size_type next(0); next < ready.size(); ++next)
+			{
+				const Record &record(*records_[ready[next]]);
+				retval.push_back(&record.value_);
+				for (auto target : record.targets_)
+				{
+					if (--in_degrees[target] == 0)
+						ready.push_back(target);
+					else
+					{ /* still linked to from elsewhere */ }
+				}
+			}
+
+			return retval;
+		}
+
+	private :
+		//! \internal find the index of the given value, or the number of records if it isn't there
+		size_type indexOf(const value_type &value) const
+		{
+			if (buckets_.empty())
+				return records_.size();
+			else
+			{ /* look in the value's bucket */ }
+			const std::vector< size_type > &bucket(*buckets_[Hash()(value) & (buckets_.size() - 1)]);
+			for (auto index : bucket)
+			{
+				if (KeyEqual()(records_[index]->value_, value))
+					return index;
+				else
+				{ /* keep looking */ }
+			}
+
+			return records_.size();
+		}
+
+		//! \internal check whether there's a path from one node to another
+		bool reaches(size_type source, size_type target) const
+		{
+			std::vector< bool > visited(records_.size(), false);
+			std::vector< size_type > stack(1, source);
+			while (!stack.empty())
+			{
+				size_type which(stack.back());
+				stack.pop_back();
+				if (which == target)
+					return true;
+				else if (!visited[which])
+				{
+					visited[which] = true;
+					const std::vector< size_type > &targets(records_[which]->targets_);
+					stack.insert(stack.end(), targets.begin(), targets.end());
+				}
+				else
+				{ /* already been here */ }
+			}
+
+			return false;
+		}
+
+		//! \internal rebuild the hash table with the given number of buckets, which must be a power of two
+		void rehash(size_type bucket_count)
+		{
+			std::vector< std::vector< size_type > > buckets(bucket_count);
+			for (size_type index(0); index < records_.size(); ++index)
+			{
+				if (!records_[index]->erased_)
+					buckets[Hash()(records_[index]->value_) & (bucket_count - 1)].push_back(index);
+				else
+				{ /* not in the table */ }
+			}
+			buckets_ = Details::PersistentVector< BucketPointer >();
+			for (auto &bucket : buckets)
+			{
+				buckets_.push_back(std::make_shared< const std::vector< size_type > >(std::move(bucket)));
+			}
+		}
+
+		//! \internal add the value at the given index to the hash table
+		void addToBucket(size_type index)
+		{
+			size_type which(Hash()(records_[index]->value_) & (buckets_.size() - 1));
+			std::shared_ptr< std::vector< size_type > > bucket(std::make_shared< std::vector< size_type > >(*buckets_[which]));
+			bucket->push_back(index);
+			buckets_.set(which, bucket);
+		}
+
+		//! \internal remove the value at the given index from the hash table
+		void removeFromBucket(size_type index)
+		{
+			size_type which(Hash()(records_[index]->value_) & (buckets_.size() - 1));
+			std::shared_ptr< std::vector< size_type > > bucket(std::make_shared< std::vector< size_type > >(*buckets_[which]));
+			bucket->erase(std::remove(bucket->begin(), bucket->end(), index), bucket->end());
+			buckets_.set(which, bucket);
+		}
+
+		/** \internal All nodes ever inserted, indexed in insertion order. Erased
+		 * nodes are kept (marked as such) so the indices of the others never change. */
+		Details::PersistentVector< RecordPointer > records_;
+		//! \internal The hash table, of which the number of buckets is a power of two
+		Details::PersistentVector< BucketPointer > buckets_;
+		size_type size_;
+	};
+}
+
+#endif
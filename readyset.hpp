@@ -0,0 +1,333 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file readyset.hpp A tracker of the values of a Depends::Depends that are ready to be processed (Depends::ReadySet). */
+#ifndef depends_readyset_hpp
+#define depends_readyset_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "depends.hpp"
+
+namespace Depends
+{
+	/** Tracks which values of a dependency tracker are ready to be processed, as values are done.
+	 * A value is ready once all of its prerequisites are done. The ready set keeps
+	 * a count of the prerequisites of each value that aren't done yet: marking a
+	 * value done (\see markDone) only decrements the counts of its direct dependants,
+	 * and those that drop to zero become ready, so each value and each dependency
+	 * is looked at only once during a whole run.
+	 *
+	 * The ready values are kept in a heap. Without a priority, the values are
+	 * handed out in the order in which they became ready. With a priority, the
+	 * ready value with the highest priority is handed out first: either a weight
+	 * given for each value, or the length of the value's critical path - the
+	 * largest total weight of a chain of dependants starting at the value - which
+	 * is what lets the longest chains start first.
+	 *
+	 * The ready set takes a snapshot of the dependencies when it is constructed:
+	 * changes to the tracker made after that are not taken into account. The
+	 * values must remain in the tracker as long as the ready set is used.
+	 *
+	 * \param ValueType the type of the values in the tracker
+	 * \param Compare the tracker's predicate */
+	template < typename ValueType, typename Compare = std::less< ValueType > >
+	class ReadySet
+	{
+	public :
+		typedef Depends< ValueType, Compare > depends_type;
+		typedef typename depends_type::const_iterator const_iterator;
+		typedef typename depends_type::value_type value_type;
+		typedef std::size_t size_type;
+
+		//! How the ready values are prioritized, when they have a weight
+		enum Priority {
+			  BY_WEIGHT			//!< the weight of the value itself
+			, BY_CRITICAL_PATH	//!< the total weight of the heaviest chain of dependants starting at the value
+		};
+
+		/** Construct a ready set for the given tracker, handing out values in the order in which they become ready.
+		 * This takes time proportional to the number of dependencies times the logarithm of the number of values. */
+		explicit ReadySet(depends_type const &depends)
+		{
+			build(depends);
+			std::vector< double > priorities(values_.size(), 0);
+			start(priorities);
+		}
+		/** Construct a ready set for the given tracker, handing out the ready values with the highest priority first.
+		 * \param depends the tracker
+		 * \param weight a function that returns the weight, as a double, of a value
+		 * \param priority whether the priority of a value is its weight or the length of its critical path */
+		template < typename Weight >
+		ReadySet(depends_type const &depends, Weight weight, Priority priority = BY_WEIGHT)
+		{
+			build(depends);
+			std::vector< double > priorities(values_.size());
+			for (size_type which(0); which < values_.size(); ++which)
+			{
+				priorities[which] = weight(*values_[which]);
+			}
+			if (priority == BY_CRITICAL_PATH)
+			{
+				// in reverse topological order, each value's dependants are done before it
+				std::vector< size_type > order(topologicalOrder());
+				for (auto which(order.rbegin()); which != order.rend(); ++which)
+				{
+					double longest(0);
+					for (size_type dependant(offsets_[*which]); dependant < offsets_[*which + 1]; ++dependant)
+					{
+						longest = std::max(longest, priorities[dependants_[dependant]]);
+					}
+					priorities[*which] += longest;
+				}
+			}
+			else
+			{ /* the weights are the priorities */ }
+			start(priorities);
+		}
+
+		//! Check whether no values are ready
+		bool empty() const
+		{
+			discard();
+			return heap_.empty();
+		}
+		//! Get the number of values that are ready
+		size_type ready() const { return ready_; }
+		//! Get the number of values that aren't done yet
+		size_type remaining() const { return remaining_; }
+
+		/** Get the ready value that is next in line, in constant (amortized) time.
+		 * \pre !empty() */
+		const_iterator top() const
+		{
+			discard();
+			return values_[heap_.front().value_];
+		}
+		/** Take the ready value that is next in line out of the ready set.
+		 * The value is no longer ready, but it isn't done either until it is marked done.
+		 * \pre !empty() */
+		const_iterator pop()
+		{
+			discard();
+			const size_type which(heap_.front().value_);
+			std::pop_heap(heap_.begin(), heap_.end());
+			heap_.pop_back();
+			states_[which] = TAKEN;
+			--ready_;
+
+			return values_[which];
+		}
+
+		/** Mark a value as done, making the dependants that were only waiting for it ready.
+		 * The value must be ready, or have been taken out of the ready set by pop.
+		 * \throws std::invalid_argument if the value isn't in the ready set's snapshot of the tracker
+		 * \throws std::logic_error if the value isn't ready or is already done */
+		void markDone(const_iterator where)
+		{
+			const size_type which(indexOf(where));
+			switch (states_[which])
+			{
+			case WAITING :
+				throw std::logic_error("Value is not ready");
+			case DONE :
+				throw std::logic_error("Value is already done");
+			case READY :
+				// its entry in the heap is discarded when it comes up
+				--ready_;
+				break;
+			case TAKEN :
+				break;
+			}
+			states_[which] = DONE;
+			--remaining_;
+			for (size_type dependant(offsets_[which]); dependant < offsets_[which + 1]; ++dependant)
+			{
+				if (!--counts_[dependants_[dependant]])
+					makeReady(dependants_[dependant]);
+				else
+				{ /* still waiting for something else */ }
+			}
+		}
+		/** Mark a value as done.
+		 * \see markDone(const_iterator) */
+		void markDone(value_type const &value)
+		{
+			markDone(depends_->find(value));
+		}
+
+		//! Check whether a value is ready
+		bool isReady(const_iterator where) const { return states_[indexOf(where)] == READY; }
+		//! Check whether a value is done
+		bool isDone(const_iterator where) const { return states_[indexOf(where)] == DONE; }
+
+	private :
+		enum State { WAITING, READY, TAKEN, DONE };
+
+		//! \internal An entry in the heap of ready values
+		struct Entry
+		{
+			double priority_;
+			//! the order in which the value became ready, which breaks ties
+			size_type sequence_;
+			size_type value_;
+
+			bool operator<(Entry const &other) const
+			{
+				return priority_ < other.priority_ || (priority_ == other.priority_ && sequence_ > other.sequence_);
+			}
+		};
+
+		//! \internal Number the values and take the snapshot of the dependencies, in compressed rows
+		void build(depends_type const &depends)
+		{
+			depends_ = &depends;
+			for (const_iterator which(depends.begin()); which != depends.end(); ++which)
+			{
+				indices_.insert(std::make_pair(&*which, values_.size()));
+				values_.push_back(which);
+			}
+			counts_.resize(values_.size(), 0);
+			offsets_.reserve(values_.size() + 1);
+			offsets_.push_back(0);
+			for (auto which : values_)
+			{
+				for (auto const &dependant : depends.getDependants(which))
+				{
+					const size_type index(indexOf(depends.find(dependant)));
+					dependants_.push_back(index);
+					++counts_[index];
+				}
+				offsets_.push_back(dependants_.size());
+			}
+		}
+
+		//! \internal Make the values without prerequisites ready
+		void start(std::vector< double > const &priorities)
+		{
+			priorities_ = priorities;
+			states_.resize(values_.size(), WAITING);
+			sequence_ = 0;
+			ready_ = 0;
+			remaining_ = values_.size();
+			for (size_type which(0); which < values_.size(); ++which)
+			{
+				if (!counts_[which])
+					makeReady(which);
+				else
+				{ /* has prerequisites */ }
+			}
+		}
+
+		//! \internal Get the values' indices in topological order, using Kahn's algorithm
+		std::vector< size_type > topologicalOrder() const
+		{
+			std::vector< size_type > counts(counts_);
+			std::vector< size_type > order;
+			order.reserve(values_.size());
+			for (size_type which(0); which < values_.size(); ++which)
+			{
+				if (!counts[which])
+					order.push_back(which);
+				else
+				{ /* not ready yet */ }
+			}
+			for (size_type next(0); next < order.size(); ++next)
+			{
+				for (size_type dependant(offsets_[order[next]]); dependant < offsets_[order[next] + 1]; ++dependant)
+				{
+					if (!--counts[dependants_[dependant]])
+						order.push_back(dependants_[dependant]);
+					else
+					{ /* something else still comes first */ }
+				}
+			}
+
+			return order;
+		}
+
+		void makeReady(size_type which)
+		{
+			states_[which] = READY;
+			++ready_;
+			Entry entry = { priorities_[which], sequence_++, which };
+			heap_.push_back(entry);
+			std::push_heap(heap_.begin(), heap_.end());
+		}
+
+		//! \internal Discard the entries at the top of the heap of values that were marked done while they were ready
+		void discard() const
+		{
+			while (!heap_.empty() && states_[heap_.front().value_] != READY)
+			{
+				std::pop_heap(heap_.begin(), heap_.end());
+				heap_.pop_back();
+			}
+		}
+
+		size_type indexOf(const_iterator where) const
+		{
+			typename std::unordered_map< ValueType const*, size_type >::const_iterator found(where == depends_->end() ? indices_.end() : indices_.find(&*where));
+			if (found == indices_.end())
+				throw std::invalid_argument("value not found");
+			else
+			{ /* found it */ }
+			return found->second;
+		}
+
+		depends_type const *depends_;
+		//! \internal The values, by index
+		std::vector< const_iterator > values_;
+		//! \internal The index of each value, by address
+		std::unordered_map< ValueType const*, size_type > indices_;
+		//! \internal Where the direct dependants of each value start in dependants_
+		std::vector< size_type > offsets_;
+		std::vector< size_type > dependants_;
+		//! \internal The number of prerequisites of each value that aren't done yet
+		std::vector< size_type > counts_;
+		std::vector< double > priorities_;
+		std::vector< State > states_;
+		mutable std::vector< Entry > heap_;
+		size_type sequence_;
+		size_type ready_;
+		size_type remaining_;
+	};
+}
+
+#endif
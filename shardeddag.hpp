@@ -0,0 +1,515 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file shardeddag.hpp A DAG partitioned into shards, for several writers at a time. */
+#ifndef depends_shardeddag_hpp
+#define depends_shardeddag_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "dag.hpp"
+
+namespace Depends
+{
+	/** A directed acyclic graph partitioned into shards, each with its own lock.
+	 * A DAG is meant to be used by one writer at a time, and every link it makes
+	 * may re-order all of its nodes. When many threads add subgraphs that are
+	 * mostly independent of each other (e.g. one per repository), a ShardedDAG
+	 * lets them do so without contending: each value belongs to one shard,
+	 * chosen by the Partition function, and each shard is a DAG of its own,
+	 * ordered independently of the others.
+	 *
+	 * Links between two values in the same shard are kept in that shard's DAG.
+	 * Links between values in different shards are kept in a boundary index.
+	 * Inserting, erasing, linking and unlinking values within a shard only locks
+	 * that shard, so writers to different shards never wait for each other,
+	 * except in one case: a new link within a shard that has links both coming
+	 * in from and going out to other shards might close a cycle through those
+	 * other shards, so it is checked the same way as a link between shards: by
+	 * locking all of the shards, in order, and looking for a path back from the
+	 * target to the source across the whole graph. Changes to the boundary index
+	 * are only ever made with all of the shards locked, so any one shard's lock
+	 * is enough to read it.
+	 *
+	 * A single topological order of the whole graph, in which the sources of
+	 * all links come before their targets, is produced on demand (\see order).
+	 *
+	 * \param ValueType the type of whatever the DAG should be decorated with
+	 * \param Hash the hash function used to find values in the DAG
+	 * \param KeyEqual the predicate used to compare values in the DAG
+	 * \param Partition the function that maps each value to its shard: values
+	 *        for which it returns the same number modulo the number of shards
+	 *        are in the same shard. Hashing the value, the default, spreads
+	 *        the values evenly, but doesn't keep subgraphs together. */
+	template < class ValueType, class Hash = std::hash< ValueType >, class KeyEqual = std::equal_to< ValueType >, class Partition = Hash >
+	class ShardedDAG
+	{
+	public :
+		typedef ValueType value_type;
+		typedef Hash hasher;
+		typedef KeyEqual key_equal;
+		typedef Partition partition_type;
+		typedef std::size_t size_type;
+		//! The DAG in each shard
+		typedef DAG< ValueType, Hash, KeyEqual > shard_type;
+
+		/** This exception is thrown in case a new link creates a
+		 * circular reference */
+		typedef CircularReference circular_reference_exception;
+
+		/** Construct an empty DAG with the given number of shards.
+		 * \param shards the number of shards, or 0 to use one per core */
+		explicit ShardedDAG(size_type shards = 0, Partition partition = Partition())
+			: partition_(partition)
+		{
+			if (!shards)
+				shards = std::max(std::thread::hardware_concurrency(), 1u);
+			else
+			{ /* use what we're asked to use */ }
+			shards_.reserve(shards);
+			for (size_type shard(0); shard < shards; ++shard)
+			{
+				shards_.emplace_back(new Shard);
+			}
+		}
+
+		ShardedDAG(const ShardedDAG &) = delete;
+		ShardedDAG & operator=(const ShardedDAG &) = delete;
+
+		//! Get the number of shards
+		size_type shards() const { return shards_.size(); }
+		//! Get the shard the given value belongs (or would belong) to
+		size_type shardOf(const value_type & val) const { return partition_(val) % shards_.size(); }
+
+		//! Get the number of values in all shards; this locks all of them
+		size_type size() const
+		{
+			Locks locks(lockAll());
+			size_type count(0);
+			for (auto const &shard : shards_)
+			{
+				count += shard->dag_.size();
+			}
+			return count;
+		}
+
+		//! Get the number of links between values in different shards; this locks all of them
+		size_type boundarySize() const
+		{
+			Locks locks(lockAll());
+			size_type count(0);
+			for (auto const &links : outgoing_)
+			{
+				count += links.second.size();
+			}
+			return count;
+		}
+
+		/** Insert a value, locking only its shard.
+		 * \return true if the value was inserted, false if it already was there */
+		bool insert(const value_type & val)
+		{
+			Shard &shard(*shards_[shardOf(val)]);
+			std::lock_guard< std::mutex > lock(shard.mutex_);
+			return shard.dag_.insert(val).second;
+		}
+
+		//! Check whether the given value is in the DAG, locking only its shard
+		bool contains(const value_type & val) const
+		{
+			Shard &shard(*shards_[shardOf(val)]);
+			std::lock_guard< std::mutex > lock(shard.mutex_);
+			return shard.dag_.find(val) != shard.dag_.end();
+		}
+
+		/** Erase a value, along with its links.
+		 * This locks only the value's shard, unless the value is linked to or
+		 * from another shard.
+		 * \return true if the value was erased, false if it wasn't there */
+		bool erase(const value_type & val)
+		{
+			Shard &shard(*shards_[shardOf(val)]);
+			{
+				std::lock_guard< std::mutex > lock(shard.mutex_);
+				if (!onBoundary(val))
+					return eraseFrom(shard, val);
+				else
+				{ /* the boundary index needs to change as well */ }
+			}
+			Locks locks(lockAll());
+			auto outgoing(outgoing_.find(val));
+			if (outgoing != outgoing_.end())
+			{
+				for (auto const &target : outgoing->second)
+				{
+					--shard.exits_;
+					--shards_[shardOf(target)]->entries_;
+					eraseFrom(incoming_, target, val);
+				}
+				outgoing_.erase(outgoing);
+			}
+			else
+			{ /* not linked to other shards */ }
+			auto incoming(incoming_.find(val));
+			if (incoming != incoming_.end())
+			{
+				for (auto const &source : incoming->second)
+				{
+					--shard.entries_;
+					--shards_[shardOf(source)]->exits_;
+					eraseFrom(outgoing_, source, val);
+				}
+				incoming_.erase(incoming);
+			}
+			else
+			{ /* not linked from other shards */ }
+			return eraseFrom(shard, val);
+		}
+
+		/** Link two values.
+		 * If both are in the same shard, this locks only that shard unless the
+		 * link might close a cycle through other shards.
+		 * \pre both values must already be in the DAG
+		 * \return false if the two were already linked directly, true otherwise
+		 * \throws std::invalid_argument if either value isn't in the DAG
+		 * \throws circular_reference_exception if the link would create a circular reference */
+		bool link(const value_type & source, const value_type & target)
+		{
+			size_type source_shard(shardOf(source));
+			size_type target_shard(shardOf(target));
+			if (source_shard == target_shard)
+			{
+				Shard &shard(*shards_[source_shard]);
+				std::lock_guard< std::mutex > lock(shard.mutex_);
+				if (!shard.entries_ || !shard.exits_)
+					return shard.dag_.link(source, target);
+				else
+				{ /* a path may leave the shard and come back: check the whole graph */ }
+			}
+			else
+			{ /* the link goes into the boundary index */ }
+
+			Locks locks(lockAll());
+			Shard &from(*shards_[source_shard]);
+			Shard &to(*shards_[target_shard]);
+			if (from.dag_.find(source) == from.dag_.end() || to.dag_.find(target) == to.dag_.end())
+				throw std::invalid_argument("value not found");
+			else
+			{ /* both are here */ }
+			if (source_shard == target_shard)
+			{
+				if (from.dag_.linked(source, target))
+					return from.dag_.link(source, target);
+				else
+				{ /* not implied, so the target may lead back to the source */ }
+			}
+			else
+			{
+				auto outgoing(outgoing_.find(source));
+				if (outgoing != outgoing_.end() && std::find_if(outgoing->second.begin(), outgoing->second.end(), [&](const value_type & linked){ return key_equal_(linked, target); }) != outgoing->second.end())
+					return false;
+				else
+				{ /* a new link */ }
+			}
+			if (reaches(target, source))
+				throw circular_reference_exception("Circular reference detected");
+			else
+			{ /* no cycle */ }
+			if (source_shard == target_shard)
+				return from.dag_.link(source, target);
+			else
+			{ /* add to the boundary index */ }
+			outgoing_[source].push_back(target);
+			try
+			{
+				incoming_[target].push_back(source);
+			}
+			catch (...)
+			{
+				eraseFrom(outgoing_, source, target);
+				throw;
+			}
+			++from.exits_;
+			++to.entries_;
+
+			return true;
+		}
+
+		/** Remove the direct link between two values.
+		 * If both are in the same shard, this locks only that shard.
+		 * \return true if the two were linked directly, false otherwise */
+		bool unlink(const value_type & source, const value_type & target)
+		{
+			size_type source_shard(shardOf(source));
+			size_type target_shard(shardOf(target));
+			if (source_shard == target_shard)
+			{
+				Shard &shard(*shards_[source_shard]);
+				std::lock_guard< std::mutex > lock(shard.mutex_);
+				if (shard.dag_.find(source) == shard.dag_.end() || shard.dag_.find(target) == shard.dag_.end())
+					return false;
+				else
+					return shard.dag_.unlink(source, target);
+			}
+			else
+			{ /* remove it from the boundary index */ }
+			Locks locks(lockAll());
+			if (!eraseFrom(outgoing_, source, target))
+				return false;
+			else
+			{ /* it was linked */ }
+			eraseFrom(incoming_, target, source);
+			--shards_[source_shard]->exits_;
+			--shards_[target_shard]->entries_;
+
+			return true;
+		}
+
+		/** Check whether the target can be reached from the source, through any shards.
+		 * This locks all of the shards.
+		 * \pre both values must already be in the DAG */
+		bool linked(const value_type & source, const value_type & target) const
+		{
+			Locks locks(lockAll());
+			return reaches(source, target);
+		}
+
+		/** Get all of the values in topological order: the source of every link comes before its target.
+		 * This locks all of the shards, and takes time proportional to the number
+		 * of values and links in the whole graph. Values that aren't linked to each
+		 * other come in the order of their shards, and in their shards' order. */
+		std::vector< value_type > order() const
+		{
+			Locks locks(lockAll());
+			std::unordered_map< const value_type*, size_type > incoming;
+			for (auto const &shard : shards_)
+			{
+				for (auto node(shard->dag_.begin()); node != shard->dag_.end(); ++node)
+				{
+					incoming.emplace(&*node, 0);
+					for (auto target : node.node()->targets_)
+					{
+						++incoming[&target->value_];
+					}
+				}
+			}
+			for (auto const &links : incoming_)
+			{
+				incoming[find(links.first)] += links.second.size();
+			}
+
+			std::deque< const value_type* > ready;
+			for (auto const &shard : shards_)
+			{
+				for (auto node(shard->dag_.begin()); node != shard->dag_.end(); ++node)
+				{
+					if (!incoming[&*node])
+						ready.push_back(&*node);
+					else
+					{ /* waits for its sources */ }
+				}
+			}
+			std::vector< value_type > retval;
+			retval.reserve(incoming.size());
+			while (!ready.empty())
+			{
+				const value_type *next(ready.front());
+				ready.pop_front();
+				retval.push_back(*next);
+				forEachTarget(next, [&](const value_type *target){
+					if (!--incoming[target])
+						ready.push_back(target);
+					else
+					{ /* still waiting for others */ }
+				});
+			}
+
+			return retval;
+		}
+
+	private :
+		//! \internal a shard: a DAG with its lock, and the number of links in and out of it
+		struct Shard
+		{
+			Shard()
+				: entries_(0)
+				, exits_(0)
+			{ /* no-op */ }
+
+			mutable std::mutex mutex_;
+			shard_type dag_;
+			//! the number of links from other shards to this one
+			size_type entries_;
+			//! the number of links from this shard to others
+			size_type exits_;
+		};
+
+		typedef std::vector< std::unique_lock< std::mutex > > Locks;
+		typedef std::unordered_map< value_type, std::vector< value_type >, Hash, KeyEqual > Boundary;
+
+		//! \internal lock all of the shards, always in the same order so two threads doing this can't deadlock
+		Locks lockAll() const
+		{
+			Locks locks;
+			locks.reserve(shards_.size());
+			for (auto const &shard : shards_)
+			{
+				locks.emplace_back(shard->mutex_);
+			}
+			return locks;
+		}
+
+		//! \internal check whether the value is linked to or from other shards; its shard must be locked
+		bool onBoundary(const value_type & val) const
+		{
+			return outgoing_.find(val) != outgoing_.end() || incoming_.find(val) != incoming_.end();
+		}
+
+		//! \internal erase a value from a shard; the shard must be locked
+		static bool eraseFrom(Shard &shard, const value_type & val)
+		{
+			auto where(shard.dag_.find(val));
+			if (where == shard.dag_.end())
+				return false;
+			else
+			{ /* found it */ }
+			shard.dag_.erase(where);
+			return true;
+		}
+
+		//! \internal remove a link from one side of the boundary index; all shards must be locked
+		bool eraseFrom(Boundary &boundary, const value_type & from, const value_type & to)
+		{
+			auto where(boundary.find(from));
+			if (where == boundary.end())
+				return false;
+			else
+			{ /* look for the link */ }
+			auto &links(where->second);
+			for (auto link(links.begin()); link != links.end(); ++link)
+			{
+				if (key_equal_(*link, to))
+				{
+					links.erase(link);
+					if (links.empty())
+						boundary.erase(where);
+					else
+					{ /* other links remain */ }
+					return true;
+				}
+				else
+				{ /* not this one */ }
+			}
+			return false;
+		}
+
+		//! \internal find a value in its shard; its shard must be locked
+		const value_type * find(const value_type & val) const
+		{
+			shard_type const &dag(shards_[shardOf(val)]->dag_);
+			auto where(dag.find(val));
+			return where == dag.end() ? nullptr : &*where;
+		}
+
+		//! \internal call f with every value the given one links to, in its shard and others; all shards must be locked
+		template < typename F >
+		void forEachTarget(const value_type *val, F f) const
+		{
+			shard_type const &dag(shards_[shardOf(*val)]->dag_);
+			for (auto target : dag.find(*val).node()->targets_)
+			{
+				f(&target->value_);
+			}
+			auto outgoing(outgoing_.find(*val));
+			if (outgoing != outgoing_.end())
+			{
+				for (auto const &target : outgoing->second)
+				{
+					f(find(target));
+				}
+			}
+			else
+			{ /* not linked to other shards */ }
+		}
+
+		//! \internal check whether there is a path from the source to the target, across shards; all shards must be locked
+		bool reaches(const value_type & source, const value_type & target) const
+		{
+			const value_type *from(find(source));
+			const value_type *to(find(target));
+			if (!from || !to)
+				throw std::invalid_argument("value not found");
+			else
+			{ /* both are here */ }
+			std::unordered_set< const value_type* > visited;
+			std::vector< const value_type* > pending(1, from);
+			visited.insert(from);
+			while (!pending.empty())
+			{
+				const value_type *next(pending.back());
+				pending.pop_back();
+				if (next == to)
+					return true;
+				else
+				{ /* keep looking */ }
+				forEachTarget(next, [&](const value_type *linked){
+					if (visited.insert(linked).second)
+						pending.push_back(linked);
+					else
+					{ /* been there */ }
+				});
+			}
+			return false;
+		}
+
+		Partition partition_;
+		KeyEqual key_equal_;
+		std::vector< std::unique_ptr< Shard > > shards_;
+		//! the links between shards, by source
+		Boundary outgoing_;
+		//! the links between shards, by target
+		Boundary incoming_;
+	};
+}
+
+#endif
@@ -0,0 +1,523 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file shareddag.hpp A frozen DAG in POSIX shared memory, for many processes to read at once. */
+#ifndef depends_shareddag_hpp
+#define depends_shareddag_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dag.hpp"
+#include "depends.hpp"
+#include "details/sharedmemory.hpp"
+
+namespace Depends
+{
+	/** A frozen copy of a DAG, or of the links in a Depends tracker, in POSIX shared memory.
+	 * When several processes on a host all need the same dependency graph, each of
+	 * them loading its own copy multiplies the memory it takes by the number of
+	 * processes. Instead, one process can publish the graph once, and every other
+	 * process can map it and query it, read-only, at the same time.
+	 *
+	 * A published graph can't be changed, but a new version of it can be published
+	 * under the same name. The name is that of a small header segment, holding the
+	 * current generation: each version is in a segment of its own, named after the
+	 * header and the generation (e.g. "/deps.3"). Publishing writes the new version
+	 * completely, then atomically stores its generation in the header, and finally
+	 * removes the name of the previous version: processes that still have that one
+	 * mapped keep it until they refresh, so they never see a version change under
+	 * them. Only one process should publish under a given name at a time.
+	 *
+	 * In a version's segment, the values are in topological order, followed by
+	 * the links from and to each of them in compressed rows: links are positions
+	 * in the array of values, not pointers, so the segment means the same thing
+	 * wherever it is mapped. Values are found through an open-addressing hash
+	 * table that is in the segment as well.
+	 *
+	 * \param ValueType the type of the values: as they are copied into shared
+	 *        memory as they are, this must be trivially copyable, and must not
+	 *        point anywhere
+	 * \param Hash the hash function used to find values. It must return the same
+	 *        value for the same value in every process (std::hash of an integer
+	 *        does)
+	 * \param KeyEqual the predicate used to compare values */
+	template < class ValueType, class Hash = std::hash< ValueType >, class KeyEqual = std::equal_to< ValueType > >
+	class SharedDAG
+	{
+		static_assert(std::is_trivially_copyable< ValueType >::value, "Values in shared memory must be trivially copyable");
+		static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The generation must be lock-free to be shared between processes");
+
+	public :
+		typedef ValueType value_type;
+		typedef Hash hasher;
+		typedef KeyEqual key_equal;
+		typedef const ValueType & const_reference;
+		typedef const ValueType * const_iterator;
+		typedef std::size_t size_type;
+		//! The position of a value in the topological order, which is what links are made of
+		typedef std::uint64_t index_type;
+
+		//! The links from or to a value: the positions of the values at their other ends
+		struct Links
+		{
+			const index_type * begin() const { return begin_; }
+			const index_type * end() const { return end_; }
+			size_type size() const { return end_ - begin_; }
+			bool empty() const { return begin_ == end_; }
+
+			const index_type *begin_;
+			const index_type *end_;
+		};
+
+		/** This exception is thrown when the graph to publish has a circular
+		 * reference (which can't happen for a DAG or a tracker) */
+		typedef CircularReference circular_reference_exception;
+
+		/** Map the current version of the graph published under the given name.
+		 * \param name the name of the header segment, which should start with a slash
+		 * \throws std::system_error if nothing can be mapped under that name
+		 * \throws std::runtime_error if what is there isn't a published graph */
+		explicit SharedDAG(const std::string & name)
+			: name_(name)
+			, header_(name, Details::SharedMemory::READ)
+			, image_(0)
+		{
+			if (header_.size() < sizeof(Header) || header()->magic_ != header_magic__)
+				throw std::runtime_error("not a shared DAG: " + name);
+			else
+			{ /* looks like ours */ }
+			map();
+		}
+
+		SharedDAG(SharedDAG && other)
+			: name_(std::move(other.name_))
+			, header_(std::move(other.header_))
+			, version_(std::move(other.version_))
+			, image_(other.image_)
+		{
+			other.image_ = 0;
+		}
+
+		SharedDAG & operator=(SharedDAG && other)
+		{
+			name_ = std::move(other.name_);
+			header_ = std::move(other.header_);
+			version_ = std::move(other.version_);
+			image_ = other.image_;
+			other.image_ = 0;
+			return *this;
+		}
+
+		//! Get the generation of the version that is mapped
+		std::uint64_t generation() const { return image_->generation_; }
+		//! Check whether a newer version has been published since this one was mapped
+		bool stale() const { return header()->generation_.load(std::memory_order_acquire) != image_->generation_; }
+		/** Map the current version, if a newer one has been published.
+		 * Any iterators and references to the version that was mapped become invalid.
+		 * \return true if a newer version was mapped */
+		bool refresh()
+		{
+			if (!stale())
+				return false;
+			else
+			{ /* map the new one */ }
+			map();
+			return true;
+		}
+
+		size_type size() const { return image_->size_; }
+		bool empty() const { return !image_->size_; }
+		//! Get the first value, in topological order
+		const_iterator begin() const { return values(); }
+		const_iterator end() const { return values() + image_->size_; }
+		const_reference operator[](index_type which) const { return values()[which]; }
+		//! Get the position of the value at the given iterator in the topological order
+		index_type index(const_iterator where) const { return where - values(); }
+
+		/** Find a value in constant time.
+		 * \return an iterator to the value, or end() if it isn't in the graph */
+		const_iterator find(const value_type & val) const
+		{
+			index_type const mask(image_->buckets_ - 1);
+			const index_type *buckets(array(image_->buckets_offset_));
+			for (index_type bucket(hasher()(val) & mask); buckets[bucket]; bucket = (bucket + 1) & mask)
+			{
+				if (key_equal()(values()[buckets[bucket] - 1], val))
+					return values() + buckets[bucket] - 1;
+				else
+				{ /* keep probing */ }
+			}
+			return end();
+		}
+
+		//! Get the values the value at the given iterator links to directly
+		Links targets(const_iterator where) const { return links(image_->target_rows_offset_, image_->targets_offset_, index(where)); }
+		//! Get the values that link directly to the value at the given iterator
+		Links sources(const_iterator where) const { return links(image_->source_rows_offset_, image_->sources_offset_, index(where)); }
+
+		/** Check whether the target can be reached from the source.
+		 * As the values are in topological order, this only looks at the values
+		 * between the two. A value is considered linked to itself, as it is by DAG::linked. */
+		bool linked(const_iterator source, const_iterator target) const
+		{
+			index_type from(index(source));
+			index_type to(index(target));
+			if (to == from)
+				return true;
+			else if (to < from)
+				return false;
+			else
+			{ /* look for a path */ }
+			std::vector< bool > visited(to - from, false);
+			std::vector< index_type > pending(1, from);
+			while (!pending.empty())
+			{
+				Links next(links(image_->target_rows_offset_, image_->targets_offset_, pending.back()));
+				pending.pop_back();
+				for (index_type linked : next)
+				{
+					if (linked == to)
+						return true;
+					else if (linked < to && !visited[linked - from])
+					{
+						visited[linked - from] = true;
+						pending.push_back(linked);
+					}
+					else
+					{ /* seen it, or past the target */ }
+				}
+			}
+			return false;
+		}
+
+		/** Publish a DAG under the given name, as a new version.
+		 * \return the generation of the new version
+		 * \throws std::system_error if the shared memory can't be created */
+		template < class DAGHash, class DAGKeyEqual, class OrderingPolicy, std::size_t InlineTargets >
+		static std::uint64_t publish(const std::string & name, const DAG< ValueType, DAGHash, DAGKeyEqual, OrderingPolicy, InlineTargets > & dag, mode_t permissions = 0644)
+		{
+			std::vector< const value_type* > values;
+			std::unordered_map< const value_type*, index_type > indexes;
+			values.reserve(dag.size());
+			for (auto const &val : dag)
+			{
+				indexes.emplace(&val, values.size());
+				values.push_back(&val);
+			}
+			std::vector< std::pair< index_type, index_type > > links;
+			for (auto node(dag.begin()); node != dag.end(); ++node)
+			{
+				for (auto target : node.node()->targets_)
+				{
+					links.emplace_back(indexes[&*node], indexes[&target->value_]);
+				}
+			}
+			return write(name, values, links, permissions);
+		}
+
+		/** Publish the links between the values in a tracker, from each prerequisite to its dependants, as a new version.
+		 * \see publish(const std::string &, const DAG &) */
+		template < class Compare >
+		static std::uint64_t publish(const std::string & name, const Depends< ValueType, Compare > & depends, mode_t permissions = 0644)
+		{
+			std::vector< const value_type* > values;
+			std::unordered_map< const value_type*, index_type > indexes;
+			values.reserve(depends.size());
+			for (auto const &val : depends)
+			{
+				indexes.emplace(&val, values.size());
+				values.push_back(&val);
+			}
+			std::vector< std::pair< index_type, index_type > > links;
+			for (auto prerequisite(depends.begin()); prerequisite != depends.end(); ++prerequisite)
+			{
+				for (auto const &dependant : depends.getDependants(prerequisite))
+				{
+					links.emplace_back(indexes[&*prerequisite], indexes[&*depends.find(dependant)]);
+				}
+			}
+			return write(name, values, links, permissions);
+		}
+
+		/** Remove the graph published under the given name.
+		 * Processes that have it mapped keep the version they have until they let go of it. */
+		static void remove(const std::string & name)
+		{
+			try
+			{
+				Details::SharedMemory header(name, Details::SharedMemory::READ);
+				if (header.size() >= sizeof(Header) && static_cast< const Header* >(header.address())->magic_ == header_magic__)
+					Details::SharedMemory::unlink(versionName(name, static_cast< const Header* >(header.address())->generation_.load(std::memory_order_acquire)));
+				else
+				{ /* nothing of ours */ }
+			}
+			catch (const std::system_error &)
+			{ /* nothing to remove */ }
+			Details::SharedMemory::unlink(name);
+		}
+
+	private :
+		enum : std::uint64_t {
+			  header_magic__ = 0x4465706e64484452ull	// "DepndHDR"
+			, image_magic__ = 0x4465706e64494d47ull		// "DepndIMG"
+			};
+
+		//! \internal the header segment, which tells us which version is current
+		struct Header
+		{
+			std::uint64_t magic_;
+			std::atomic< std::uint64_t > generation_;
+		};
+
+		//! \internal the start of a version's segment; the offsets are from the start of the segment
+		struct Image
+		{
+			std::uint64_t magic_;
+			std::uint64_t generation_;
+			std::uint64_t size_;
+			std::uint64_t links_;
+			std::uint64_t buckets_;
+			std::uint64_t values_offset_;
+			std::uint64_t target_rows_offset_;
+			std::uint64_t targets_offset_;
+			std::uint64_t source_rows_offset_;
+			std::uint64_t sources_offset_;
+			std::uint64_t buckets_offset_;
+			std::uint64_t bytes_;
+		};
+
+		SharedDAG(const SharedDAG &) = delete;
+		SharedDAG & operator=(const SharedDAG &) = delete;
+
+		static std::string versionName(const std::string & name, std::uint64_t generation) { return name + '.' + std::to_string(generation); }
+		static std::uint64_t align(std::uint64_t offset, std::uint64_t alignment) { return (offset + alignment - 1) / alignment * alignment; }
+
+		const Header * header() const { return static_cast< const Header* >(header_.address()); }
+		const value_type * values() const { return reinterpret_cast< const value_type* >(reinterpret_cast< const char* >(image_) + image_->values_offset_); }
+		const index_type * array(std::uint64_t offset) const { return reinterpret_cast< const index_type* >(reinterpret_cast< const char* >(image_) + offset); }
+		Links links(std::uint64_t rows_offset, std::uint64_t links_offset, index_type which) const
+		{
+			const index_type *rows(array(rows_offset));
+			Links retval = { array(links_offset) + rows[which], array(links_offset) + rows[which + 1] };
+			return retval;
+		}
+
+		//! \internal map the current version; the publisher may replace it while we try, so keep trying
+		void map()
+		{
+			for (;;)
+			{
+				std::uint64_t generation(header()->generation_.load(std::memory_order_acquire));
+				if (!generation)
+					throw std::runtime_error("nothing published yet: " + name_);
+				else
+				{ /* there is something to map */ }
+				try
+				{
+					Details::SharedMemory version(versionName(name_, generation), Details::SharedMemory::READ);
+					const Image *image(static_cast< const Image* >(version.address()));
+					if (version.size() < sizeof(Image) || image->magic_ != image_magic__ || image->generation_ != generation || image->bytes_ > version.size())
+						throw std::runtime_error("not a shared DAG: " + versionName(name_, generation));
+					else
+					{ /* got it */ }
+					version_ = std::move(version);
+					image_ = image;
+					return;
+				}
+				catch (const std::system_error &e)
+				{
+					if (e.code() != std::errc::no_such_file_or_directory || header()->generation_.load(std::memory_order_acquire) == generation)
+						throw;
+					else
+					{ /* replaced by a newer version while we were looking: try again */ }
+				}
+			}
+		}
+
+		//! \internal write a new version, with the values in topological order, and make it current
+		static std::uint64_t write(const std::string & name, std::vector< const value_type* > const &values, std::vector< std::pair< index_type, index_type > > const &links, mode_t permissions)
+		{
+			size_type const size(values.size());
+			// sort the values with Kahn's algorithm, in case they aren't sorted yet
+			std::vector< index_type > out_rows(size + 1, 0);
+			std::vector< index_type > in_rows(size + 1, 0);
+			for (auto const &link : links)
+			{
+				++out_rows[link.first + 1];
+				++in_rows[link.second + 1];
+			}
+			std::partial_sum(out_rows.begin(), out_rows.end(), out_rows.begin());
+			std::partial_sum(in_rows.begin(), in_rows.end(), in_rows.begin());
+			std::vector< index_type > out(links.size());
+			std::vector< index_type > cursors(out_rows.begin(), out_rows.end() - 1);
+			for (auto const &link : links)
+			{
+				out[cursors[link.first]++] = link.second;
+			}
+			std::vector< index_type > incoming(size);
+			std::vector< index_type > order;
+			order.reserve(size);
+			for (index_type which(0); which < size; ++which)
+			{
+				incoming[which] = in_rows[which + 1] - in_rows[which];
+				if (!incoming[which])
+					order.push_back(which);
+				else
+				{ /* waits for its sources */ }
+			}
+			for (size_type next(0); next < order.size(); ++next)
+			{
+				for (index_type link(out_rows[order[next]]); link < out_rows[order[next] + 1]; ++link)
+				{
+					if (!--incoming[out[link]])
+						order.push_back(out[link]);
+					else
+					{ /* still waiting */ }
+				}
+			}
+			if (order.size() != size)
+				throw circular_reference_exception("Circular reference detected");
+			else
+			{ /* sorted */ }
+			std::vector< index_type > position(size);
+			for (index_type which(0); which < size; ++which)
+			{
+				position[order[which]] = which;
+			}
+
+			// lay out the segment
+			index_type buckets(1);
+			while (buckets < size * 2)
+			{
+				buckets *= 2;
+			}
+			Image image;
+			image.magic_ = image_magic__;
+			image.size_ = size;
+			image.links_ = links.size();
+			image.buckets_ = buckets;
+			image.values_offset_ = align(sizeof(Image), alignof(value_type));
+			image.target_rows_offset_ = align(image.values_offset_ + size * sizeof(value_type), alignof(index_type));
+			image.targets_offset_ = image.target_rows_offset_ + (size + 1) * sizeof(index_type);
+			image.source_rows_offset_ = image.targets_offset_ + links.size() * sizeof(index_type);
+			image.sources_offset_ = image.source_rows_offset_ + (size + 1) * sizeof(index_type);
+			image.buckets_offset_ = image.sources_offset_ + links.size() * sizeof(index_type);
+			image.bytes_ = image.buckets_offset_ + buckets * sizeof(index_type);
+
+			Details::SharedMemory header(name, Details::SharedMemory::OPEN_OR_CREATE, sizeof(Header), permissions);
+			Header *head(static_cast< Header* >(header.address()));
+			if (head->magic_ != header_magic__)
+			{
+				new (head) Header;
+				head->generation_.store(0, std::memory_order_relaxed);
+				head->magic_ = header_magic__;
+			}
+			else
+			{ /* already set up */ }
+			std::uint64_t const previous(head->generation_.load(std::memory_order_acquire));
+			image.generation_ = previous + 1;
+			std::string const version_name(versionName(name, image.generation_));
+			// a publisher may have died before making this version current
+			Details::SharedMemory::unlink(version_name);
+			Details::SharedMemory version(version_name, Details::SharedMemory::CREATE, image.bytes_, permissions);
+			char *base(static_cast< char* >(version.address()));
+			std::memcpy(base, &image, sizeof(Image));
+			value_type *copies(reinterpret_cast< value_type* >(base + image.values_offset_));
+			for (index_type which(0); which < size; ++which)
+			{
+				new (copies + which) value_type(*values[order[which]]);
+			}
+			fill(reinterpret_cast< index_type* >(base + image.target_rows_offset_), reinterpret_cast< index_type* >(base + image.targets_offset_), order, position, out_rows, out);
+			std::vector< index_type > in(links.size());
+			std::copy(in_rows.begin(), in_rows.end() - 1, cursors.begin());
+			for (auto const &link : links)
+			{
+				in[cursors[link.second]++] = link.first;
+			}
+			fill(reinterpret_cast< index_type* >(base + image.source_rows_offset_), reinterpret_cast< index_type* >(base + image.sources_offset_), order, position, in_rows, in);
+			index_type *bucket_array(reinterpret_cast< index_type* >(base + image.buckets_offset_));
+			std::fill(bucket_array, bucket_array + buckets, 0);
+			for (index_type which(0); which < size; ++which)
+			{
+				index_type bucket(hasher()(copies[which]) & (buckets - 1));
+				while (bucket_array[bucket])
+				{
+					bucket = (bucket + 1) & (buckets - 1);
+				}
+				bucket_array[bucket] = which + 1;
+			}
+
+			head->generation_.store(image.generation_, std::memory_order_release);
+			if (previous)
+				Details::SharedMemory::unlink(versionName(name, previous));
+			else
+			{ /* first version */ }
+
+			return image.generation_;
+		}
+
+		//! \internal write links in compressed rows, renumbered to the topological order
+		static void fill(index_type *rows, index_type *links, std::vector< index_type > const &order, std::vector< index_type > const &position, std::vector< index_type > const &original_rows, std::vector< index_type > const &original_links)
+		{
+			index_type offset(0);
+			for (index_type which(0); which < order.size(); ++which)
+			{
+				rows[which] = offset;
+				for (index_type link(original_rows[order[which]]); link < original_rows[order[which] + 1]; ++link)
+				{
+					links[offset++] = position[original_links[link]];
+				}
+			}
+			rows[order.size()] = offset;
+		}
+
+		std::string name_;
+		Details::SharedMemory header_;
+		Details::SharedMemory version_;
+		const Image *image_;
+	};
+}
+
+#endif
@@ -0,0 +1,171 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file staticdag.hpp Dependency graphs that are declared, and ordered, at compile time. */
+#ifndef depends_staticdag_hpp
+#define depends_staticdag_hpp
+
+#include <cstddef>
+#include <stdexcept>
+#include "exceptions.hpp"
+
+namespace Depends
+{
+	/** A link in a graph declared at compile time: the source comes before the target.
+	 * The nodes are numbered from 0, so they can be the values of an enumeration. */
+	struct StaticLink
+	{
+		std::size_t source_;
+		std::size_t target_;
+	};
+
+	/** The topological order of a graph declared at compile time (\see staticOrder).
+	 * This is a plain array of the node numbers, in order, that can be iterated over
+	 * at run time without constructing anything. */
+	template < std::size_t N >
+	struct StaticOrder
+	{
+		typedef std::size_t value_type;
+		typedef std::size_t size_type;
+		typedef std::size_t const * const_iterator;
+
+		constexpr size_type size() const { return N; }
+		constexpr std::size_t operator[](size_type which) const { return nodes_[which]; }
+		constexpr const_iterator begin() const { return nodes_; }
+		constexpr const_iterator end() const { return nodes_ + N; }
+
+		//! Get the position of the given node in the order
+		constexpr size_type position(std::size_t node) const
+		{
+			size_type which(0);
+			while (which < N && nodes_[which] != node)
+			{
+				++which;
+			}
+			return which;
+		}
+
+		std::size_t nodes_[N];
+	};
+
+	/** Compute the topological order of a graph with N nodes and the given links.
+	 * When this initializes a constexpr variable, the order is computed by the
+	 * compiler: a circular reference, or a link to or from a node that doesn't
+	 * exist, makes the initializer a throw, which isn't a constant expression, so
+	 * it is reported as a compile error. For example, to order the construction
+	 * of a few singletons:
+	 * \code
+	 * enum Singleton { LOGGER, CONFIGURATION, DATABASE, SINGLETON_COUNT };
+	 * constexpr Depends::StaticLink links[] = { { LOGGER, CONFIGURATION }, { CONFIGURATION, DATABASE }, { LOGGER, DATABASE } };
+	 * constexpr auto order(Depends::staticOrder< SINGLETON_COUNT >(links));
+	 * static_assert(order[0] == LOGGER, "the logger comes first");
+	 * \endcode
+	 *
+	 * Nodes that don't depend on each other stay in the order of their numbers:
+	 * the next node in the order is always the lowest-numbered one of which all
+	 * sources are already in the order. This takes time proportional to the
+	 * square of the number of nodes, plus the number of links.
+	 *
+	 * Called at run time, this throws rather than failing to compile.
+	 * \throws CircularReference if the links contain a circular reference
+	 * \throws std::out_of_range if a link is to or from a node that doesn't exist */
+	template < std::size_t N, std::size_t E >
+	constexpr StaticOrder< N > staticOrder(StaticLink const (&links)[E])
+	{
+		// the links, sorted by source, in compressed rows
+		std::size_t offsets[N + 1] = {};
+		std::size_t targets[E] = {};
+		std::size_t incoming[N] = {};
+		for (std::size_t link(0); link < E; ++link)
+		{
+			if (links[link].source_ >= N || links[link].target_ >= N)
+				throw std::out_of_range("Link to or from a node that doesn't exist");
+			else
+			{ /* valid link */ }
+			++offsets[links[link].source_ + 1];
+			++incoming[links[link].target_];
+		}
+		for (std::size_t node(0); node < N; ++node)
+		{
+			offsets[node + 1] += offsets[node];
+		}
+		std::size_t cursors[N + 1] = {};
+		for (std::size_t node(0); node < N; ++node)
+		{
+			cursors[node] = offsets[node];
+		}
+		for (std::size_t link(0); link < E; ++link)
+		{
+			targets[cursors[links[link].source_]++] = links[link].target_;
+		}
+
+		StaticOrder< N > order = {};
+		bool done[N] = {};
+		for (std::size_t position(0); position < N; ++position)
+		{
+			std::size_t next(0);
+			while (next < N && (done[next] || incoming[next]))
+			{
+				++next;
+			}
+			if (next == N)
+				throw CircularReference("Circular reference detected");
+			else
+			{ /* found the next node */ }
+			done[next] = true;
+			order.nodes_[position] = next;
+			for (std::size_t link(offsets[next]); link < offsets[next + 1]; ++link)
+			{
+				--incoming[targets[link]];
+			}
+		}
+
+		return order;
+	}
+
+	/** Get the order of N nodes that aren't linked at all: their own.
+	 * \see staticOrder(StaticLink const (&)[E]) */
+	template < std::size_t N >
+	constexpr StaticOrder< N > staticOrder()
+	{
+		StaticOrder< N > order = {};
+		for (std::size_t position(0); position < N; ++position)
+		{
+			order.nodes_[position] = position;
+		}
+
+		return order;
+	}
+}
+
+#endif
@@ -0,0 +1,96 @@
+#include "../condensation.hpp"
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef Depends::Condensation< std::string > Condensation;
+
+void test1()
+{
+	// a -> b -> c -> a is a cycle, which d depends on and e is a dependency of; f depends on itself
+	std::vector< std::pair< std::string, std::string > > edges;
+	edges.push_back(std::make_pair("d", "a"));
+	edges.push_back(std::make_pair("a", "b"));
+	edges.push_back(std::make_pair("b", "c"));
+	edges.push_back(std::make_pair("c", "a"));
+	edges.push_back(std::make_pair("c", "e"));
+	edges.push_back(std::make_pair("b", "e"));
+	edges.push_back(std::make_pair("f", "f"));
+	edges.push_back(std::make_pair("f", "e"));
+	Condensation condensation(edges.begin(), edges.end());
+	assert(condensation.values() == 6);
+	assert(condensation.size() == 4);
+	assert(condensation.component("a") == condensation.component("b"));
+	assert(condensation.component("a") == condensation.component("c"));
+	assert(condensation.component("a") != condensation.component("d"));
+	std::vector< std::string > members(condensation.members(condensation.component("b")));
+	std::sort(members.begin(), members.end());
+	assert(members.size() == 3 && members[0] == "a" && members[1] == "b" && members[2] == "c");
+
+	assert(condensation.cycles().size() == 2);
+	assert(std::count(condensation.cycles().begin(), condensation.cycles().end(), condensation.component("a")) == 1);
+	assert(std::count(condensation.cycles().begin(), condensation.cycles().end(), condensation.component("f")) == 1);
+
+	Condensation::dag_type const &dag(condensation.dag());
+	assert(dag.size() == 4);
+	assert(dag.linked(condensation.component("d"), condensation.component("a")));
+	assert(dag.linked(condensation.component("a"), condensation.component("e")));
+	assert(dag.linked(condensation.component("d"), condensation.component("e")));
+	assert(dag.linked(condensation.component("f"), condensation.component("e")));
+	assert(!dag.linked(condensation.component("e"), condensation.component("a")));
+	// components only link to components found before them
+	for (Condensation::dag_type::const_iterator which(dag.begin()); which != dag.end(); ++which)
+	{
+		for (Condensation::dag_type::const_iterator other(dag.begin()); other != dag.end(); ++other)
+		{
+			assert(*which == *other || !dag.linked(which, other) || *other < *which);
+		}
+	}
+
+	bool thrown(false);
+	try
+	{
+		condensation.component("g");
+	}
+	catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+}
+
+void test2()
+{
+	// a long chain closed into a single cycle, which would overflow a recursive search's stack
+	std::vector< std::pair< int, int > > edges;
+	const int count(200000);
+	for (int i = 0; i < count; ++i)
+	{
+		edges.push_back(std::make_pair(i, (i + 1) % count));
+	}
+	// and an acyclic tail hanging off of it
+	for (int i = count; i < count + 100; ++i)
+	{
+		edges.push_back(std::make_pair(i - 1 == count - 1 ? 0 : i - 1, i));
+	}
+	Depends::Condensation< int > condensation(edges.begin(), edges.end());
+	assert(condensation.size() == 101);
+	assert(condensation.cycles().size() == 1);
+	assert(condensation.members(condensation.cycles()[0]).size() == count);
+	assert(condensation.dag().linked(condensation.component(count / 2), condensation.component(count + 99)));
+	assert(condensation.dag().levels().ends().size() == 101);
+
+	std::vector< std::pair< int, int > > none;
+	Depends::Condensation< int > empty(none.begin(), none.end());
+	assert(empty.size() == 0);
+	assert(empty.dag().empty());
+	assert(empty.cycles().empty());
+}
+
+int main()
+{
+	test1();
+	test2();
+}
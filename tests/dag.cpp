@@ -1,8 +1,13 @@
 #include "../dag.hpp"
 #include <vector>
 #include <cassert>
+#include <set>
 #include <algorithm>
 #include <iostream>
+#include <string>
+#include <cstdlib>
+#include <iterator>
+#include <stdexcept>
 
 void test1(void)
 {
@@ -68,10 +73,963 @@ void test2(void)
 	std::cout << std::endl;
 }
 
+void test3(void)
+{
+	Depends::DAG<int> dag;
+	for (int i = 0; i < 4; i++)
+		dag.insert(i);
+
+	// 0 -> 1 -> 2 -> 3, plus the implied 0 -> 2, 0 -> 3 and 1 -> 3
+	for (int i = 0; i < 3; ++i)
+		dag.link(i, i + 1);
+	dag.link(0, 2);
+	dag.link(0, 3);
+	dag.link(1, 3);
+	assert(dag.reduce() == 3);
+	assert(dag.reduce() == 0);
+	assert(dag.linked(0, 3));
+	assert(!dag.unlink(0, 2));
+	assert(!dag.unlink(1, 3));
+	std::vector< int > expected = { 0, 1, 2, 3 };
+	assert(std::equal(dag.begin(), dag.end(), expected.begin()));
+
+	dag.setRejectImpliedLinks(true);
+	assert(!dag.link(0, 3));
+	assert(!dag.unlink(0, 3));
+	assert(dag.unlink(2, 3));
+	assert(dag.link(0, 3));
+}
+
+void test4(void)
+{
+	Depends::DAG<int> dag;
+	for (int i = 0; i < 6; i++)
+		dag.insert(i);
+	assert(dag.levels().size() == 1);
+	assert(dag.levels().size(0) == 6);
+
+	// 0 -> 1 -> 3, 0 -> 2 -> 3 -> 4, 5 on its own
+	dag.link(0, 1);
+	dag.link(0, 2);
+	dag.link(1, 3);
+	dag.link(2, 3);
+	dag.link(3, 4);
+	Depends::DAG<int>::levels_type levels(dag.levels());
+	assert(levels.size() == 4);
+	assert(levels.size(0) == 2);
+	assert(levels.size(1) == 2);
+	assert(levels.size(2) == 1 && **levels.begin(2) == 3);
+	assert(levels.size(3) == 1 && **levels.begin(3) == 4);
+	assert(dag.level(std::find(dag.begin(), dag.end(), 4)) == 3);
+
+	// removing one of two paths of the same length changes nothing
+	dag.unlink(1, 3);
+	assert(dag.levels().size() == 4);
+	// moving 3 up a level does
+	dag.unlink(2, 3);
+	dag.link(0, 3);
+	levels = dag.levels();
+	assert(levels.size() == 3);
+	assert(levels.size(0) == 2);
+	assert(levels.size(1) == 3);
+	assert(levels.size(2) == 1 && **levels.begin(2) == 4);
+	// and linking in front of the chain moves all of it down
+	dag.link(5, 0);
+	assert(dag.levels().size() == 4);
+	assert(dag.level(std::find(dag.begin(), dag.end(), 4)) == 3);
+}
+
+void test5(void)
+{
+	Depends::DAG<int> dag;
+	for (int i = 0; i < 4; i++)
+		dag.insert(i);
+	dag.link(0, 1);
+	dag.link(1, 2);
+
+	Depends::DAG<int> copy(dag);
+	assert(copy == dag);
+	copy.link(2, 3);
+	assert(copy.linked(0, 3));
+	assert(!dag.linked(0, 3));
+	assert(copy != dag);
+
+	dag = copy;
+	assert(dag == copy);
+	dag.unlink(0, 1);
+	assert(!dag.linked(0, 3));
+	assert(copy.linked(0, 3));
+}
+
+void test6(void)
+{
+	Depends::DAG< std::string > dag;
+	std::string a("a");
+	assert(dag.insert(std::move(a)).second);
+	assert(dag.emplace(3, 'b').second);
+	assert(!dag.emplace("a").second);
+	assert(dag.insert(std::string("c")).second);
+	dag.link("a", "bbb");
+	dag.link(dag.find("bbb"), "c");
+	// a linked value is still found when inserted again
+	assert(!dag.insert(std::string("c")).second);
+	assert(dag.size() == 3);
+
+	Depends::DAG< std::string > moved(std::move(dag));
+	assert(dag.empty());
+	assert(moved.size() == 3);
+	assert(moved.linked("a", "c"));
+	dag = std::move(moved);
+	assert(moved.empty());
+	assert(dag.linked("a", "c"));
+	assert(*dag.find("bbb") == "bbb");
+	assert(dag.find("d") == dag.end());
+}
+
+struct Package
+{
+	Package(int id, const std::string &name)
+		: id_(id)
+		, name_(name)
+	{ /* no-op */ }
+
+	int id_;
+	std::string name_;
+};
+bool operator==(const Package &lhs, const Package &rhs) { return lhs.id_ == rhs.id_; }
+bool operator<(const Package &lhs, const Package &rhs) { return lhs.id_ < rhs.id_; }
+
+struct PackageHash
+{
+	typedef void is_transparent;
+	std::size_t operator()(const Package &package) const { return std::hash< int >()(package.id_); }
+	std::size_t operator()(int id) const { return std::hash< int >()(id); }
+};
+
+struct PackageEqual
+{
+	typedef void is_transparent;
+	bool operator()(const Package &lhs, const Package &rhs) const { return lhs.id_ == rhs.id_; }
+	bool operator()(int lhs, const Package &rhs) const { return lhs == rhs.id_; }
+};
+
+void test7(void)
+{
+	Depends::DAG< Package, PackageHash, PackageEqual > dag;
+	for (int i = 0; i < 1000; ++i)
+		dag.emplace(i, "package");
+	assert(!dag.emplace(12, "duplicate").second);
+	assert(dag.find(12)->id_ == 12);
+	assert(dag.find(1000) == dag.end());
+	for (int i = 0; i < 999; ++i)
+		dag.link(i, i + 1);
+	assert(dag.linked(0, 999));
+	assert(dag.linked(dag.find(0), 999));
+	assert(!dag.linked(999, dag.find(0)));
+	assert(dag.unlink(499, 500));
+	assert(!dag.linked(0, 999));
+	assert(dag.find(999) != dag.end());
+	dag.erase(dag.find(500));
+	assert(dag.find(500) == dag.end());
+	assert(dag.find(501)->id_ == 501);
+	assert(dag.size() == 999);
+}
+
+
+void test8(void)
+{
+	Depends::DAG<int> dag;
+	for (int i = 0; i < 10; i++)
+		dag.insert(i);
+	// 0 -> 1 -> 2 -> 3, 4 -> 2, 5 -> 6
+	dag.link(0, 1);
+	dag.link(1, 2);
+	dag.link(2, 3);
+	dag.link(4, 2);
+	dag.link(5, 6);
+
+	// 2 and 3 have the highest scores, so they are the last two nodes
+	Depends::DAG<int>::iterator first(dag.find(2));
+	assert(std::distance(first, dag.end()) == 2);
+	first = dag.erase(first, dag.end());
+	assert(first == dag.end());
+	assert(dag.size() == 8);
+	assert(dag.find(2) == dag.end() && dag.find(3) == dag.end());
+	assert(dag.linked(0, 1));
+	assert(dag.levels().size() == 2);
+	// nothing links to the erased nodes any more
+	dag.link(1, 4);
+	assert(dag.levels().size() == 3);
+
+	// erasing nodes that link to others re-scores what they linked to
+	assert(dag.eraseIf([](int value){ return value == 0 || value == 5; }) == 2);
+	assert(dag.size() == 6);
+	assert(dag.levels().size() == 2);
+	assert(dag.level(dag.find(6)) == 0);
+	dag.link(6, 1);
+	dag.link(4, 7);
+	assert(*dag.begin() == 6 || *dag.begin() == 8 || *dag.begin() == 9);
+	assert(dag.levels().size() == 4);
+	assert(dag.level(dag.find(7)) == 3);
+
+	dag.erase(dag.find(1));
+	assert(dag.size() == 5);
+	assert(!dag.linked(6, 4));
+	assert(dag.linked(4, 7));
+
+	dag.clear();
+	assert(dag.empty());
+	assert(dag.levels().size() == 0);
+	dag.insert(1);
+	dag.insert(2);
+	dag.link(1, 2);
+	assert(dag.linked(1, 2));
+}
+
+template < typename OrderingPolicy >
+void checkOrdering(void)
+{
+	typedef Depends::DAG< int, std::hash< int >, std::equal_to< int >, OrderingPolicy > Ordered;
+	Depends::DAG< int > reference;
+	Ordered dag;
+	std::vector< int > v;
+	for (int i = 0; i < 100; ++i)
+	{
+		reference.insert(i);
+		dag.insert(i);
+		v.push_back(i);
+	}
+	std::srand(42);
+	for (int c = 0; c < 5; c++)
+	{
+		std::random_shuffle(v.begin(), v.end());
+		for (std::vector<int>::const_iterator i = v.begin(); i + 1 != v.end(); ++i)
+		{
+			bool refused(false);
+			try
+			{
+				reference.link(*i, *(i + 1));
+			}
+			catch (const Depends::DAG<int>::circular_reference_exception &)
+			{
+				refused = true;
+			}
+			// the policy changes the order, but not which links are refused
+			try
+			{
+				dag.link(*i, *(i + 1));
+				assert(!refused);
+			}
+			catch (const typename Ordered::circular_reference_exception &)
+			{
+				assert(refused);
+			}
+		}
+	}
+	for (int i = 0; i < 100; i += 7)
+	{
+		reference.unlink(i, i + 1);
+		dag.unlink(i, i + 1);
+	}
+	assert(dag.levels().size() == reference.levels().size());
+	for (int i = 0; i < 100; ++i)
+		assert(dag.level(dag.find(i)) == reference.level(reference.find(i)));
+	assert(dag.reduce() == reference.reduce());
+	std::vector< std::pair< int, int > > queries;
+	for (int i = 0; i < 100; ++i)
+		for (int j = 0; j < 100; j += 9)
+		{
+			assert(dag.linked(i, j) == reference.linked(i, j));
+			queries.push_back(std::make_pair(i, j));
+		}
+	std::vector< bool > answers(dag.linkedAll(queries.begin(), queries.end()));
+	for (std::size_t i = 0; i < queries.size(); ++i)
+		assert(answers[i] == reference.linked(queries[i].first, queries[i].second));
+	if (Ordered::ordering_policy::topological)
+	{
+		for (typename Ordered::iterator source(dag.begin()); source != dag.end(); ++source)
+			for (typename Ordered::iterator target(dag.begin()); target != source; ++target)
+				assert(!dag.linked(source, target));
+	}
+	else
+	{
+		for (int i = 0; i < 100; ++i)
+			assert(*std::next(dag.begin(), i) == i);
+	}
+}
+
+void test9(void)
+{
+	checkOrdering< Depends::Ordering::Topological >();
+	checkOrdering< Depends::Ordering::Insertion >();
+	checkOrdering< Depends::Ordering::Score >();
+}
+
+void test10(void)
+{
+	// nodes that link to more values than they keep inline
+	typedef Depends::DAG< int, std::hash< int >, std::equal_to< int >, Depends::Ordering::Score, 2 > Small;
+	Small dag;
+	for (int i = 0; i < 12; ++i)
+		dag.insert(i);
+	for (int i = 1; i < 11; ++i)
+		dag.link(0, i);
+	dag.link(1, 11);
+	dag.link(2, 11);
+	Small copy(dag);
+	for (int i = 1; i < 11; i += 2)
+		assert(dag.unlink(0, i));
+	for (int i = 1; i < 11; ++i)
+		assert(dag.linked(0, i) == (i % 2 == 0));
+	assert(copy.linked(0, 9));
+	Small moved(std::move(copy));
+	assert(copy.empty());
+	assert(moved.linked(0, 9) && moved.linked(0, 11));
+	moved.erase(moved.find(11));
+	assert(moved.linked(1, 11) == false);
+	assert(moved.size() == 11);
+	assert(dag.reduce() == 0);
+	assert(dag.linked(0, 11));
+}
+
+void test11(void)
+{
+	// a hub that links to more values than are scanned linearly
+	Depends::DAG< int > dag;
+	const int count(200);
+	for (int i = 0; i <= count; ++i)
+		dag.insert(i);
+	for (int i = 1; i <= count; ++i)
+		assert(dag.link(0, i));
+	assert(dag.find(0).node()->targets_.isIndexed());
+	// duplicates are refused, and don't change the scores
+	dag.link(1, 2);
+	assert(!dag.link(0, 2));
+	assert(!dag.link(1, 2));
+	assert(dag.find(2).node()->score_ == 4);
+	assert(dag.find(0).node()->targets_.size() == count);
+	for (int i = 1; i <= count; i += 2)
+		assert(dag.unlink(0, i));
+	assert(!dag.unlink(0, 1));
+	for (int i = 2; i <= count; i += 2)
+		assert(dag.linked(0, i));
+	assert(dag.find(2).node()->score_ == 3);
+	assert(dag.find(4).node()->score_ == 2);
+	assert(dag.find(3).node()->score_ == 1);
+	assert(dag.reduce() == 0);
+	dag.link(1, 4);
+	dag.link(0, 1);
+	assert(dag.reduce() == 2);
+	assert(!dag.find(0).node()->targets_.isIndexed() || dag.find(0).node()->targets_.size() > Depends::DAG< int >::node_type::targets_type::threshold);
+	Depends::DAG< int > copy(dag);
+	assert(copy == dag);
+	assert(copy.linked(0, 200) && !copy.linked(0, 199));
+	copy.eraseIf([](int value){ return value > 60; });
+	assert(copy.size() == 61);
+	assert(!copy.find(0).node()->targets_.isIndexed());
+	assert(copy.linked(0, 60));
+}
+
+void test12(void)
+{
+	Depends::DAG< int > dag;
+	for (int i = 0; i < 6; ++i)
+		dag.insert(i);
+	std::vector< int > targets = { 3, 1, 2 };
+	assert(dag.linkTargets(dag.find(0), targets.begin(), targets.end()) == 3);
+	std::vector< int > sources = { 1, 2 };
+	assert(dag.linkSources(sources.begin(), sources.end(), dag.find(3)) == 2);
+	// duplicates are skipped
+	assert(dag.linkTargets(dag.find(0), targets.begin(), targets.end()) == 0);
+	assert(*dag.begin() == 0 || *dag.begin() == 4 || *dag.begin() == 5);
+	assert(*dag.rbegin() == 3);
+	assert(dag.find(3).node()->score_ == 6);
+	assert(dag.levels().size() == 3);
+	// all or nothing
+	std::vector< int > circular = { 4, 0, 5 };
+	try
+	{
+		dag.linkTargets(dag.find(3), circular.begin(), circular.end());
+		assert(false);
+	}
+	catch (const Depends::DAG< int >::circular_reference_exception &)
+	{ /* expected */ }
+	assert(!dag.linked(3, 4));
+	assert(dag.find(3).node()->score_ == 6);
+	assert(dag.levels().size() == 3);
+	std::vector< int > missing = { 4, 42 };
+	try
+	{
+		dag.linkTargets(dag.find(3), missing.begin(), missing.end());
+		assert(false);
+	}
+	catch (const std::invalid_argument &)
+	{ /* expected */ }
+	assert(!dag.linked(3, 4));
+}
+
+void test13(void)
+{
+	Depends::DAG< int > dag;
+	const int count(300);
+	for (int i = 0; i < count; ++i)
+		dag.insert(i);
+	std::srand(13);
+	for (int i = 0; i < 2 * count; ++i)
+	{
+		int lhs(std::rand() % count);
+		int rhs(std::rand() % count);
+		if (lhs < rhs)
+			dag.link(lhs, rhs);
+		else
+		{ /* keep it acyclic */ }
+	}
+	typedef Depends::DAG< int >::closure_type Closure;
+	for (unsigned int threads = 1; threads <= 4; threads += 3)
+	{
+		Closure full(dag.closure(Closure::FULL, threads));
+		Closure counts(dag.closure(Closure::COUNT_ONLY, threads));
+		assert(full.size() == dag.size() && counts.size() == dag.size());
+		assert(full.hasRows() && !counts.hasRows());
+		for (Depends::DAG< int >::const_iterator source(dag.begin()); source != dag.end(); ++source)
+		{
+			const std::size_t index(full.index(*source));
+			assert(full.value(index) == *source);
+			std::vector< const int* > reached;
+			full.reached(index, std::back_inserter(reached));
+			assert(reached.size() == full.count(index));
+			assert(counts.count(counts.index(*source)) == full.count(index));
+			std::size_t expected(0);
+			for (Depends::DAG< int >::const_iterator target(dag.begin()); target != dag.end(); ++target)
+			{
+				const bool linked(source != target && dag.linked(source, target));
+				assert(full.reaches(index, full.index(*target)) == linked);
+				expected += linked;
+			}
+			assert(expected == full.count(index));
+		}
+	}
+	assert(Depends::DAG< int >().closure().empty());
+}
+
+template < typename OrderingPolicy >
+void checkAssign(void)
+{
+	typedef Depends::DAG< int, std::hash< int >, std::equal_to< int >, OrderingPolicy > Ordered;
+	std::vector< int > values;
+	std::vector< std::pair< int, int > > links;
+	for (int i = 0; i < 50; ++i)
+	{
+		values.push_back(49 - i);
+		if (i)
+			links.push_back(std::make_pair((i - 1) / 2, i));
+		else
+		{ /* the root */ }
+	}
+	links.push_back(std::make_pair(3, 40));
+	links.push_back(std::make_pair(3, 40));
+	values.push_back(7);
+	Ordered dag;
+	dag.insert(100);
+	dag.assign(values.begin(), values.end(), links.begin(), links.end());
+	assert(dag.size() == 50);
+	assert(dag.find(100) == dag.end());
+	for (auto link : links)
+	{
+		assert(dag.linked(link.first, link.second));
+		assert(!dag.linked(link.second, link.first));
+	}
+	assert(dag.linked(0, 49));
+	assert(dag.levels().ends().size() == 6);
+	// the DAG is usable as usual afterwards
+	assert(dag.link(49, 48));
+	if (OrderingPolicy::topological)
+	{
+		for (auto link : links)
+		{
+			assert(std::distance(dag.begin(), dag.find(link.first)) < std::distance(dag.begin(), dag.find(link.second)));
+		}
+	}
+	else
+	{
+		assert(*dag.begin() == 49);
+	}
+
+	// a circular reference leaves the DAG untouched
+	links.push_back(std::make_pair(40, 1));
+	bool thrown(false);
+	try
+	{
+		dag.assign(values.begin(), values.end(), links.begin(), links.end());
+	}
+	catch (const typename Ordered::circular_reference_exception &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(dag.linked(49, 48));
+	links.back() = std::make_pair(40, 51);
+	thrown = false;
+	try
+	{
+		dag.assign(values.begin(), values.end(), links.begin(), links.end());
+	}
+	catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(dag.size() == 50);
+}
+
+void test14(void)
+{
+	checkAssign< Depends::Ordering::Score >();
+	checkAssign< Depends::Ordering::Topological >();
+	checkAssign< Depends::Ordering::Insertion >();
+}
+
+struct Recorder : Depends::DAG< int >::observer_type
+{
+	virtual void changed(Depends::DAG< int >::change_set_type const &changes)
+	{
+		changes_.push_back(changes);
+	}
+
+	std::vector< Depends::DAG< int >::change_set_type > changes_;
+};
+
+void test15(void)
+{
+	Depends::DAG< int > dag;
+	Recorder recorder;
+	dag.setObserver(&recorder);
+	assert(dag.getObserver() == &recorder);
+	dag.insert(0);
+	assert(recorder.changes_.size() == 1);
+	assert(recorder.changes_[0].inserted_.size() == 1 && recorder.changes_[0].inserted_[0] == 0);
+	assert(!recorder.changes_[0].reordered_);
+	assert(!dag.insert(0).second);
+	assert(recorder.changes_.size() == 1);
+
+	// a batch is reported once, coalesced
+	{
+		Depends::DAG< int >::Batch batch(dag);
+		for (int i = 1; i < 10; ++i)
+			dag.insert(i);
+		for (int i = 1; i < 10; ++i)
+			dag.link(i - 1, i);
+		dag.unlink(4, 5);
+		dag.link(4, 5);
+		dag.unlink(8, 9);
+		dag.insert(10);
+		dag.link(9, 10);
+		dag.erase(dag.find(10));
+		assert(recorder.changes_.size() == 1);
+	}
+	assert(recorder.changes_.size() == 2);
+	Depends::DAG< int >::change_set_type changes(recorder.changes_.back());
+	std::sort(changes.inserted_.begin(), changes.inserted_.end());
+	assert(changes.inserted_.size() == 9 && changes.inserted_[0] == 1 && changes.inserted_[8] == 9);
+	assert(changes.erased_.empty());
+	assert(changes.linked_.size() == 8);
+	assert(std::find(changes.linked_.begin(), changes.linked_.end(), std::make_pair(8, 9)) == changes.linked_.end());
+	assert(std::find(changes.linked_.begin(), changes.linked_.end(), std::make_pair(4, 5)) != changes.linked_.end());
+	assert(changes.unlinked_.empty());
+	assert(changes.reordered_);
+
+	// one notification for each bulk operation
+	int targets[3] = { 7, 8, 9 };
+	assert(dag.linkTargets(dag.find(0), targets, targets + 3) == 3);
+	assert(recorder.changes_.size() == 3);
+	assert(recorder.changes_.back().linked_.size() == 3);
+	assert(dag.reduce() == 2);
+	assert(recorder.changes_.size() == 4);
+	assert(recorder.changes_.back().unlinked_.size() == 2);
+	assert(dag.eraseIf([](int value){ return value > 6; }) == 3);
+	assert(recorder.changes_.size() == 5);
+	assert(recorder.changes_.back().erased_.size() == 3);
+	assert(recorder.changes_.back().unlinked_.empty());
+	assert(!dag.unlink(0, 6));
+	assert(recorder.changes_.size() == 5);
+	dag.clear();
+	assert(recorder.changes_.back().erased_.size() == 7);
+
+	dag.setObserver(0);
+	dag.insert(1);
+	assert(recorder.changes_.size() == 6);
+
+	// the insertion policy never re-orders
+	typedef Depends::DAG< int, std::hash< int >, std::equal_to< int >, Depends::Ordering::Insertion > Ordered;
+	struct : Ordered::observer_type
+	{
+		virtual void changed(Ordered::change_set_type const &changes) { reordered_ = reordered_ || changes.reordered_; }
+		bool reordered_ = false;
+	} watcher;
+	Ordered ordered;
+	ordered.setObserver(&watcher);
+	ordered.insert(1);
+	ordered.insert(0);
+	ordered.link(1, 0);
+	assert(!watcher.reordered_);
+}
+
+template < typename OrderingPolicy >
+void checkTopological(void)
+{
+	typedef Depends::DAG< int, std::hash< int >, std::equal_to< int >, OrderingPolicy > Ordered;
+	Ordered dag;
+	for (int i = 0; i < 30; ++i)
+		dag.insert(i);
+	// links from a higher value to a lower one only, in an order the DAG has to re-order for
+	for (int i = 29; i > 0; --i)
+	{
+		dag.link(i, i / 2);
+		if (i % 3 == 0)
+			dag.link(i, i - 1);
+		else
+		{ /* only one link */ }
+	}
+	std::vector< int > order;
+	typename Ordered::topological_range all(dag.topological());
+	std::copy(all.begin(), all.end(), std::back_inserter(order));
+	assert(order.size() == 30);
+	for (std::size_t i = 0; i < order.size(); ++i)
+	{
+		for (std::size_t j = i + 1; j < order.size(); ++j)
+		{
+			assert(!dag.linked(order[j], order[i]));
+		}
+	}
+
+	// 6 is reached from 12, and 12 is given twice: each appears once
+	int starts[4] = { 12, 9, 6, 12 };
+	order.clear();
+	typename Ordered::topological_range some(dag.topological(starts, starts + 4));
+	for (typename Ordered::topological_range::iterator which(some.begin()); which != some.end(); ++which)
+	{
+		order.push_back(*which);
+	}
+	std::vector< int > sorted(order);
+	std::sort(sorted.begin(), sorted.end());
+	std::vector< int > expected;
+	for (int i = 0; i < 30; ++i)
+	{
+		if (i == 12 || i == 9 || dag.linked(12, i) || dag.linked(9, i))
+			expected.push_back(i);
+		else
+		{ /* not in the closure */ }
+	}
+	assert(expected.size() < 30);
+	assert(sorted == expected);
+	for (std::size_t i = 0; i < order.size(); ++i)
+	{
+		for (std::size_t j = i + 1; j < order.size(); ++j)
+		{
+			assert(!dag.linked(order[j], order[i]));
+		}
+	}
+
+	// iteration can stop at any time
+	typename Ordered::topological_range first(dag.topological());
+	typename Ordered::topological_range::iterator which(first.begin());
+	assert(which != first.end());
+	for (int i = 0; i < 30; ++i)
+	{
+		assert(!dag.linked(i, *which) || i == *which);
+	}
+	assert(Ordered().topological().begin() == Ordered().topological().end());
+}
+
+void test16(void)
+{
+	checkTopological< Depends::Ordering::Score >();
+	checkTopological< Depends::Ordering::Topological >();
+	checkTopological< Depends::Ordering::Insertion >();
+}
+
+void test17(void)
+{
+	typedef Depends::DAG< int > Dag;
+	Dag dag;
+	assert(dag.memoryUsage().total() == 0);
+	for (int i = 0; i < 200; ++i)
+		dag.insert(i);
+	for (int i = 1; i < 200; ++i)
+		dag.link(0, i);
+	Dag::memory_usage_type usage(dag.memoryUsage());
+	assert(usage.values_ == 200 * sizeof(int));
+	assert(usage.nodes_ >= 200 * sizeof(Dag::node_type));
+	// the hub's links don't fit inline, and are indexed
+	assert(usage.adjacency_ >= 199 * sizeof(Dag::node_type*));
+	assert(usage.indexes_ > 0);
+	assert(usage.total() == usage.nodes_ + usage.adjacency_ + usage.values_ + usage.indexes_ + usage.slack_);
+
+	// erasing leaves room that shrinking gives back
+	dag.eraseIf([](int value){ return value > 2; });
+	Dag::memory_usage_type before(dag.memoryUsage());
+	assert(before.slack_ > 0);
+	dag.shrink_to_fit();
+	Dag::memory_usage_type after(dag.memoryUsage());
+	assert(after.slack_ < before.slack_);
+	assert(after.adjacency_ == 0);
+	assert(after.values_ == 3 * sizeof(int));
+	assert(after.total() < before.total());
+	assert(dag.linked(0, 2));
+	assert(dag.find(1) != dag.end());
+}
+
+template < typename DAGType >
+std::set< std::pair< int, int > > directLinks(DAGType const &dag)
+{
+	std::set< std::pair< int, int > > links;
+	for (auto node(dag.begin()); node != dag.end(); ++node)
+	{
+		for (auto target : node.node()->targets_)
+		{
+			links.insert(std::make_pair(*node, target->value_));
+		}
+	}
+	return links;
+}
+
+template < typename OrderingPolicy >
+void checkTransaction(void)
+{
+	typedef Depends::DAG< int, std::hash< int >, std::equal_to< int >, OrderingPolicy > Ordered;
+	Ordered dag;
+	for (int i = 0; i < 10; ++i)
+	{
+		dag.insert(i);
+	}
+	dag.link(0, 1);
+	dag.link(1, 2);
+	dag.link(2, 3);
+	dag.link(5, 6);
+	dag.link(7, 8);
+
+	typename Ordered::Transaction transaction(dag);
+	transaction.insert(10);
+	transaction.insert(11);
+	transaction.link(3, 10);
+	transaction.link(10, 11);
+	transaction.link(0, 1);
+	transaction.unlink(5, 6);
+	transaction.erase(9);
+	transaction.erase(42);
+	assert(!transaction.empty());
+	// nothing happens until the transaction is committed
+	assert(dag.size() == 10);
+	transaction.commit();
+	assert(transaction.empty());
+	assert(dag.size() == 11);
+	assert(dag.find(9) == dag.end());
+	assert(dag.linked(0, 11));
+	assert(!dag.linked(5, 6));
+	assert(dag.levels().ends().size() == 6);
+	std::set< std::pair< int, int > > const links(directLinks(dag));
+	assert(links.size() == 6);
+
+	// a circular reference undoes everything
+	transaction.insert(20);
+	transaction.unlink(7, 8);
+	transaction.link(3, 20);
+	transaction.link(11, 1);
+	transaction.erase(0);
+	bool thrown(false);
+	try
+	{
+		transaction.commit();
+	}
+	catch (const Depends::CircularReference &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(transaction.empty());
+	assert(dag.size() == 11);
+	assert(dag.find(20) == dag.end());
+	assert(directLinks(dag) == links);
+	assert(dag.levels().ends().size() == 6);
+	// as does a link to a value that isn't there
+	transaction.unlink(7, 8);
+	transaction.link(7, 42);
+	thrown = false;
+	try
+	{
+		transaction.commit();
+	}
+	catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(directLinks(dag) == links);
+	if (OrderingPolicy::topological)
+	{
+		for (auto link : links)
+		{
+			assert(std::distance(dag.begin(), dag.find(link.first)) < std::distance(dag.begin(), dag.find(link.second)));
+		}
+	}
+	else
+	{ /* not in topological order */ }
+	// the DAG is usable as usual afterwards
+	assert(dag.link(11, 7));
+	assert(dag.linked(0, 8));
+}
+
+void test18(void)
+{
+	checkTransaction< Depends::Ordering::Score >();
+	checkTransaction< Depends::Ordering::Topological >();
+	checkTransaction< Depends::Ordering::Insertion >();
+
+	// the observer hears about the whole transaction at once
+	Depends::DAG< int > dag;
+	dag.insert(1);
+	dag.insert(2);
+	dag.link(1, 2);
+	Recorder recorder;
+	dag.setObserver(&recorder);
+	Depends::DAG< int >::Transaction transaction(dag);
+	transaction.insert(3);
+	transaction.link(2, 3);
+	transaction.unlink(1, 2);
+	transaction.commit();
+	assert(recorder.changes_.size() == 1);
+	assert(recorder.changes_[0].inserted_.size() == 1);
+	assert(recorder.changes_[0].linked_.size() == 1 && recorder.changes_[0].linked_[0] == std::make_pair(2, 3));
+	assert(recorder.changes_[0].unlinked_.size() == 1 && recorder.changes_[0].unlinked_[0] == std::make_pair(1, 2));
+	// an empty transaction changes nothing
+	transaction.commit();
+	assert(recorder.changes_.size() == 1);
+
+	// transactions on two DAGs, committed together: neither is finished unless both can be prepared
+	Depends::DAG< int > other;
+	other.insert(1);
+	Depends::DAG< int >::Transaction mine(dag);
+	Depends::DAG< int >::Transaction theirs(other);
+	mine.insert(4);
+	mine.link(3, 4);
+	mine.erase(1);
+	theirs.link(1, 2);
+	mine.prepare();
+	bool thrown(false);
+	try
+	{
+		theirs.prepare();
+	}
+	catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	mine.rollback();
+	assert(mine.empty() && theirs.empty());
+	assert(dag.size() == 3 && dag.find(4) == dag.end());
+	assert(dag.find(1) != dag.end());
+	assert(dag.linked(2, 3) && !dag.linked(3, 4));
+
+	mine.insert(4);
+	mine.link(3, 4);
+	mine.erase(1);
+	theirs.insert(2);
+	theirs.link(1, 2);
+	mine.prepare();
+	theirs.prepare();
+	// the values are only erased, and the observer only told, once the transaction is finished
+	assert(dag.find(1) != dag.end());
+	std::size_t const reported(recorder.changes_.size());
+	mine.finish();
+	theirs.finish();
+	assert(recorder.changes_.size() == reported + 1);
+	assert(recorder.changes_.back().inserted_.size() == 1 && recorder.changes_.back().erased_.size() == 1);
+	assert(dag.size() == 3 && dag.find(1) == dag.end() && dag.linked(2, 4));
+	assert(other.linked(1, 2));
+
+	// a prepared transaction that is never finished is rolled back
+	std::size_t const before(recorder.changes_.size());
+	thrown = false;
+	try
+	{
+		Depends::DAG< int >::Transaction abandoned(dag);
+		abandoned.insert(5);
+		abandoned.link(4, 5);
+		abandoned.prepare();
+		assert(dag.linked(4, 5));
+		throw std::runtime_error("something else failed");
+	}
+	catch (const std::runtime_error &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(dag.size() == 3 && dag.find(5) == dag.end());
+	assert(dag.linked(2, 4));
+	for (std::size_t which(before); which < recorder.changes_.size(); ++which)
+	{
+		assert(recorder.changes_[which].inserted_.empty() && recorder.changes_[which].linked_.empty());
+	}
+	Depends::DAG< int >::Transaction after(dag);
+	after.insert(5);
+	after.link(4, 5);
+	after.commit();
+	assert(dag.linked(2, 5));
+}
+
+void test19(void)
+{
+	// assigning to an observed DAG reports only what changed
+	Depends::DAG< int > dag;
+	dag.insert(1);
+	dag.insert(2);
+	dag.insert(4);
+	dag.link(1, 4);
+	dag.link(2, 4);
+	Recorder recorder;
+	dag.setObserver(&recorder);
+	int values[3] = { 1, 2, 3 };
+	std::pair< int, int > links[3] = { std::make_pair(1, 2), std::make_pair(2, 3), std::make_pair(1, 3) };
+	dag.assign(values, values + 3, links, links + 3);
+	assert(recorder.changes_.size() == 1);
+	Depends::DAG< int >::change_set_type changes(recorder.changes_.back());
+	assert(changes.inserted_.size() == 1 && changes.inserted_[0] == 3);
+	assert(changes.erased_.size() == 1 && changes.erased_[0] == 4);
+	assert(changes.linked_.size() == 3);
+	assert(changes.unlinked_.empty());
+	assert(dag.linked(1, 2) && dag.linked(2, 3));
+
+	// links that stay are not reported
+	std::pair< int, int > fewer[2] = { std::make_pair(1, 2), std::make_pair(2, 3) };
+	dag.assign(values, values + 3, fewer, fewer + 2);
+	assert(recorder.changes_.size() == 2);
+	changes = recorder.changes_.back();
+	assert(changes.inserted_.empty() && changes.erased_.empty());
+	assert(changes.linked_.empty());
+	assert(changes.unlinked_.size() == 1 && changes.unlinked_[0] == std::make_pair(1, 3));
+}
 
 int main(void)
 {
 	test1();
 	test2();
+	test3();
+	test4();
+	test5();
+	test6();
+	test7();
+	test8();
+	test9();
+	test10();
+	test11();
+	test12();
+	test13();
+	test14();
+	test15();
+	test16();
+	test17();
+	test18();
+	test19();
 }
 
@@ -1,6 +1,12 @@
 #include "../depends.hpp"
 #include <cassert>
 #include <boost/tuple/tuple.hpp>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 void test1()
 {
@@ -197,6 +203,571 @@ void test14()
 	assert(preqs.find(2) == preqs.end());
 }
 
+void test15()
+{
+	int i1[3] = { 0, 1, 2 };
+	Depends::Depends< int > deps(i1, i1 + 3);
+	deps.select(0);
+	deps.addPrerequisite(1);
+	deps.addPrerequisite(2);
+	deps.select(1);
+	deps.addPrerequisite(2);
+	assert(deps.reduce() == 1);
+	deps.select(0);
+	std::set< int > preqs(deps.getPrerequisites());
+	assert(preqs.size() == 1);
+	assert(preqs.find(1) != preqs.end());
+	assert(deps.getPrerequisites(true).size() == 2);
+	assert(deps.depends(0, 2));
+
+	deps.setRejectImpliedLinks(true);
+	deps.addPrerequisite(2);
+	assert(deps.getPrerequisites().size() == 1);
+}
+
+void test16()
+{
+	int i1[4] = { 0, 1, 2, 3 };
+	Depends::Depends< int > deps(i1, i1 + 4);
+	deps.select(2);
+	deps.addPrerequisite(0);
+	deps.addPrerequisite(1);
+	deps.select(3);
+	deps.addPrerequisite(2);
+	Depends::Depends< int >::levels_type levels(deps.levels());
+	assert(levels.size() == 3);
+	assert(levels.size(0) == 2);
+	assert(levels.size(1) == 1 && **levels.begin(1) == 2);
+	assert(levels.size(2) == 1 && **levels.begin(2) == 3);
+}
+
+void test17()
+{
+	Depends::Depends< std::string > deps;
+	std::string a("a");
+	assert(deps.insert(std::move(a)).second);
+	assert(deps.emplace(3, 'b').second);
+	assert(!deps.emplace("a").second);
+	deps.select(std::string("c"));
+	deps.addPrerequisite(std::string("bbb"));
+	deps.select("bbb");
+	deps.addPrerequisite("a");
+	assert(deps.size() == 3);
+
+	Depends::Depends< std::string > moved(std::move(deps));
+	assert(deps.empty());
+	assert(moved.depends("c", "a"));
+	assert(moved.getPrerequisites().size() == 1);
+	deps = std::move(moved);
+	assert(moved.empty());
+	assert(deps.depends("c", "a"));
+	assert(deps.getPrerequisites().size() == 1);
+	moved.select("d");
+	moved.addPrerequisite("e");
+	assert(moved.depends("d", "e"));
+	assert(!deps.depends("d", "e"));
+}
+
+struct Package
+{
+	Package(int id, const std::string &name)
+		: id_(id)
+		, name_(name)
+	{ /* no-op */ }
+
+	int id_;
+	std::string name_;
+};
+
+struct PackageLess
+{
+	typedef void is_transparent;
+	bool operator()(const Package &lhs, const Package &rhs) const { return lhs.id_ < rhs.id_; }
+	bool operator()(int lhs, const Package &rhs) const { return lhs < rhs.id_; }
+	bool operator()(const Package &lhs, int rhs) const { return lhs.id_ < rhs; }
+};
+
+void test18()
+{
+	Depends::Depends< Package, PackageLess > deps;
+	deps.select(Package(2, "two"));
+	deps.addPrerequisite(Package(1, "one"));
+	deps.select(Package(1, "one"));
+	deps.addPrerequisite(Package(0, "zero"));
+	assert(deps.find(1)->name_ == "one");
+	assert(deps.find(3) == deps.end());
+	assert(deps.depends(2, 0));
+	assert(deps.depends(deps.find(2), 0));
+	assert(deps.depends(2, deps.find(0)));
+	assert(!deps.depends(0, 2));
+	assert(deps.erase(1) == 1);
+	assert(!deps.depends(2, 0));
+}
+
+void test19()
+{
+	int i1[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+	Depends::Depends< int > deps(i1, i1 + 10);
+	// 0 <- 3 <- 6 <- 9, 5 <- 9
+	deps.select(9);
+	deps.addPrerequisite(6);
+	deps.addPrerequisite(5);
+	deps.select(6);
+	deps.addPrerequisite(3);
+	deps.select(3);
+	deps.addPrerequisite(0);
+	deps.select(4);
+	deps.erase(deps.find(3), deps.find(7));
+	assert(deps.size() == 6);
+	assert(deps.find(4) == deps.end());
+	assert(!deps.depends(9, 0));
+	// the selection was erased with the rest
+	deps.select(9);
+	assert(deps.getPrerequisites(true).empty());
+	deps.select(0);
+	assert(deps.getDependants(true).empty());
+	deps.select(9);
+	deps.addPrerequisite(0);
+	assert(deps.depends(9, 0));
+	deps.erase(deps.begin(), deps.end());
+	assert(deps.empty());
+}
+
+void test20()
+{
+	Depends::Depends< int > deps;
+	Depends::Depends< int >::const_iterator top(deps.insert(0).first);
+	int prerequisites[] = { 1, 2, 3, 4 };
+	deps.addPrerequisites(top, prerequisites, prerequisites + 4);
+	int lower[] = { 5, 6 };
+	deps.addPrerequisites(deps.find(2), lower, lower + 2);
+	deps.addDependants(deps.find(6), prerequisites + 2, prerequisites + 4);
+	assert(deps.size() == 7);
+	std::set< int > direct(deps.getPrerequisites(top));
+	assert(direct.size() == 4 && *direct.begin() == 1 && *direct.rbegin() == 4);
+	std::set< int > all(deps.getPrerequisites(top, true));
+	assert(all.size() == 6);
+	assert(deps.getDependants(deps.find(6), true).size() == 4);
+	assert(deps.depends(3, 6));
+	// adding a batch that contains a circular reference adds none of it
+	int circular[] = { 7, 0 };
+	try
+	{
+		deps.addPrerequisites(deps.find(6), circular, circular + 2);
+		assert(false);
+	}
+	catch (const Depends::CircularReference &)
+	{ /* expected */ }
+	assert(deps.find(7) != deps.end());
+	assert(!deps.depends(6, 7));
+	assert(deps.getPrerequisites(deps.find(6)).empty());
+	// the selection is left alone
+	deps.select(5);
+	deps.removePrerequisite(top, deps.find(1));
+	deps.removeDependant(deps.find(6), deps.find(3));
+	assert(deps.getPrerequisites(top, true).size() == 5);
+	assert(deps.getDependants(true).size() == 2);
+	deps.addDependant(deps.find(7), deps.find(5));
+	assert(deps.getPrerequisites(true).size() == 1);
+}
+
+void test21()
+{
+	Depends::Depends< int > deps;
+	for (int i = 0; i < 300; ++i)
+		deps.insert(i);
+	std::srand(21);
+	for (int i = 0; i < 600; ++i)
+	{
+		int lhs(std::rand() % 300);
+		int rhs(std::rand() % 300);
+		if (lhs != rhs)
+			deps.addPrerequisite(deps.find(std::max(lhs, rhs)), deps.find(std::min(lhs, rhs)));
+		else
+		{ /* no self-dependencies */ }
+	}
+	std::vector< std::pair< int, int > > queries;
+	for (int i = 0; i < 2000; ++i)
+		queries.push_back(std::make_pair(std::rand() % 310, std::rand() % 310));
+	std::vector< bool > answers(deps.dependsAll(queries.begin(), queries.end()));
+	assert(answers.size() == queries.size());
+	std::size_t yes(0);
+	for (std::size_t i = 0; i < queries.size(); ++i)
+	{
+		assert(answers[i] == deps.depends(queries[i].first, queries[i].second));
+		yes += answers[i];
+	}
+	assert(yes > 0 && yes < queries.size());
+	typedef Depends::Depends< int >::const_iterator Iterator;
+	std::vector< std::pair< Iterator, Iterator > > iterators = { { deps.find(299), deps.end() }, { deps.find(1), deps.find(1) } };
+	answers = deps.dependsAll(iterators.begin(), iterators.end());
+	assert(!answers[0] && answers[1]);
+}
+
+void test22()
+{
+	int i1[6] = { 0, 1, 2, 3, 4, 5 };
+	Depends::Depends< int > deps(i1, i1 + 6);
+	int prerequisites[] = { 1, 2 };
+	deps.addPrerequisites(deps.find(0), prerequisites, prerequisites + 2);
+	deps.addPrerequisite(deps.find(2), deps.find(3));
+	deps.addPrerequisite(deps.find(1), deps.find(3));
+	typedef Depends::Depends< int >::closure_type Closure;
+	Closure dependants(deps.getAllDependants());
+	Closure prerequisites_closure(deps.getAllPrerequisites(Closure::COUNT_ONLY, 2));
+	for (Depends::Depends< int >::const_iterator which(deps.begin()); which != deps.end(); ++which)
+	{
+		std::size_t index(dependants.index(&*which));
+		assert(*dependants.value(index) == *which);
+		assert(dependants.count(index) == deps.getDependants(which, true).size());
+		std::size_t prerequisite_count(prerequisites_closure.count(prerequisites_closure.index(&*which)));
+		assert(prerequisite_count == deps.getPrerequisites(which, true).size());
+	}
+	assert(dependants.count(dependants.index(&*deps.find(3))) == 3);
+}
+
+void checkEstimates(Depends::Depends< int > const &deps)
+{
+	for (Depends::Depends< int >::const_iterator which(deps.begin()); which != deps.end(); ++which)
+	{
+		double dependants(deps.getDependants(which, true).size());
+		double prerequisites(deps.getPrerequisites(which, true).size());
+		assert(std::abs(deps.estimateDependants(which) - dependants) <= 1 + dependants * .3);
+		assert(std::abs(deps.estimatePrerequisites(which) - prerequisites) <= 1 + prerequisites * .3);
+	}
+}
+
+void test23()
+{
+	Depends::Depends< int > deps;
+	for (int i = 0; i < 300; ++i)
+	{
+		deps.insert(i);
+	}
+	bool thrown(false);
+	try
+	{
+		deps.estimateDependants(deps.begin());
+	}
+	catch (const std::logic_error &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	deps.setEstimating(true, 10);
+	assert(deps.getEstimating());
+	for (int i = 1; i < 150; ++i)
+	{
+		deps.addPrerequisite(deps.find(i), deps.find((i - 1) / 2));
+	}
+	// builds the sketches
+	checkEstimates(deps);
+	// updates them as links are added
+	for (int i = 150; i < 300; ++i)
+	{
+		deps.addPrerequisite(deps.find(i), deps.find((i - 1) / 2));
+		if (i % 5 == 0)
+			deps.addPrerequisite(deps.find(i), deps.find(i - 3));
+		else
+		{ /* only one prerequisite */ }
+	}
+	int more[3] = { 297, 298, 299 };
+	deps.addDependants(deps.find(7), more, more + 3);
+	checkEstimates(deps);
+	assert(deps.estimateDependants(deps.find(299)) == 0);
+	assert(deps.estimatePrerequisites(deps.find(0)) == 0);
+	// rebuilds them when links are removed
+	deps.removePrerequisite(deps.find(1), deps.find(0));
+	checkEstimates(deps);
+	deps.erase(deps.find(2));
+	checkEstimates(deps);
+	Depends::Depends< int > moved(std::move(deps));
+	assert(moved.getEstimating());
+	assert(!deps.getEstimating());
+	checkEstimates(moved);
+	moved.setEstimating(false);
+	assert(!moved.getEstimating());
+}
+
+struct Recorder : Depends::Depends< int >::observer_type
+{
+	virtual void changed(Depends::Depends< int >::change_set_type const &changes)
+	{
+		changes_.push_back(changes);
+	}
+
+	std::vector< Depends::Depends< int >::change_set_type > changes_;
+};
+
+void test24()
+{
+	Depends::Depends< int > deps;
+	Recorder recorder;
+	deps.setObserver(&recorder);
+	deps.select(0);
+	assert(recorder.changes_.size() == 1);
+	assert(recorder.changes_[0].inserted_.size() == 1);
+	// a new prerequisite is reported as a link from the prerequisite to the dependant
+	deps.addPrerequisite(1);
+	assert(recorder.changes_.size() == 2);
+	assert(recorder.changes_[1].inserted_.size() == 1 && recorder.changes_[1].inserted_[0] == 1);
+	assert(recorder.changes_[1].linked_.size() == 1 && recorder.changes_[1].linked_[0] == std::make_pair(1, 0));
+	assert(!recorder.changes_[1].reordered_);
+	deps.addPrerequisite(1);
+	assert(recorder.changes_.size() == 2);
+
+	int prerequisites[4] = { 1, 2, 3, 4 };
+	deps.addPrerequisites(deps.find(0), prerequisites, prerequisites + 4);
+	assert(recorder.changes_.size() == 3);
+	assert(recorder.changes_[2].inserted_.size() == 3);
+	assert(recorder.changes_[2].linked_.size() == 3);
+	int dependants[2] = { 5, 6 };
+	deps.addDependants(deps.find(4), dependants, dependants + 2);
+	assert(recorder.changes_.size() == 4);
+	assert(recorder.changes_[3].linked_.size() == 2 && recorder.changes_[3].linked_[0].first == 4);
+	deps.addDependant(deps.find(5), deps.find(0));
+	assert(recorder.changes_.size() == 5);
+	assert(deps.reduce() == 1);
+	assert(recorder.changes_.size() == 6);
+	assert(recorder.changes_[5].unlinked_.size() == 1 && recorder.changes_[5].unlinked_[0] == std::make_pair(4, 0));
+
+	{
+		Depends::Depends< int >::Batch batch(deps);
+		deps.removePrerequisite(deps.find(0), deps.find(2));
+		deps.addPrerequisite(deps.find(0), deps.find(2));
+		deps.removeDependant(deps.find(4), deps.find(6));
+		deps.erase(deps.find(3));
+		deps.insert(7);
+		deps.addPrerequisite(deps.find(7), deps.find(1));
+		deps.erase(deps.find(7));
+	}
+	assert(recorder.changes_.size() == 7);
+	assert(recorder.changes_[6].inserted_.empty());
+	assert(recorder.changes_[6].erased_.size() == 1 && recorder.changes_[6].erased_[0] == 3);
+	assert(recorder.changes_[6].linked_.empty());
+	assert(recorder.changes_[6].unlinked_.size() == 1 && recorder.changes_[6].unlinked_[0] == std::make_pair(4, 6));
+
+	deps.erase(deps.find(5), deps.end());
+	assert(recorder.changes_.size() == 8);
+	assert(recorder.changes_[7].erased_.size() == 2);
+	deps.clear();
+	assert(recorder.changes_.size() == 9);
+	assert(recorder.changes_[8].erased_.size() == 4);
+}
+
+void test25()
+{
+	Depends::Depends< int > deps;
+	deps.select(0);
+	for (int i = 1; i < 100; ++i)
+		deps.addPrerequisite(i);
+	Depends::Depends< int >::memory_usage_type usage(deps.memoryUsage());
+	assert(usage.values_ >= 100 * sizeof(int));
+	assert(usage.adjacency_ > 0);
+	assert(usage.total() == usage.nodes_ + usage.adjacency_ + usage.values_ + usage.indexes_ + usage.slack_);
+	deps.setEstimating(true);
+	deps.estimateDependants(deps.begin());
+	assert(deps.memoryUsage().indexes_ >= usage.indexes_ + 100 * 2 * 256);
+	deps.setEstimating(false);
+	deps.erase(deps.find(50), deps.end());
+	deps.shrink_to_fit();
+	assert(deps.memoryUsage().total() < usage.total());
+	assert(deps.getPrerequisites(deps.find(0)).size() == 49);
+}
+
+void test26()
+{
+	Depends::Depends< int > deps;
+	deps.select(9);
+	deps.addPrerequisite(8);
+	Recorder recorder;
+	deps.setObserver(&recorder);
+	int values[5] = { 0, 1, 2, 3, 4 };
+	std::vector< std::pair< int, int > > links = { { 0, 1 }, { 1, 2 }, { 0, 2 }, { 0, 1 }, { 3, 4 } };
+	deps.assign(values, values + 5, links.begin(), links.end());
+	assert(deps.size() == 5);
+	assert(deps.find(9) == deps.end());
+	assert(deps.depends(2, 0));
+	assert(deps.depends(4, 3));
+	assert(!deps.depends(0, 2));
+	assert(deps.getPrerequisites(deps.find(2)).size() == 2);
+	assert(deps.getDependants(deps.find(0), true).size() == 2);
+	assert(recorder.changes_.size() == 1);
+	assert(recorder.changes_[0].erased_.size() == 2);
+	assert(recorder.changes_[0].inserted_.size() == 5);
+	assert(recorder.changes_[0].linked_.size() == 4);
+	// the tracker works as usual afterwards
+	deps.select(4);
+	deps.addPrerequisite(2);
+	assert(deps.depends(4, 0));
+	assert(deps.getAllPrerequisites().size() == 5);
+
+	bool thrown(false);
+	links.push_back(std::make_pair(2, 0));
+	try
+	{
+		deps.assign(values, values + 5, links.begin(), links.end());
+	}
+	catch (const Depends::CircularReference &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(deps.depends(4, 0));
+	thrown = false;
+	links.back() = std::make_pair(2, 5);
+	try
+	{
+		deps.assign(values, values + 5, links.begin(), links.end());
+	}
+	catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(recorder.changes_.size() == 2);
+}
+
+void test27()
+{
+	Depends::Depends< int > deps;
+	deps.select(1);
+	deps.addPrerequisite(0);
+	deps.select(3);
+	deps.addPrerequisite(2);
+	deps.addPrerequisite(8);
+	deps.insert(9);
+	deps.select(9);
+	Recorder recorder;
+	deps.setObserver(&recorder);
+
+	Depends::Depends< int >::Transaction transaction(deps);
+	transaction.insert(4);
+	transaction.addPrerequisite(2, 1);
+	transaction.addDependant(3, 5);
+	transaction.addPrerequisite(1, 0);
+	transaction.removePrerequisite(3, 8);
+	transaction.erase(9);
+	transaction.erase(9);
+	// nothing happens until the transaction is committed
+	assert(deps.size() == 6);
+	transaction.commit();
+	assert(transaction.empty());
+	assert(deps.size() == 7);
+	assert(deps.find(9) == deps.end());
+	assert(deps.find(4) != deps.end());
+	assert(deps.depends(5, 0));
+	assert(!deps.depends(3, 8));
+	assert(deps.getPrerequisites(deps.find(5), true).size() == 4);
+	assert(deps.getDependants(deps.find(0), true).size() == 4);
+	assert(recorder.changes_.size() == 1);
+	assert(recorder.changes_[0].inserted_.size() == 2);
+	assert(recorder.changes_[0].erased_.size() == 1 && recorder.changes_[0].erased_[0] == 9);
+	assert(recorder.changes_[0].linked_.size() == 2);
+	assert(recorder.changes_[0].unlinked_.size() == 1 && recorder.changes_[0].unlinked_[0] == std::make_pair(8, 3));
+
+	// a circular reference changes nothing
+	transaction.insert(6);
+	transaction.removePrerequisite(3, 2);
+	transaction.addPrerequisite(0, 7);
+	transaction.addPrerequisite(7, 2);
+	transaction.erase(4);
+	bool thrown(false);
+	try
+	{
+		transaction.commit();
+	}
+	catch (const Depends::CircularReference &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(deps.size() == 7);
+	assert(deps.find(6) == deps.end() && deps.find(7) == deps.end());
+	assert(deps.depends(1, 0));
+	assert(deps.depends(5, 0));
+	assert(deps.getPrerequisites(deps.find(1)).size() == 1);
+	assert(deps.getDependants(deps.find(0)).size() == 1);
+	assert(recorder.changes_.size() == 1);
+	thrown = false;
+	transaction.removePrerequisite(1, 42);
+	try
+	{
+		transaction.commit();
+	}
+	catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(recorder.changes_.size() == 1);
+	// the tracker works as usual afterwards
+	deps.select(4);
+	deps.addPrerequisite(5);
+	assert(deps.depends(4, 0));
+}
+
+void test28()
+{
+	// queries on explicit nodes can be made from several threads at once
+	Depends::Depends< int > deps;
+	for (int i = 1; i < 200; ++i)
+	{
+		deps.select(i);
+		deps.addPrerequisite(i / 2);
+	}
+	std::vector< std::thread > threads;
+	for (int which = 0; which < 4; ++which)
+	{
+		threads.emplace_back([&deps, which]{
+				for (int i = 1; i < 200; ++i)
+				{
+					assert(deps.depends(i, 0));
+					assert(deps.depends(i, i / 2));
+					assert(!deps.depends(i / 2, i));
+					assert(deps.depends(i, 1));
+					assert(!deps.depends(i, (i + which) % 200) || (i + which) % 200 <= i);
+				}
+			});
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+}
+
+void test29()
+{
+	// assigning to an observed tracker reports only what changed
+	Depends::Depends< int > deps;
+	int values[3] = { 0, 1, 2 };
+	std::vector< std::pair< int, int > > links = { { 0, 1 }, { 1, 2 } };
+	deps.assign(values, values + 3, links.begin(), links.end());
+	Recorder recorder;
+	deps.setObserver(&recorder);
+	deps.assign(values, values + 3, links.begin(), links.end());
+	assert(recorder.changes_.empty());
+	assert(deps.depends(2, 0));
+
+	int overlapping[3] = { 1, 2, 3 };
+	links = { { 1, 2 }, { 1, 3 } };
+	deps.assign(overlapping, overlapping + 3, links.begin(), links.end());
+	assert(recorder.changes_.size() == 1);
+	Depends::Depends< int >::change_set_type const &changes(recorder.changes_.back());
+	assert(changes.erased_.size() == 1 && changes.erased_[0] == 0);
+	assert(changes.inserted_.size() == 1 && changes.inserted_[0] == 3);
+	assert(changes.linked_.size() == 1 && changes.linked_[0] == std::make_pair(1, 3));
+	assert(changes.unlinked_.empty());
+
+	links = { { 1, 3 }, { 2, 3 } };
+	deps.assign(overlapping, overlapping + 3, links.begin(), links.end());
+	assert(recorder.changes_.size() == 2);
+	assert(recorder.changes_.back().erased_.empty() && recorder.changes_.back().inserted_.empty());
+	assert(recorder.changes_.back().linked_.size() == 1 && recorder.changes_.back().linked_[0] == std::make_pair(2, 3));
+	assert(recorder.changes_.back().unlinked_.size() == 1 && recorder.changes_.back().unlinked_[0] == std::make_pair(1, 2));
+	assert(deps.depends(3, 2) && !deps.depends(2, 1));
+}
+
 int main()
 {
 	test1();
@@ -213,4 +784,19 @@ int main()
 	test12();
 	test13();
 	test14();
+	test15();
+	test16();
+	test17();
+	test18();
+	test19();
+	test20();
+	test21();
+	test22();
+	test23();
+	test24();
+	test25();
+	test26();
+	test27();
+	test28();
+	test29();
 }
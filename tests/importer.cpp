@@ -0,0 +1,142 @@
+#include "../importer.hpp"
+#include "../dag.hpp"
+#include "../depends.hpp"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+string writeFile(string const &contents)
+{
+	string const path("/tmp/depends_importer_" + to_string(getpid()));
+	ofstream out(path.c_str(), ios::binary);
+	out << contents;
+	return path;
+}
+
+void test1()
+{
+	string const text(
+		"# the manifest\n"
+		"a b\n"
+		"\n"
+		"b\tc   # b needs c\r\n"
+		"  d\n"
+		"a c\n"
+		"e a"
+		);
+	Depends::EdgeList list(text.data(), text.data() + text.size());
+	vector< string > expected_values = { "a", "b", "c", "d", "e" };
+	assert(list.values() == expected_values);
+	assert(list.links().size() == 4);
+	assert(list.links()[0].first == 0 && list.links()[0].second == 1);
+	assert(list.links()[3].first == 4 && list.links()[3].second == 0);
+	Depends::EdgeList::LinkIterator link(list.linksBegin());
+	assert(link->first == "a" && link->second == "b");
+	assert((*++link).first == "b");
+
+	Depends::DAG< string > dag;
+	list.assignTo(dag);
+	assert(dag.size() == 5);
+	assert(dag.linked("e", "c"));
+	assert(!dag.linked("c", "a"));
+
+	Depends::Depends< string > deps;
+	list.assignTo(deps);
+	assert(deps.size() == 5);
+	assert(deps.depends(string("c"), string("e")));
+	assert(deps.getPrerequisites(deps.find(string("c"))).size() == 2);
+
+	// a cycle is only found when the edges are built
+	string const cyclic("a b\nb a\n");
+	Depends::EdgeList cycle(cyclic.data(), cyclic.data() + cyclic.size());
+	bool thrown(false);
+	try
+	{
+		cycle.assignTo(dag);
+	}
+	catch (const Depends::CircularReference &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(dag.size() == 5);
+}
+
+void test2()
+{
+	string const text("a b\nb c\na b c\n");
+	bool thrown(false);
+	try
+	{
+		Depends::EdgeList list(text.data(), text.data() + text.size());
+	}
+	catch (const invalid_argument &e)
+	{
+		thrown = true;
+		assert(string(e.what()) == "line 3: expected a source and a target");
+	}
+	assert(thrown);
+	Depends::EdgeList empty(text.data(), text.data());
+	assert(empty.values().empty() && empty.links().empty());
+	thrown = false;
+	try
+	{
+		Depends::EdgeList missing("/nonexistent/depends/manifest");
+	}
+	catch (const system_error &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+}
+
+void test3()
+{
+	// large enough to be split into several chunks: the result doesn't depend on how many
+	string text;
+	for (int i(0); i < 300000; ++i)
+	{
+		text += "node" + to_string((i * 7919LL) % 100003) + " node" + to_string(100003 + i % 5000) + "\n";
+	}
+	text += "lone\n";
+	text += "x y z\n";
+	string const path(writeFile(text));
+	bool thrown(false);
+	try
+	{
+		Depends::EdgeList list(path, 4);
+	}
+	catch (const invalid_argument &e)
+	{
+		thrown = true;
+		assert(string(e.what()) == "line 300002: expected a source and a target");
+	}
+	assert(thrown);
+
+	text.resize(text.size() - 6);
+	writeFile(text);
+	Depends::EdgeList serial(path, 1);
+	Depends::EdgeList parallel(path, 4);
+	remove(path.c_str());
+	assert(serial.values().size() == 100003 + 5000 + 1);
+	assert(serial.links().size() == 300000);
+	assert(serial.values() == parallel.values());
+	assert(serial.links() == parallel.links());
+	assert(serial.values().back() == "lone");
+
+	Depends::DAG< string > dag;
+	parallel.assignTo(dag);
+	assert(dag.size() == serial.values().size());
+	assert(dag.linked("node0", "node100003"));
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+}
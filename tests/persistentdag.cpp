@@ -0,0 +1,92 @@
+#include "../persistentdag.hpp"
+#include <cassert>
+#include <string>
+
+void test1()
+{
+	Depends::PersistentDAG< int > dag;
+	assert(dag.empty());
+	for (int i = 0; i < 100; ++i)
+		assert(dag.insert(i).second);
+	assert(!dag.insert(12).second);
+	assert(dag.size() == 100);
+	assert(std::distance(dag.begin(), dag.end()) == 100);
+	for (int i = 0; i < 99; ++i)
+		assert(dag.link(i, i + 1));
+	assert(!dag.link(0, 1));
+	assert(dag.linked(0, 99));
+	assert(!dag.linked(99, 0));
+
+	bool detected(false);
+	try
+	{
+		dag.link(99, 0);
+	}
+	catch (const Depends::PersistentDAG< int >::circular_reference_exception &)
+	{
+		detected = true;
+	}
+	assert(detected);
+}
+
+void test2()
+{
+	Depends::PersistentDAG< int > dag;
+	for (int i = 0; i < 1000; ++i)
+		dag.insert(i);
+	for (int i = 0; i < 999; ++i)
+		dag.link(i, i + 1);
+
+	Depends::PersistentDAG< int > before(dag.snapshot());
+	dag.unlink(499, 500);
+	dag.insert(1000);
+	dag.link(1000, 0);
+	dag.erase(999);
+	assert(!dag.linked(0, 999));
+	assert(!dag.linked(0, 500));
+	assert(dag.linked(1000, 499));
+	assert(dag.size() == 1000);
+	assert(!dag.contains(999));
+
+	// the snapshot didn't change
+	assert(before.size() == 1000);
+	assert(before.linked(0, 999));
+	assert(!before.contains(1000));
+	assert(before.getTargets(0, true).size() == 999);
+	std::vector< const int* > order(before.order());
+	assert(order.size() == 1000);
+	for (int i = 0; i < 1000; ++i)
+		assert(*order[i] == i);
+
+	// and it can be changed on its own
+	before.unlink(0, 1);
+	assert(!before.linked(0, 999));
+	assert(dag.linked(1000, 499));
+	assert(dag.getTargets(1000).size() == 1);
+}
+
+void test3()
+{
+	Depends::PersistentDAG< std::string > dag;
+	dag.insert(std::string("a"));
+	dag.insert(std::string("b"));
+	dag.insert(std::string("c"));
+	dag.link("c", "b");
+	dag.link("b", "a");
+	std::vector< const std::string* > order(dag.order());
+	assert(order.size() == 3);
+	assert(*order[0] == "c");
+	assert(*order[2] == "a");
+	assert(dag.erase("b") == 1);
+	assert(dag.erase("b") == 0);
+	assert(dag.find("b") == dag.end());
+	assert(*dag.find("c") == "c");
+	assert(dag.getTargets("c").empty());
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+}
@@ -0,0 +1,113 @@
+#include "../readyset.hpp"
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+typedef Depends::Depends< std::string > Tracker;
+typedef Depends::ReadySet< std::string > ReadySet;
+
+void build(Tracker &deps)
+{
+	// a long chain: a <- b <- c <- d, and two short ones: e <- f and g
+	deps.select("b");
+	deps.addPrerequisite("a");
+	deps.select("c");
+	deps.addPrerequisite("b");
+	deps.select("d");
+	deps.addPrerequisite("c");
+	deps.select("f");
+	deps.addPrerequisite("e");
+	deps.insert("g");
+}
+
+void test1()
+{
+	Tracker deps;
+	build(deps);
+	ReadySet ready(deps);
+	assert(ready.remaining() == 7);
+	assert(ready.ready() == 3);
+	// without a priority, in the order they became ready: here, the tracker's order
+	assert(*ready.top() == "a");
+	Tracker::const_iterator a(ready.pop());
+	assert(*a == "a");
+	assert(!ready.isReady(a) && !ready.isDone(a));
+	assert(ready.ready() == 2);
+	bool thrown(false);
+	try
+	{
+		ready.markDone(deps.find("c"));
+	}
+	catch (const std::logic_error &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	ready.markDone(a);
+	assert(ready.isDone(a));
+	assert(ready.isReady(deps.find("b")));
+	assert(ready.ready() == 3);
+	// a ready value can be marked done without being taken out first
+	ready.markDone("g");
+	assert(ready.ready() == 2);
+	std::vector< std::string > order;
+	while (!ready.empty())
+	{
+		Tracker::const_iterator next(ready.pop());
+		order.push_back(*next);
+		ready.markDone(next);
+	}
+	std::vector< std::string > expected = { "e", "b", "f", "c", "d" };
+	assert(order == expected);
+	assert(ready.remaining() == 0);
+
+	thrown = false;
+	try
+	{
+		ready.markDone("a");
+	}
+	catch (const std::logic_error &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	thrown = false;
+	try
+	{
+		ready.markDone("z");
+	}
+	catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+}
+
+void test2()
+{
+	Tracker deps;
+	build(deps);
+	// by weight: g is the heaviest
+	ReadySet by_weight(deps, [](std::string const &value){ return value == "g" ? 10.0 : 1.0; });
+	assert(*by_weight.top() == "g");
+
+	// by critical path: the chain from a is the longest
+	ReadySet by_path(deps, [](std::string const &value){ return value == "g" ? 3.5 : 1.0; }, ReadySet::BY_CRITICAL_PATH);
+	std::vector< std::string > order;
+	while (!by_path.empty())
+	{
+		Tracker::const_iterator next(by_path.pop());
+		order.push_back(*next);
+		by_path.markDone(next);
+	}
+	// a's path is 4, g's is 3.5, b's is 3, and c and e, both 2, go in the order they became ready
+	std::vector< std::string > expected = { "a", "g", "b", "e", "c", "f", "d" };
+	assert(order == expected);
+}
+
+int main()
+{
+	test1();
+	test2();
+}
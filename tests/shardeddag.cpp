@@ -0,0 +1,159 @@
+#include "../shardeddag.hpp"
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace Depends;
+
+// put all values with the same number of hundreds in the same shard
+struct ByHundreds
+{
+	size_t operator()(int value) const { return value / 100; }
+};
+typedef ShardedDAG< int, hash< int >, equal_to< int >, ByHundreds > Sharded;
+
+bool before(vector< int > const &order, int first, int second)
+{
+	return find(order.begin(), order.end(), first) < find(order.begin(), order.end(), second);
+}
+
+void test1()
+{
+	Sharded dag(4);
+	assert(dag.shards() == 4);
+	assert(dag.shardOf(101) == 1);
+	assert(dag.shardOf(502) == 1);
+	for (int value : { 1, 2, 3, 101, 102, 201 })
+	{
+		assert(dag.insert(value));
+	}
+	assert(!dag.insert(1));
+	assert(dag.contains(102) && !dag.contains(103));
+	assert(dag.size() == 6);
+
+	assert(dag.link(1, 2));
+	assert(dag.link(101, 102));
+	assert(!dag.link(1, 2));
+	assert(dag.boundarySize() == 0);
+	assert(dag.link(2, 101));
+	assert(dag.link(102, 201));
+	assert(!dag.link(2, 101));
+	assert(dag.boundarySize() == 2);
+	assert(dag.linked(1, 201));
+	assert(!dag.linked(201, 1));
+	assert(!dag.linked(3, 201));
+
+	bool thrown(false);
+	try
+	{
+		dag.link(201, 1);
+	}
+	catch (const CircularReference &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(dag.boundarySize() == 2);
+	thrown = false;
+	try
+	{
+		dag.link(1, 999);
+	}
+	catch (const invalid_argument &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+
+	vector< int > order(dag.order());
+	assert(order.size() == 6);
+	assert(before(order, 1, 2));
+	assert(before(order, 2, 101));
+	assert(before(order, 101, 102));
+	assert(before(order, 102, 201));
+}
+
+void test2()
+{
+	// a cycle through another shard, closed by a link within a shard
+	Sharded dag(2);
+	for (int value : { 1, 2, 100 })
+	{
+		dag.insert(value);
+	}
+	dag.link(1, 100);
+	dag.link(100, 2);
+	bool thrown(false);
+	try
+	{
+		dag.link(2, 1);
+	}
+	catch (const CircularReference &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(!dag.linked(2, 1));
+	// implied links within the shard are fine
+	assert(dag.link(1, 2));
+
+	// unlinking and erasing keep the boundary index up to date
+	assert(dag.unlink(1, 100));
+	assert(!dag.unlink(1, 100));
+	assert(dag.boundarySize() == 1);
+	assert(dag.unlink(1, 2));
+	assert(dag.link(2, 1));
+	assert(dag.erase(100));
+	assert(!dag.erase(100));
+	assert(dag.boundarySize() == 0);
+	assert(dag.size() == 2);
+	vector< int > order(dag.order());
+	assert(order.size() == 2 && order[0] == 2 && order[1] == 1);
+}
+
+void test3()
+{
+	// one writer per shard, each building a chain, then a few links between them
+	unsigned int const writers(4);
+	int const length(200);
+	Sharded dag(writers);
+	vector< thread > threads;
+	for (unsigned int writer(0); writer < writers; ++writer)
+	{
+		threads.emplace_back([&dag, writer, length]{
+			int const base(writer * 100);
+			for (int value(0); value < length; ++value)
+			{
+				// shard by hundreds modulo the number of shards: keep to this writer's shard
+				dag.insert(base + (value / 100) * 100 * writers + value % 100);
+			}
+			for (int value(1); value < length; ++value)
+			{
+				dag.link(base + ((value - 1) / 100) * 100 * writers + (value - 1) % 100, base + (value / 100) * 100 * writers + value % 100);
+			}
+		});
+	}
+	for (auto &t : threads)
+	{
+		t.join();
+	}
+	assert(dag.size() == writers * length);
+	assert(dag.boundarySize() == 0);
+	dag.link(99 + 100 * writers, 100);
+	dag.link(199 + 100 * writers, 200);
+	assert(dag.linked(0, 299 + 100 * writers));
+	vector< int > order(dag.order());
+	assert(order.size() == writers * length);
+	assert(before(order, 0, 99 + 100 * writers));
+	assert(before(order, 99 + 100 * writers, 100));
+	assert(before(order, 100, 199 + 100 * writers));
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+}
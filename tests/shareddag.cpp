@@ -0,0 +1,136 @@
+#include "../shareddag.hpp"
+#include <cassert>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace Depends;
+
+typedef SharedDAG< int > Shared;
+
+string segmentName(string const &test)
+{
+	return "/depends_" + test + "_" + to_string(getpid());
+}
+
+void test1()
+{
+	string const name(segmentName("test1"));
+	DAG< int > dag;
+	for (int i(0); i < 10; ++i)
+	{
+		dag.insert(i);
+	}
+	dag.link(3, 2);
+	dag.link(2, 1);
+	dag.link(3, 7);
+	dag.link(9, 1);
+	assert(Shared::publish(name, dag) == 1);
+
+	Shared shared(name);
+	assert(shared.generation() == 1);
+	assert(!shared.stale());
+	assert(shared.size() == 10);
+	assert(shared.find(42) == shared.end());
+	Shared::const_iterator three(shared.find(3));
+	Shared::const_iterator two(shared.find(2));
+	Shared::const_iterator one(shared.find(1));
+	assert(*three == 3 && *two == 2 && *one == 1);
+	assert(three < two && two < one);
+	assert(shared.targets(three).size() == 2);
+	assert(shared.sources(one).size() == 2);
+	assert(shared[shared.targets(two).begin()[0]] == 1);
+	assert(shared.linked(three, one));
+	assert(!shared.linked(one, three));
+	// as in the DAG, a value is linked to itself
+	assert(shared.linked(two, two));
+	assert(!shared.linked(shared.find(7), one));
+	// every link goes forward
+	for (Shared::const_iterator value(shared.begin()); value != shared.end(); ++value)
+	{
+		for (auto target : shared.targets(value))
+		{
+			assert(target > shared.index(value));
+		}
+	}
+
+	Shared::remove(name);
+	bool thrown(false);
+	try
+	{
+		Shared gone(name);
+	}
+	catch (const system_error &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	// what is mapped stays mapped
+	assert(*shared.find(9) == 9);
+}
+
+void test2()
+{
+	string const name(segmentName("test2"));
+	DAG< int > dag;
+	dag.insert(1);
+	dag.insert(2);
+	Shared::publish(name, dag);
+	Shared shared(name);
+	assert(!shared.linked(shared.find(1), shared.find(2)) && !shared.linked(shared.find(2), shared.find(1)));
+
+	dag.link(2, 1);
+	dag.insert(3);
+	assert(Shared::publish(name, dag) == 2);
+	assert(shared.stale());
+	// the old version is unchanged until we refresh
+	assert(shared.size() == 2);
+	assert(shared.generation() == 1);
+	assert(shared.refresh());
+	assert(!shared.refresh());
+	assert(shared.generation() == 2);
+	assert(shared.size() == 3);
+	assert(shared.linked(shared.find(2), shared.find(1)));
+
+	// readers in other processes see the same thing
+	pid_t child(fork());
+	if (!child)
+	{
+		Shared other(name);
+		_exit(other.generation() == 2 && other.linked(other.find(2), other.find(1)) ? 0 : 1);
+	}
+	else
+	{ /* parent */ }
+	int status(0);
+	waitpid(child, &status, 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	Shared::remove(name);
+}
+
+void test3()
+{
+	string const name(segmentName("test3"));
+	::Depends::Depends< int > deps;
+	deps.insert(1);
+	deps.insert(2);
+	deps.insert(3);
+	deps.select(3);
+	deps.addPrerequisite(2);
+	deps.select(2);
+	deps.addPrerequisite(1);
+	Shared::publish(name, deps);
+	Shared shared(name);
+	assert(shared.size() == 3);
+	assert(shared[0] == 1 && shared[1] == 2 && shared[2] == 3);
+	assert(shared.linked(shared.find(1), shared.find(3)));
+	assert(shared.sources(shared.find(3)).size() == 1);
+	Shared::remove(name);
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+}
@@ -0,0 +1,70 @@
+#include "../staticdag.hpp"
+#include <cassert>
+#include <vector>
+
+enum Singleton { LOGGER, CONFIGURATION, DATABASE, CACHE, SERVER, SINGLETON_COUNT };
+constexpr Depends::StaticLink links[] = {
+	  { DATABASE, SERVER }
+	, { CONFIGURATION, DATABASE }
+	, { CACHE, SERVER }
+	, { LOGGER, CONFIGURATION }
+	, { DATABASE, CACHE }
+	};
+constexpr auto order(Depends::staticOrder< SINGLETON_COUNT >(links));
+
+// all of this is known at compile time
+static_assert(order.size() == SINGLETON_COUNT, "every singleton is in the order");
+static_assert(order[0] == LOGGER, "the logger comes first");
+static_assert(order.position(CONFIGURATION) < order.position(DATABASE), "configuration before the database");
+static_assert(order.position(DATABASE) < order.position(CACHE), "database before the cache");
+static_assert(order.position(CACHE) < order.position(SERVER), "cache before the server");
+static_assert(order[4] == SERVER, "the server comes last");
+static_assert(Depends::staticOrder< 3 >()[2] == 2, "nodes that aren't linked stay in their own order");
+
+// uncommenting this makes the compilation fail, as it has a circular reference
+// constexpr Depends::StaticLink cycle[] = { { 0, 1 }, { 1, 2 }, { 2, 0 } };
+// constexpr auto no_order(Depends::staticOrder< 3 >(cycle));
+
+void test1()
+{
+	std::vector< std::size_t > constructed;
+	for (auto singleton : order)
+	{
+		constructed.push_back(singleton);
+	}
+	std::vector< std::size_t > expected = { LOGGER, CONFIGURATION, DATABASE, CACHE, SERVER };
+	assert(constructed == expected);
+}
+
+void test2()
+{
+	// at run time, a circular reference throws instead
+	Depends::StaticLink cycle[] = { { 0, 1 }, { 1, 2 }, { 2, 1 } };
+	bool thrown(false);
+	try
+	{
+		Depends::staticOrder< 3 >(cycle);
+	}
+	catch (const Depends::CircularReference &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	Depends::StaticLink out_of_range[] = { { 0, 3 } };
+	thrown = false;
+	try
+	{
+		Depends::staticOrder< 3 >(out_of_range);
+	}
+	catch (const std::out_of_range &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+}
+
+int main()
+{
+	test1();
+	test2();
+}
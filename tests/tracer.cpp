@@ -0,0 +1,101 @@
+#include "../depends.hpp"
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <thread>
+
+void test1()
+{
+	Depends::Tracer tracer;
+	Depends::DAG< int > dag;
+	dag.setTracer(&tracer);
+	for (int i = 0; i < 10; ++i)
+		dag.insert(i);
+	for (int i = 1; i < 4; ++i)
+		dag.link(i, i + 1);
+	assert(dag.linked(1, 4));
+	dag.unlink(1, 2);
+	dag.setTracer(0);
+	dag.link(1, 2);
+
+	assert(tracer.size() == 10 + 3 + 1 + 1);
+	std::stringstream ss;
+	tracer.write(ss);
+	std::string trace(ss.str());
+	assert(trace.find("{\"traceEvents\":[") == 0);
+	assert(trace.find("\"name\":\"insert\"") != std::string::npos);
+	assert(trace.find("\"name\":\"link\"") != std::string::npos);
+	assert(trace.find("\"name\":\"linked\"") != std::string::npos);
+	assert(trace.find("\"name\":\"unlink\"") != std::string::npos);
+	assert(trace.find("\"ph\":\"X\"") != std::string::npos);
+	assert(trace.find("\"visits\":") != std::string::npos);
+	tracer.clear();
+	assert(tracer.size() == 0);
+}
+
+void test2()
+{
+	Depends::Tracer tracer;
+	Depends::Depends< int > deps;
+	deps.setTracer(&tracer);
+	deps.select(1);
+	deps.addPrerequisite(0);
+	assert(deps.depends(1, 0));
+
+	std::stringstream ss;
+	tracer.write(ss);
+	std::string trace(ss.str());
+	assert(trace.find("\"cat\":\"Depends\",\"ph\":\"X\"") != std::string::npos);
+	assert(trace.find("\"name\":\"addPrerequisite\"") != std::string::npos);
+	// the DAG operations are traced as well
+	assert(trace.find("\"cat\":\"DAG\",\"ph\":\"X\"") != std::string::npos);
+}
+
+void test3()
+{
+	Depends::Tracer tracer;
+	auto work = [&tracer](){
+			Depends::DAG< int > dag;
+			dag.setTracer(&tracer);
+			for (int i = 0; i < 100; ++i)
+				dag.insert(i);
+			for (int i = 0; i < 99; ++i)
+				dag.link(i, i + 1);
+		};
+	std::thread t1(work);
+	std::thread t2(work);
+	t1.join();
+	t2.join();
+	assert(tracer.size() == 2 * (100 + 99));
+
+	std::stringstream ss;
+	tracer.write(ss);
+	std::string trace(ss.str());
+	assert(trace.find("\"tid\":1") != std::string::npos);
+	assert(trace.find("\"tid\":2") != std::string::npos);
+}
+
+void test4()
+{
+	// a thread that uses many tracers, one after the other, and two at a time
+	Depends::Tracer outer;
+	Depends::DAG< int > dag;
+	for (int i = 0; i < 1000; ++i)
+	{
+		Depends::Tracer inner;
+		dag.setTracer(&inner);
+		dag.insert(i);
+		dag.setTracer(&outer);
+		dag.insert(i);
+		assert(inner.size() == 1);
+	}
+	assert(outer.size() == 1000);
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	test4();
+}
@@ -0,0 +1,189 @@
+#include "../versioneddag.hpp"
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+typedef Depends::VersionedDAG< int > Versioned;
+
+void test1()
+{
+	Versioned dag;
+	assert(dag.version() == 0);
+	assert(dag.insert(1));
+	assert(dag.insert(2));
+	assert(!dag.insert(1));
+	assert(dag.version() == 2);
+	assert(dag.link(1, 2));
+	assert(!dag.link(1, 2));
+	assert(dag.version() == 3);
+	bool thrown(false);
+	try
+	{
+		dag.link(2, 1);
+	}
+	catch (const Versioned::circular_reference_exception &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	assert(dag.version() == 3);
+
+	Versioned::Snapshot before(dag.snapshot());
+	assert(before.version() == 3);
+	assert(dag.insert(3));
+	assert(dag.link(2, 3));
+	assert(dag.unlink(1, 2));
+	assert(!dag.unlink(1, 2));
+	assert(dag.erase(2));
+	assert(!dag.erase(2));
+	assert(dag.insert(2));
+	assert(dag.link(3, 2));
+
+	// the snapshot still sees the DAG as it was
+	assert(before.contains(2) && !before.contains(3));
+	assert(before.linked(1, 2));
+	assert(before.targets(1) == std::vector< int >(1, 2));
+	assert(before.values() == std::vector< int >({ 1, 2 }));
+	Versioned::dag_type old(before.materialize());
+	assert(old.size() == 2 && old.linked(1, 2));
+
+	// while a new one sees the current version
+	Versioned::Snapshot after(dag.snapshot());
+	assert(after.version() == dag.version());
+	assert(!after.linked(1, 2));
+	assert(after.linked(3, 2));
+	assert(!after.linked(2, 3));
+	assert(after.values() == std::vector< int >({ 1, 3, 2 }));
+	assert(after.reachable(3) == std::vector< int >(1, 2));
+	// as in the DAG it materializes, a value is linked to itself
+	assert(after.linked(3, 3));
+	assert(after.materialize().linked(3, 3));
+	thrown = false;
+	try
+	{
+		before.targets(3);
+	}
+	catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+}
+
+void test2()
+{
+	// the records no snapshot can see are collected
+	Versioned dag;
+	dag.insert(0);
+	dag.insert(1);
+	dag.link(0, 1);
+	assert(dag.records() == 3);
+	{
+		Versioned::Snapshot pinned(dag.snapshot());
+		dag.unlink(0, 1);
+		dag.erase(1);
+		assert(dag.collect() == 0);
+		assert(dag.records() == 3);
+		assert(pinned.linked(0, 1));
+	}
+	assert(dag.collect() == 2);
+	assert(dag.records() == 1);
+	assert(dag.insert(1));
+	assert(dag.snapshot().values() == std::vector< int >({ 0, 1 }));
+
+	// and the writer collects them on its own, once no-one needs them
+	for (int i = 0; i < 1000; ++i)
+	{
+		dag.link(0, 1);
+		dag.unlink(0, 1);
+	}
+	assert(dag.records() < 200);
+	assert(dag.snapshot().materialize().size() == 2);
+}
+
+void test3()
+{
+	// a writer keeps a chain 0 -> 1 -> ... -> n, growing and shrinking it, while readers check every version they see is a chain
+	Versioned dag;
+	dag.insert(0);
+	std::atomic< bool > done(false);
+	std::thread writer([&]{
+			int length(0);
+			for (int round = 0; round < 2000; ++round)
+			{
+				if (length < 50 && (round / 100) % 2 == 0)
+				{
+					dag.insert(length + 1);
+					dag.link(length, length + 1);
+					++length;
+				}
+				else if (length > 0)
+				{
+					dag.erase(length);
+					--length;
+				}
+				else
+				{ /* nothing to shrink */ }
+			}
+			done = true;
+		});
+	std::vector< std::thread > readers;
+	std::atomic< int > checked(0);
+	for (int reader = 0; reader < 2; ++reader)
+	{
+		readers.emplace_back([&]{
+				while (!done || checked < 10)
+				{
+					Versioned::Snapshot snapshot(dag.snapshot());
+					std::vector< int > values(snapshot.values());
+					// each change is a version of its own, so the last value may not be linked yet
+					std::vector< int > reachable(snapshot.reachable(0));
+					assert(reachable.size() + 1 == values.size() || reachable.size() + 2 == values.size());
+					for (std::size_t i = 0; i < values.size(); ++i)
+					{
+						assert(values[i] == int(i));
+					}
+					Versioned::dag_type copy(snapshot.materialize());
+					assert(copy.size() == values.size());
+					assert(values.size() < 3 || copy.linked(0, int(values.size()) - 2));
+					++checked;
+				}
+			});
+	}
+	writer.join();
+	for (auto &reader : readers)
+	{
+		reader.join();
+	}
+	assert(checked >= 10);
+}
+
+void test4()
+{
+	// the links to an erased value go with it
+	Versioned dag;
+	dag.insert(1);
+	dag.insert(2);
+	dag.link(1, 2);
+	assert(dag.erase(2));
+	Versioned::version_type const version(dag.version());
+	assert(!dag.unlink(1, 2));
+	assert(!dag.unlink(2, 1));
+	assert(!dag.unlink(1, 3));
+	assert(dag.version() == version);
+	// and don't come back when it is inserted again
+	assert(dag.insert(2));
+	assert(!dag.snapshot().linked(1, 2));
+	assert(!dag.unlink(1, 2));
+	assert(dag.link(1, 2));
+	assert(dag.unlink(1, 2));
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	test4();
+}
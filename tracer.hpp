@@ -0,0 +1,346 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file tracer.hpp An optional tracer for the operations on Depends::DAG and Depends::Depends.
+ * The tracer records a span for every traced operation and writes them out in Chrome's
+ * trace-event format, so a recorded session can be loaded in chrome://tracing, Perfetto
+ * or any other viewer that understands that format. */
+#ifndef depends_tracer_hpp
+#define depends_tracer_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace Depends
+{
+	/** Records spans for operations on a DAG or a dependency tracker.
+	 * A tracer is attached to a container using its \c setTracer method, after
+	 * which each traced operation (insertion, linking, unlinking, erasure and
+	 * queries) records a span with the identifiers of the nodes involved and the
+	 * number of nodes visited to complete it. Containers without a tracer pay
+	 * for a single test of a null pointer per operation.
+	 *
+	 * Each thread records into a buffer of its own, which is appended to the
+	 * tracer's list of buffers the first time that thread records something.
+	 * Only then is a global lock taken, to drop the thread's cached buffers of
+	 * tracers that are gone; after that, recording never contends with other
+	 * threads.
+	 * Writing the trace and clearing it, however, must not be done while other
+	 * threads are still recording.
+	 *
+	 * A tracer must outlive any container it is attached to. */
+	class Tracer
+	{
+	public :
+		typedef std::chrono::steady_clock clock_type;
+
+		//! A single, completed span
+		struct Event
+		{
+			const char *name_;
+			const char *category_;
+			const void *source_;
+			const void *target_;
+			std::size_t visits_;
+			clock_type::time_point begin_;
+			clock_type::time_point end_;
+		};
+
+		/** A span in the making: records an event when it goes out of scope.
+		 * The span does nothing at all if it is constructed without a tracer. */
+		class Span
+		{
+		public :
+			Span(Tracer *tracer, const char *category, const char *name, const void *source = 0, const void *target = 0)
+				: tracer_(tracer)
+			{
+				if (tracer_)
+				{
+					event_.name_ = name;
+					event_.category_ = category;
+					event_.source_ = source;
+					event_.target_ = target;
+					event_.visits_ = 0;
+					event_.begin_ = clock_type::now();
+				}
+				else
+				{ /* not tracing */ }
+			}
+
+			~Span()
+			{
+				if (tracer_)
+				{
+					event_.end_ = clock_type::now();
+					tracer_->record(event_);
+				}
+				else
+				{ /* not tracing */ }
+			}
+
+			//! Add to the number of nodes visited during this span
+			void visits(std::size_t count)
+			{
+				if (tracer_)
+					event_.visits_ += count;
+				else
+				{ /* not tracing: the event is never initialized */ }
+			}
+
+		private :
+			Span(const Span &);
+			Span & operator=(const Span &);
+
+			Tracer *tracer_;
+			Event event_;
+		};
+
+		Tracer()
+			: buffers_(0)
+			, threads_(0)
+			, id_(nextId())
+			, epoch_(clock_type::now())
+		{
+			std::lock_guard< std::mutex > lock(registryMutex());
+			registry().insert(id_);
+		}
+
+		~Tracer()
+		{
+			{
+				std::lock_guard< std::mutex > lock(registryMutex());
+				registry().erase(id_);
+			}
+			Buffer *buffer(buffers_.load());
+			while (buffer)
+			{
+				Buffer *next(buffer->next_);
+				delete buffer;
+				buffer = next;
+			}
+		}
+
+		//! Record a completed event in the calling thread's buffer
+		void record(const Event &event)
+		{
+			getBuffer()->events_.push_back(event);
+		}
+
+		//! Get the number of events recorded so far, by all threads
+		std::size_t size() const
+		{
+			std::size_t retval(0);
+			for (const Buffer *buffer(buffers_.load()); buffer; buffer = buffer->next_)
+			{
+				retval += buffer->events_.size();
+			}
+
+			return retval;
+		}
+
+		//! Discard all recorded events. \pre no thread is recording
+		void clear()
+		{
+			for (Buffer *buffer(buffers_.load()); buffer; buffer = buffer->next_)
+			{
+				buffer->events_.clear();
+			}
+		}
+
+		/** Write all recorded events in Chrome's trace-event (JSON object) format.
+		 * \pre no thread is recording */
+		void write(std::ostream &os) const
+		{
+			std::ios_base::fmtflags flags(os.flags());
+			std::streamsize precision(os.precision());
+			os << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+			const char *separator("\n");
+			for (const Buffer *buffer(buffers_.load()); buffer; buffer = buffer->next_)
+			{
+				for (const Event &event : buffer->events_)
+				{
+					os << separator
+						<< "{\"name\":\"" << event.name_ << "\""
+						<< ",\"cat\":\"" << event.category_ << "\""
+						<< ",\"ph\":\"X\""
+						<< ",\"ts\":" << microseconds(event.begin_ - epoch_)
+						<< ",\"dur\":" << microseconds(event.end_ - event.begin_)
+						<< ",\"pid\":1"
+						<< ",\"tid\":" << buffer->thread_
+						<< ",\"args\":{";
+					if (event.source_)
+					{
+						os << "\"source\":\"" << event.source_ << "\",";
+					}
+					else
+					{ /* no source node */ }
+					if (event.target_)
+					{
+						os << "\"target\":\"" << event.target_ << "\",";
+					}
+					else
+					{ /* no target node */ }
+					os << "\"visits\":" << event.visits_ << "}}";
+					separator = ",\n";
+				}
+			}
+			os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+			os.flags(flags);
+			os.precision(precision);
+		}
+
+		/** Write all recorded events to the named file, replacing its contents.
+		 * \pre no thread is recording
+		 * \throws std::runtime_error if the file cannot be written */
+		void write(const char *filename) const
+		{
+			std::ofstream ofs(filename);
+			if (!ofs)
+				throw std::runtime_error("Could not open trace file");
+			else
+			{ /* all is well */ }
+			write(ofs);
+			if (!ofs)
+				throw std::runtime_error("Could not write trace file");
+			else
+			{ /* all is well */ }
+		}
+
+	private :
+		// Neither CopyConstructible nor Assignable
+		Tracer(const Tracer &);
+		Tracer & operator=(const Tracer &);
+
+		/** \internal A per-thread buffer. Only the thread that owns it writes to
+		 * its events; the list of buffers only ever grows while tracing. */
+		struct Buffer
+		{
+			std::vector< Event > events_;
+			unsigned long thread_;
+			Buffer *next_;
+		};
+
+		/** \internal Get the calling thread's buffer for this tracer, creating
+		 * and publishing it if this is the thread's first event. Tracers are
+		 * identified by a serial number rather than by their address so a
+		 * thread's cache never mistakes a new tracer for a destroyed one.
+		 * The tracer used last is checked first; when a buffer has to be
+		 * created, the entries for tracers that are gone are dropped, so the
+		 * cache never holds more than one entry per live tracer. */
+		Buffer * getBuffer()
+		{
+			typedef std::pair< unsigned long, Buffer* > Entry;
+			struct Cache
+			{
+				Entry last_;
+				std::vector< Entry > entries_;
+			};
+			static thread_local Cache cache = { Entry(0, 0), std::vector< Entry >() };
+			if (cache.last_.first == id_)
+				return cache.last_.second;
+			else
+			{ /* look for it */ }
+			for (auto &entry : cache.entries_)
+			{
+				if (entry.first == id_)
+				{
+					cache.last_ = entry;
+					return entry.second;
+				}
+				else
+				{ /* keep looking */ }
+			}
+
+			Buffer *buffer(new Buffer);
+			buffer->thread_ = ++threads_;
+			buffer->next_ = buffers_.load();
+			while (!buffers_.compare_exchange_weak(buffer->next_, buffer))
+				;
+			{
+				std::lock_guard< std::mutex > lock(registryMutex());
+				std::unordered_set< unsigned long > const &live(registry());
+				for (auto entry(cache.entries_.begin()); entry != cache.entries_.end(); )
+				{
+					if (live.count(entry->first))
+						++entry;
+					else
+						entry = cache.entries_.erase(entry);
+				}
+			}
+			cache.entries_.push_back(Entry(id_, buffer));
+			cache.last_ = cache.entries_.back();
+
+			return buffer;
+		}
+
+		static double microseconds(clock_type::duration d)
+		{
+			return std::chrono::duration< double, std::micro >(d).count();
+		}
+
+		static unsigned long nextId()
+		{
+			static std::atomic< unsigned long > next(0);
+			return ++next;
+		}
+
+		//! \internal The serial numbers of the tracers that haven't been destroyed yet
+		static std::unordered_set< unsigned long > & registry()
+		{
+			static std::unordered_set< unsigned long > live;
+			return live;
+		}
+
+		static std::mutex & registryMutex()
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		std::atomic< Buffer* > buffers_;
+		std::atomic< unsigned long > threads_;
+		const unsigned long id_;
+		const clock_type::time_point epoch_;
+	};
+}
+
+#endif
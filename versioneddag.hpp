@@ -0,0 +1,672 @@
+/* Depends: A generic dependency tracker in C++
+ * Copyright (c) 2004-2017, Ronald Landheer-Cieslak
+ * All rights reserved
+ * 
+ * This is free software. You may distribute it and/or modify it and
+ * distribute modified forms provided that the following terms are met:
+ *
+ * * Redistributions of the source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer;
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the distribution;
+ * * None of the names of the authors of this software may be used to endorse
+ *   or promote this software, derived software or any distribution of this 
+ *   software or any distribution of which this software is part, without 
+ *   prior written permission from the authors involved;
+ * * Unless you have received a written statement from Ronald Landheer-Cieslak
+ *   that says otherwise, the terms of the GNU General Public License, as 
+ *   published by the Free Software Foundation, version 2 or (at your option)
+ *   any later version, also apply.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** \file versioneddag.hpp A multi-version DAG: readers see consistent versions while a writer changes it. */
+#ifndef depends_versioneddag_hpp
+#define depends_versioneddag_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "dag.hpp"
+
+namespace Depends
+{
+	/** A DAG that keeps several versions of itself, so readers don't block the writer.
+	 * Each change made to the DAG creates a new version of it. A reader takes a
+	 * snapshot, which pins the version that is current at the time, and sees the
+	 * DAG exactly as it was in that version for as long as it holds on to the
+	 * snapshot, however the DAG changes in the mean time.
+	 *
+	 * Nothing is copied to make this work: each value and each link is a record
+	 * that carries the range of versions in which it exists. Inserting a value or
+	 * making a link adds a record, starting at the new version; erasing a value or
+	 * removing a link marks the end of its record's range, which is never changed
+	 * again. Erasing a value and inserting it again adds a new record for it. Once
+	 * no snapshot is left that can see a record, it is garbage-collected: this is
+	 * done by collect(), which the writer also calls once enough records have
+	 * ended since the last time something could be collected.
+	 *
+	 * The records are guarded by a shared mutex, but readers only hold it for
+	 * short steps: a query that visits the whole DAG does so a few nodes at a
+	 * time, so the writer waits for one such step at most, rather than for the
+	 * whole query. Writers hold the mutex for the duration of a change, which
+	 * takes as long as checking the new link for a circular reference, at most.
+	 * Any thread can change the DAG or take a snapshot, but a snapshot must not
+	 * outlive the DAG.
+	 *
+	 * For long or complex analyses, a snapshot can be turned into a DAG of its
+	 * own (\see Snapshot::materialize), which has the DAG's levels, closures and
+	 * so on.
+	 *
+	 * \param ValueType the type of whatever the DAG should be decorated with
+	 * \param Hash the hash function used to find values in the DAG
+	 * \param KeyEqual the predicate used to compare values in the DAG */
+	template < class ValueType, class Hash = std::hash< ValueType >, class KeyEqual = std::equal_to< ValueType > >
+	class VersionedDAG
+	{
+	public :
+		typedef ValueType value_type;
+		typedef Hash hasher;
+		typedef KeyEqual key_equal;
+		typedef std::size_t size_type;
+		typedef std::uint64_t version_type;
+		//! A DAG with the contents of one version (\see Snapshot::materialize)
+		typedef DAG< ValueType, Hash, KeyEqual > dag_type;
+
+		/** This exception is thrown in case a new link creates a
+		 * circular reference */
+		typedef CircularReference circular_reference_exception;
+
+	private :
+		static constexpr version_type forever__ = std::numeric_limits< version_type >::max();
+		//! \internal the number of nodes a reader visits in one step, holding the lock
+		static constexpr size_type step__ = 64;
+
+		//! \internal the range of versions in which a record exists: [created_, erased_)
+		struct Range
+		{
+			Range(version_type created)
+				: created_(created)
+				, erased_(forever__)
+			{ /* no-op */ }
+
+			bool visible(version_type version) const { return created_ <= version && version < erased_; }
+			bool alive() const { return erased_ == forever__; }
+
+			version_type created_;
+			version_type erased_;
+		};
+
+		struct Node;
+		//! \internal a link to a node, as it exists in a range of versions
+		struct Edge
+		{
+			Edge(Node *target, version_type created)
+				: target_(target)
+				, range_(created)
+			{ /* no-op */ }
+
+			Node *target_;
+			Range range_;
+		};
+
+		//! \internal a value, as it exists in a range of versions, with its links
+		struct Node
+		{
+			Node(const value_type &value, version_type created)
+				: value_(value)
+				, range_(created)
+				, previous_(0)
+				, next_(0)
+			{ /* no-op */ }
+
+			value_type value_;
+			Range range_;
+			std::vector< Edge > targets_;
+			//! the record for the same value before this one, if it's still around
+			Node *previous_;
+			//! the next node, in the order in which they were inserted
+			Node *next_;
+		};
+
+		typedef std::shared_timed_mutex Mutex;
+		typedef std::shared_lock< Mutex > ReadLock;
+		typedef std::unique_lock< Mutex > WriteLock;
+
+	public :
+		/** A consistent, read-only view of one version of the DAG.
+		 * The version is pinned for as long as the snapshot exists, so none of the
+		 * records it can see are garbage-collected. */
+		class Snapshot
+		{
+		public :
+			Snapshot(Snapshot &&other)
+				: dag_(other.dag_)
+				, version_(other.version_)
+			{
+				other.dag_ = 0;
+			}
+
+			~Snapshot()
+			{
+				if (dag_)
+					dag_->unpin(version_);
+				else
+				{ /* moved from */ }
+			}
+
+			//! Get the version this snapshot sees
+			version_type version() const { return version_; }
+
+			//! Check whether the value is in this version
+			bool contains(const value_type & val) const
+			{
+				ReadLock lock(dag_->mutex_);
+				return dag_->find(val, version_) != 0;
+			}
+
+			/** Get the values the given one links to directly in this version
+			 * \throws std::invalid_argument if the value isn't in this version */
+			std::vector< value_type > targets(const value_type & val) const
+			{
+				ReadLock lock(dag_->mutex_);
+				std::vector< value_type > retval;
+				dag_->forEachTarget(dag_->get(val, version_), version_, [&retval](Node *target){ retval.push_back(target->value_); });
+				return retval;
+			}
+
+			/** Get all of the values the given one links to, directly or not, in this version.
+			 * \throws std::invalid_argument if the value isn't in this version */
+			std::vector< value_type > reachable(const value_type & val) const
+			{
+				std::vector< value_type > retval;
+				visit(val, [&retval](Node *node){ retval.push_back(node->value_); return false; });
+				return retval;
+			}
+
+			/** Check whether the target can be reached from the source in this version.
+			 * A value is considered linked to itself, as it is by DAG::linked.
+			 * \throws std::invalid_argument if either value isn't in this version */
+			bool linked(const value_type & source, const value_type & target) const
+			{
+				Node *to;
+				{
+					ReadLock lock(dag_->mutex_);
+					to = dag_->get(target, version_);
+					if (dag_->get(source, version_) == to)
+						return true;
+					else
+					{ /* look for a path */ }
+				}
+				return visit(source, [to](Node *node){ return node == to; });
+			}
+
+			//! Get all of the values in this version, in the order in which they were inserted
+			std::vector< value_type > values() const
+			{
+				std::vector< value_type > retval;
+				scan([&retval](Node *node){ retval.push_back(node->value_); });
+				return retval;
+			}
+
+			/** Build a DAG with the values and links in this version.
+			 * The values and links are gathered a few at a time, after which the
+			 * DAG is built in bulk (\see DAG::assign) without holding any lock. */
+			dag_type materialize() const
+			{
+				std::vector< value_type > values;
+				std::vector< std::pair< value_type, value_type > > links;
+				scan([&](Node *node){
+						values.push_back(node->value_);
+						dag_->forEachTarget(node, version_, [&](Node *target){ links.emplace_back(node->value_, target->value_); });
+					});
+				dag_type retval;
+				retval.assign(values.begin(), values.end(), links.begin(), links.end());
+				return retval;
+			}
+
+		private :
+			Snapshot(VersionedDAG const *dag, version_type version)
+				: dag_(dag)
+				, version_(version)
+			{ /* no-op */ }
+
+			Snapshot(const Snapshot &) = delete;
+			Snapshot & operator=(const Snapshot &) = delete;
+
+			/** \internal Visit the nodes reachable from the given value (but not the value itself), a step at a time, until f returns true.
+			 * Only nodes that are visible in our version are kept between steps, so none of them can be collected under us. */
+			template < typename F >
+			bool visit(const value_type & val, F f) const
+			{
+				std::vector< Node* > pending;
+				std::unordered_set< Node* > visited;
+				{
+					ReadLock lock(dag_->mutex_);
+					pending.push_back(dag_->get(val, version_));
+				}
+				while (!pending.empty())
+				{
+					ReadLock lock(dag_->mutex_);
+					for (size_type count(0); count < step__ && !pending.empty(); ++count)
+					{
+						Node *node(pending.back());
+						pending.pop_back();
+						bool found(false);
+						dag_->forEachTarget(node, version_, [&](Node *target){
+								if (!found && visited.insert(target).second)
+								{
+									found = f(target);
+									pending.push_back(target);
+								}
+								else
+								{ /* been there, or done */ }
+							});
+						if (found)
+							return true;
+						else
+						{ /* keep looking */ }
+					}
+				}
+				return false;
+			}
+
+			/** \internal Call f with each node visible in our version, in insertion order, a step at a time.
+			 * A step always ends on a node that is visible in our version, as that one can't be
+			 * collected while we're not looking, so we can carry on from there. */
+			template < typename F >
+			void scan(F f) const
+			{
+				Node *cursor(0);
+				bool done(false);
+				while (!done)
+				{
+					ReadLock lock(dag_->mutex_);
+					Node *node(cursor ? cursor->next_ : dag_->first_);
+					size_type count(0);
+					for (; node && count < step__; node = node->next_)
+					{
+						if (node->range_.visible(version_))
+						{
+							f(node);
+							cursor = node;
+							++count;
+						}
+						else
+						{ /* not in our version */ }
+					}
+					done = !node;
+				}
+			}
+
+			VersionedDAG const *dag_;
+			version_type version_;
+
+			friend class VersionedDAG;
+		};
+
+		VersionedDAG()
+			: first_(0)
+			, last_(0)
+			, version_(0)
+			, records_(0)
+			, ended_(0)
+			, horizon_(0)
+		{ /* no-op */ }
+
+		~VersionedDAG()
+		{
+			for (Node *node(first_); node; )
+			{
+				Node *next(node->next_);
+				delete node;
+				node = next;
+			}
+		}
+
+		VersionedDAG(const VersionedDAG &) = delete;
+		VersionedDAG & operator=(const VersionedDAG &) = delete;
+
+		//! Get the current version
+		version_type version() const { return version_.load(std::memory_order_acquire); }
+
+		//! Take a snapshot of the current version, pinning it until the snapshot is destroyed
+		Snapshot snapshot() const
+		{
+			std::lock_guard< std::mutex > lock(pins_mutex_);
+			version_type current(version());
+			++pinned_[current];
+			return Snapshot(this, current);
+		}
+
+		/** Insert a value, in a new version.
+		 * \return false if the value already was there, in which case there is no new version */
+		bool insert(const value_type & val)
+		{
+			WriteLock lock(mutex_);
+			version_type const next(version() + 1);
+			Node *previous(latest(val));
+			if (previous && previous->range_.alive())
+				return false;
+			else
+			{ /* a new record */ }
+			std::unique_ptr< Node > node(new Node(val, next));
+			node->previous_ = previous;
+			index_[val] = node.get();
+			if (last_)
+				last_->next_ = node.get();
+			else
+				first_ = node.get();
+			last_ = node.release();
+			++records_;
+			publish(next);
+			return true;
+		}
+
+		/** Erase a value, along with its links, in a new version.
+		 * \return false if the value wasn't there, in which case there is no new version */
+		bool erase(const value_type & val)
+		{
+			WriteLock lock(mutex_);
+			version_type const next(version() + 1);
+			Node *node(latest(val));
+			if (!node || !node->range_.alive())
+				return false;
+			else
+			{ /* end its range, and that of its links */ }
+			node->range_.erased_ = next;
+			++ended_;
+			for (auto &edge : node->targets_)
+			{
+				if (edge.range_.alive())
+				{
+					edge.range_.erased_ = next;
+					++ended_;
+				}
+				else
+				{ /* already ended */ }
+			}
+			publish(next);
+			return true;
+		}
+
+		/** Link two values, in a new version.
+		 * \return false if they already were linked directly, in which case there is no new version
+		 * \throws std::invalid_argument if either value isn't there
+		 * \throws circular_reference_exception if the link would create a circular reference */
+		bool link(const value_type & source, const value_type & target)
+		{
+			WriteLock lock(mutex_);
+			version_type const next(version() + 1);
+			Node *source_node(alive(source));
+			Node *target_node(alive(target));
+			if (findEdge(source_node, target_node))
+				return false;
+			else
+			{ /* a new link */ }
+			if (reaches(target_node, source_node))
+				throw circular_reference_exception("Circular reference detected");
+			else
+			{ /* no cycle */ }
+			source_node->targets_.emplace_back(target_node, next);
+			++records_;
+			publish(next);
+			return true;
+		}
+
+		/** Remove the direct link between two values, in a new version.
+		 * \return false if they weren't linked directly, in which case there is no new version */
+		bool unlink(const value_type & source, const value_type & target)
+		{
+			WriteLock lock(mutex_);
+			version_type const next(version() + 1);
+			Node *source_node(latest(source));
+			Node *target_node(latest(target));
+			bool const both_alive(source_node && source_node->range_.alive() && target_node && target_node->range_.alive());
+			Edge *edge(both_alive ? findEdge(source_node, target_node) : 0);
+			if (!edge)
+				return false;
+			else
+			{ /* end its range */ }
+			edge->range_.erased_ = next;
+			++ended_;
+			publish(next);
+			return true;
+		}
+
+		/** Free the records that no snapshot can see anymore: those whose range ended at or before the oldest pinned version.
+		 * This takes time proportional to the number of records, holding the lock.
+		 * \return the number of records freed */
+		size_type collect()
+		{
+			WriteLock lock(mutex_);
+			return collect(horizon());
+		}
+
+		//! Get the number of records - values and links - that are kept, including those no longer in the current version
+		size_type records() const
+		{
+			ReadLock lock(mutex_);
+			return records_;
+		}
+
+	private :
+		//! \internal the latest record for a value, alive or not; the lock must be held
+		Node * latest(const value_type & val) const
+		{
+			auto where(index_.find(val));
+			return where == index_.end() ? 0 : where->second;
+		}
+
+		//! \internal the record for a value that is visible in the given version, if any; the lock must be held
+		Node * find(const value_type & val, version_type version) const
+		{
+			Node *node(latest(val));
+			while (node && !node->range_.visible(version))
+			{
+				node = node->previous_;
+			}
+			return node;
+		}
+
+		//! \internal the record for a value that is visible in the given version; the lock must be held
+		Node * get(const value_type & val, version_type version) const
+		{
+			Node *node(find(val, version));
+			if (!node)
+				throw std::invalid_argument("value not found");
+			else
+			{ /* found it */ }
+			return node;
+		}
+
+		//! \internal the record for a value in the current version; the lock must be held
+		Node * alive(const value_type & val) const
+		{
+			Node *node(latest(val));
+			if (!node || !node->range_.alive())
+				throw std::invalid_argument("value not found");
+			else
+			{ /* found it */ }
+			return node;
+		}
+
+		//! \internal the current link from source to target, if any - a link to an erased value doesn't count; the lock must be held
+		static Edge * findEdge(Node *source, Node *target)
+		{
+			for (auto &edge : source->targets_)
+			{
+				if (edge.target_ == target && edge.range_.alive() && edge.target_->range_.alive())
+					return &edge;
+				else
+				{ /* not this one */ }
+			}
+			return 0;
+		}
+
+		//! \internal call f with the targets of a node that are visible in the given version; the lock must be held
+		template < typename F >
+		static void forEachTarget(Node *node, version_type version, F f)
+		{
+			for (auto const &edge : node->targets_)
+			{
+				if (edge.range_.visible(version) && edge.target_->range_.visible(version))
+					f(edge.target_);
+				else
+				{ /* not in this version */ }
+			}
+		}
+
+		//! \internal check whether there is a path from source to target in the current version; the lock must be held
+		bool reaches(Node *source, Node *target) const
+		{
+			if (source == target)
+				return true;
+			else
+			{ /* look for a path */ }
+			std::unordered_set< Node* > visited;
+			std::vector< Node* > pending(1, source);
+			while (!pending.empty())
+			{
+				Node *node(pending.back());
+				pending.pop_back();
+				for (auto const &edge : node->targets_)
+				{
+					if (!edge.range_.alive() || !edge.target_->range_.alive())
+						continue;
+					else if (edge.target_ == target)
+						return true;
+					else if (visited.insert(edge.target_).second)
+						pending.push_back(edge.target_);
+					else
+					{ /* been there */ }
+				}
+			}
+			return false;
+		}
+
+		//! \internal make a new version current, and collect garbage if enough has built up since the last time anything could be; the lock must be held
+		void publish(version_type next)
+		{
+			version_.store(next, std::memory_order_release);
+			if (ended_ >= 64 && ended_ * 2 >= records_)
+			{
+				version_type const oldest(horizon());
+				if (oldest > horizon_)
+					collect(oldest);
+				else
+				{ /* no snapshot was released since the last time, so there would be nothing to collect */ }
+			}
+			else
+			{ /* not worth it yet */ }
+		}
+
+		//! \internal the oldest version that can still be seen
+		version_type horizon() const
+		{
+			std::lock_guard< std::mutex > lock(pins_mutex_);
+			return pinned_.empty() ? version() : std::min(pinned_.begin()->first, version());
+		}
+
+		void unpin(version_type version) const
+		{
+			std::lock_guard< std::mutex > lock(pins_mutex_);
+			auto where(pinned_.find(version));
+			if (!--where->second)
+				pinned_.erase(where);
+			else
+			{ /* still pinned by someone else */ }
+		}
+
+		//! \internal free the records whose range ended at or before the given version; the write lock must be held
+		size_type collect(version_type oldest)
+		{
+			horizon_ = oldest;
+			auto dead = [oldest](Range const &range){ return range.erased_ <= oldest; };
+			size_type freed(0);
+			for (Node *node(first_); node; node = node->next_)
+			{
+				size_type const before(node->targets_.size());
+				node->targets_.erase(std::remove_if(node->targets_.begin(), node->targets_.end(), [&](Edge const &edge){ return dead(edge.range_) || dead(edge.target_->range_); }), node->targets_.end());
+				freed += before - node->targets_.size();
+				if (node->previous_ && dead(node->previous_->range_))
+					node->previous_ = 0;
+				else
+				{ /* nothing older, or still visible */ }
+			}
+			Node *previous(0);
+			for (Node *node(first_); node; )
+			{
+				Node *next(node->next_);
+				if (dead(node->range_))
+				{
+					if (previous)
+						previous->next_ = next;
+					else
+						first_ = next;
+					auto where(index_.find(node->value_));
+					if (where != index_.end() && where->second == node)
+						index_.erase(where);
+					else
+					{ /* a newer record for the same value is indexed */ }
+					delete node;
+					++freed;
+				}
+				else
+				{
+					previous = node;
+				}
+				node = next;
+			}
+			last_ = previous;
+			records_ -= freed;
+			ended_ -= std::min(ended_, freed);
+			return freed;
+		}
+
+		mutable Mutex mutex_;
+		std::unordered_map< value_type, Node*, Hash, KeyEqual > index_;
+		Node *first_;
+		Node *last_;
+		std::atomic< version_type > version_;
+		size_type records_;
+		//! the number of records whose range ended since they were last collected
+		size_type ended_;
+		//! the oldest version that could be seen when garbage was last collected
+		version_type horizon_;
+
+		mutable std::mutex pins_mutex_;
+		//! the versions pinned by snapshots, with the number of snapshots pinning each
+		mutable std::map< version_type, size_type > pinned_;
+	};
+
+	template < class ValueType, class Hash, class KeyEqual >
+	constexpr typename VersionedDAG< ValueType, Hash, KeyEqual >::version_type VersionedDAG< ValueType, Hash, KeyEqual >::forever__;
+	template < class ValueType, class Hash, class KeyEqual >
+	constexpr typename VersionedDAG< ValueType, Hash, KeyEqual >::size_type VersionedDAG< ValueType, Hash, KeyEqual >::step__;
+}
+
+#endif